@@ -0,0 +1,199 @@
+/*
+ * ansi_canvas.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for drawing the canvas in the serial terminal with ANSI escape codes
+ *
+ *  	DRAWING
+ *  		every pixel is two spaces on a background color, ESC[4Nm where N is
+ *  		the 3 protocol color bits (bit 0 red, bit 1 green, bit 2 blue), which
+ *  		are also the ANSI color numbers
+ *  		the canvas takes the top ANSI_ROWS lines of the terminal, anything
+ *  		printed goes below it
+ *
+ *  	UPDATES
+ *  		a copy of what the terminal shows is kept, so after the first frame
+ *  		only the pixels that changed are sent
+ *  		each changed row starts with a cursor move ESC[row;colH, unchanged
+ *  		pixels between changed ones are skipped with ESC[nC, and the color
+ *  		is only sent when it differs from the pixel before
+ *  		every update ends by resetting the color and moving the cursor
+ *  		under the canvas, so prints don't land in it
+ *
+ *  	RATE
+ *  		an update only holds the whole rows that fit in the room it is
+ *  		given, the rest stay pending for the next one, so a full redraw
+ *  		goes out over several updates instead of overflowing the transmit
+ *  		ring
+ *  		full_bytes adds up what redrawing the whole canvas each update
+ *  		would have cost, to compare against bytes
+ *
+ *  	DEPENDENCIES
+ *  		format.h and frame_protocol.h must be included first
+ */
+
+#ifndef INC_ANSI_CANVAS_H_
+#define INC_ANSI_CANVAS_H_
+
+
+// defines
+#define ANSI_ROWS 			PROTO_HEIGHT 		// terminal lines of the canvas
+#define ANSI_UNKNOWN 		0xFF 				// shown color before the first frame, never equal to a pixel
+#define ANSI_ROW_MAX 		(8 + PROTO_WIDTH * (5 + 2)) // cursor move, then a color and two spaces for every pixel
+#define ANSI_TRAILER_MAX 	12 					// ESC[0m and the cursor move under the canvas
+#define ANSI_OUT_LEN 		512 				// most bytes of one update
+
+// typedefs
+typedef struct ansi_canvas
+{
+	uint8_t 	on; 		// 1 while drawing
+	uint8_t 	clear; 		// 1 if the next update clears the terminal first
+	uint16_t 	pending; 	// bit per row that may differ from the terminal
+	uint8_t 	shown[PROTO_HEIGHT][PROTO_WIDTH]; // color bits the terminal shows
+	uint32_t 	updates; 	// updates sent
+	uint32_t 	bytes; 		// bytes sent
+	uint32_t 	full_bytes; // bytes full redraws would have sent
+} ansi_canvas;
+
+ansi_canvas ansi_term = {0};
+
+// function declarations
+void ansi_start(); // clears the terminal and draws the whole canvas on the next update
+void ansi_stop(); // stops drawing
+uint16_t ansi_encode_row(const uint8_t* row, const uint8_t* shown, uint8_t y, char* out); // encodes the pixels of row y that differ from shown, returns the length, 0 if none differ
+uint16_t ansi_full_cost(const uint8_t* row, uint8_t y); // returns the bytes ansi_encode_row() takes to redraw every pixel of row y
+uint16_t ansi_build(const uint8_t pixels[PROTO_HEIGHT][PROTO_WIDTH], char* out, uint16_t room); // encodes the pending rows that fit in room and marks them shown, returns the length
+
+
+// clears the terminal and draws the whole canvas on the next update
+void ansi_start()
+{
+	for(uint8_t y = 0; y < PROTO_HEIGHT; y++)
+	{
+		for(uint8_t x = 0; x < PROTO_WIDTH; x++)
+		{
+			ansi_term.shown[y][x] = ANSI_UNKNOWN;
+		}
+	}
+	ansi_term.pending = 0xFFFF;
+	ansi_term.clear = 1;
+	ansi_term.updates = 0;
+	ansi_term.bytes = 0;
+	ansi_term.full_bytes = 0;
+	ansi_term.on = 1;
+}
+
+// stops drawing
+void ansi_stop()
+{
+	ansi_term.on = 0;
+}
+
+// encodes the pixels of row y that differ from shown, returns the length, 0 if none differ
+uint16_t ansi_encode_row(const uint8_t* row, const uint8_t* shown, uint8_t y, char* out)
+{
+	uint16_t n = 0;
+	uint8_t color = ANSI_UNKNOWN; // each row sets its own first color, so any row can be skipped
+	uint8_t skip = 0; 			  // unchanged pixels since the last one sent
+	uint8_t started = 0;
+
+	for(uint8_t x = 0; x < PROTO_WIDTH; x++)
+	{
+		if(row[x] == shown[x])
+		{
+			skip++;
+			continue;
+		}
+
+		if(!started) 	// first change, move to it
+		{
+			n += fmt_format(&out[n], ANSI_ROW_MAX - n, "\x1b[%u;%uH", (uint32_t)y + 1, (uint32_t)x * 2 + 1);
+			started = 1;
+		}
+		else if(skip) 	// step over the unchanged pixels
+		{
+			n += fmt_format(&out[n], ANSI_ROW_MAX - n, "\x1b[%uC", (uint32_t)skip * 2);
+		}
+		skip = 0;
+
+		if(row[x] != color)
+		{
+			n += fmt_format(&out[n], ANSI_ROW_MAX - n, "\x1b[4%um", (uint32_t)row[x]);
+			color = row[x];
+		}
+		out[n++] = ' ';
+		out[n++] = ' ';
+	}
+
+	return n;
+}
+
+// returns the bytes ansi_encode_row() takes to redraw every pixel of row y
+uint16_t ansi_full_cost(const uint8_t* row, uint8_t y)
+{
+	char move[ANSI_TRAILER_MAX];
+	uint16_t n = fmt_format(move, sizeof(move), "\x1b[%u;1H", (uint32_t)y + 1); // the move ansi_encode_row() sends, by the same formatter
+	for(uint8_t x = 0; x < PROTO_WIDTH; x++)
+	{
+		if(x == 0 || row[x] != row[x - 1])
+		{
+			n += 5; // ESC[4Nm
+		}
+		n += 2;
+	}
+	return n;
+}
+
+// encodes the pending rows that fit in room and marks them shown, returns the length
+uint16_t ansi_build(const uint8_t pixels[PROTO_HEIGHT][PROTO_WIDTH], char* out, uint16_t room)
+{
+	uint16_t n = 0;
+	uint16_t full = 0;
+	uint16_t trailer;
+
+	if(ansi_term.clear)
+	{
+		n += fmt_format(out, room, "\x1b[0m\x1b[2J"); // first frame, start from a blank terminal
+		ansi_term.clear = 0;
+	}
+
+	for(uint8_t y = 0; y < PROTO_HEIGHT; y++)
+	{
+		if(!(ansi_term.pending & (1 << y)))
+		{
+			continue;
+		}
+		if(n + ANSI_ROW_MAX + ANSI_TRAILER_MAX + 1 > room)
+		{
+			break; // sent by a later update
+		}
+
+		n += ansi_encode_row(pixels[y], ansi_term.shown[y], y, &out[n]);
+		for(uint8_t x = 0; x < PROTO_WIDTH; x++)
+		{
+			ansi_term.shown[y][x] = pixels[y][x];
+		}
+		ansi_term.pending &= ~(1 << y);
+	}
+
+	if(n == 0)
+	{
+		return 0;
+	}
+
+	trailer = fmt_format(&out[n], room - n, "\x1b[0m\x1b[%u;1H", (uint32_t)ANSI_ROWS + 2);
+	n += trailer;
+
+	// a full redraw sends every row with the same trailer
+	for(uint8_t y = 0; y < PROTO_HEIGHT; y++)
+	{
+		full += ansi_full_cost(pixels[y], y);
+	}
+	ansi_term.full_bytes += full + trailer;
+	ansi_term.updates++;
+	ansi_term.bytes += n;
+	return n;
+}
+
+#endif /* INC_ANSI_CANVAS_H_ */
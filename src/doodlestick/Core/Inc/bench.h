@@ -0,0 +1,228 @@
+/*
+ * bench.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for timing functions in core cycles with the DWT cycle counter,
+ *  in ns of the computer in the host build
+ *
+ *  	MEASURING
+ *  		bench_run() calls a function a number of times, each call with the
+ *  		interrupts masked between two bench_now() reads (DWT->CYCCNT), and
+ *  		keeps the fewest, mean and most cycles per call
+ *  		bench_init() times an empty function the same way, its fewest
+ *  		cycles (the two reads and the call) are taken off every result
+ *  		the totals are 32 bits, keep calls * cycles per call under 2^32
+ *
+ *  	OUTPUT
+ *  		one comma separated line per result, so a run can be kept as a
+ *  		baseline and compared with a script
+ *  			bench,name,calls,min_cycles,mean_cycles,max_cycles,accesses,writes
+ *  			mem,name,bytes
+ *  		accesses and writes are the register accesses and the accesses that
+ *  		changed a register per call, the board can't count them and prints -
+ *  		bench_print_ram() adds the flash and static RAM from the linker
+ *  		symbols, on the board only
+ *
+ *  	NEWLIB
+ *  		with BENCH_SNPRINTF 1 (-DBENCH_SNPRINTF=1) the suite also times
+ *  		snprintf() on the same values as the format.h cases, which links
+ *  		newlib's formatted output into the image, the flash line of this
+ *  		build less the one of a normal build is what snprintf() costs
+ *
+ *  	HOST BUILD
+ *  		the same suite runs in doodle_sim, where code between register
+ *  		accesses takes no simulated time, so bench_now() reads
+ *  		clock_gettime(CLOCK_MONOTONIC) instead and the three columns are ns
+ *  		(the header says min_ns, mean_ns, max_ns)
+ *  		the RAM only cases compare with an earlier host run on the same
+ *  		computer, a case with register accesses also times the simulator,
+ *  		its register traffic is what to compare
+ *
+ *  	DEPENDENCIES
+ *  		format.h, profile.h and uart.h must be included first
+ */
+
+#ifndef INC_BENCH_H_
+#define INC_BENCH_H_
+
+
+// defines
+#define BENCH_LINE_LEN 	96 		// longest output line
+#ifndef BENCH_SNPRINTF
+#define BENCH_SNPRINTF 	0 		// 1 also times snprintf(), and links it
+#endif
+
+#if BENCH_SNPRINTF
+#include <stdio.h>
+#endif /* BENCH_SNPRINTF */
+
+#ifdef PORT_HOST
+#include <time.h>
+#endif /* PORT_HOST */
+
+// typedefs
+typedef struct bench_result
+{
+	const char* 	name;
+	uint16_t 		calls;
+	uint32_t 		min; 		// cycles of the fastest call, ns on the host
+	uint32_t 		max; 		// cycles of the slowest call
+	uint32_t 		total; 		// cycles of every call
+	uint32_t 		accesses; 	// register accesses of every call, host only
+	uint32_t 		writes; 	// register writes of every call, host only
+} bench_result;
+
+typedef struct bench_state
+{
+	uint32_t 	overhead; 	// cycles of timing an empty function, ns on the host
+	char 		text[BENCH_LINE_LEN]; // output of the formatting cases, global so the compiler keeps the calls
+} bench_state;
+
+bench_state bench = {0};
+
+// function declarations
+void bench_init(); // starts the cycle counter and measures the cost of timing a call
+void bench_run(bench_result* r, const char* name, void (*fn)(), uint16_t calls); // times calls of fn into r
+void bench_empty(); // does nothing, timed by bench_init()
+uint32_t bench_now(); // returns the core cycles, ns on the host
+void bench_print_header(); // prints the column names of the result lines
+void bench_print(const bench_result* r); // prints one result line
+void bench_print_mem(const char* name, uint32_t bytes); // prints one memory footprint line
+void bench_print_ram(); // prints the flash and static RAM in use, on the board only
+uint32_t bench_accesses(); // returns the register accesses so far, 0 on the board
+uint32_t bench_writes(); // returns the register writes so far, 0 on the board
+
+
+// starts the cycle counter and measures the cost of timing a call
+void bench_init()
+{
+	bench_result empty;
+
+	cycle_counter_init();
+
+	bench.overhead = 0;
+	bench_run(&empty, "empty", bench_empty, 16);
+	bench.overhead = empty.min;
+}
+
+// times calls of fn into r
+void bench_run(bench_result* r, const char* name, void (*fn)(), uint16_t calls)
+{
+	r->name = name;
+	r->calls = calls;
+	r->min = 0xFFFFFFFF;
+	r->max = 0;
+	r->total = 0;
+	r->accesses = 0;
+	r->writes = 0;
+
+	for(uint16_t i = 0; i < calls; i++)
+	{
+		// masked, so an interrupt between the reads isn't counted, it runs after
+		uint32_t mask = __get_PRIMASK();
+		__disable_irq();
+		uint32_t start = bench_now();
+		uint32_t accesses = bench_accesses();
+		uint32_t writes = bench_writes();
+		fn();
+		r->accesses += bench_accesses() - accesses;
+		uint32_t cycles = bench_now() - start;
+		r->writes += bench_writes() - writes; // the host finds a write at the access after it
+		__set_PRIMASK(mask);
+
+		cycles = (cycles > bench.overhead) ? cycles - bench.overhead : 0;
+		if(cycles < r->min) r->min = cycles;
+		if(cycles > r->max) r->max = cycles;
+		r->total += cycles;
+	}
+}
+
+// does nothing, timed by bench_init()
+void bench_empty()
+{
+}
+
+// returns the core cycles, ns on the host
+uint32_t bench_now()
+{
+#ifdef PORT_HOST
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#else
+	return DWT->CYCCNT;
+#endif /* PORT_HOST */
+}
+
+// prints the column names of the result lines
+void bench_print_header()
+{
+	USART_Wait_Room(BENCH_LINE_LEN);
+#ifdef PORT_HOST
+	USART_Print("bench,name,calls,min_ns,mean_ns,max_ns,accesses,writes\n\r");
+#else
+	USART_Print("bench,name,calls,min_cycles,mean_cycles,max_cycles,accesses,writes\n\r");
+#endif /* PORT_HOST */
+}
+
+// prints one result line
+void bench_print(const bench_result* r)
+{
+	char line[BENCH_LINE_LEN];
+
+#ifdef PORT_HOST
+	fmt_format(line, sizeof(line), "bench,%s,%u,%u,%u,%u,%u,%u\n\r", r->name, r->calls,
+			r->min, r->total / r->calls, r->max, r->accesses / r->calls, r->writes / r->calls);
+#else
+	fmt_format(line, sizeof(line), "bench,%s,%u,%u,%u,%u,-,-\n\r", r->name, r->calls,
+			r->min, r->total / r->calls, r->max);
+#endif /* PORT_HOST */
+
+	USART_Wait_Room(BENCH_LINE_LEN); // asked for, so wait instead of dropping lines
+	USART_Print(line);
+}
+
+// prints one memory footprint line
+void bench_print_mem(const char* name, uint32_t bytes)
+{
+	char line[BENCH_LINE_LEN];
+	fmt_format(line, sizeof(line), "mem,%s,%u\n\r", name, bytes);
+	USART_Wait_Room(BENCH_LINE_LEN);
+	USART_Print(line);
+}
+
+// prints the flash and static RAM in use, on the board only
+void bench_print_ram()
+{
+#ifndef PORT_HOST
+	extern uint32_t _etext, _sdata, _edata, _ebss, _Min_Heap_Size, _Min_Stack_Size;
+
+	// the code and constants, then the initial values of .data after them
+	bench_print_mem("flash", ((uint32_t)&_etext - FLASH_BASE) + ((uint32_t)&_edata - (uint32_t)&_sdata));
+	bench_print_mem("static_ram", (uint32_t)&_ebss - (uint32_t)&_sdata);
+	bench_print_mem("heap_stack_min", (uint32_t)&_Min_Heap_Size + (uint32_t)&_Min_Stack_Size);
+#endif /* PORT_HOST */
+}
+
+// returns the register accesses so far, 0 on the board
+uint32_t bench_accesses()
+{
+	uint32_t n = 0;
+#ifdef PORT_HOST
+	for(uint8_t id = 0; id < PORT_NUM; id++) n += port_host.accesses[id];
+#endif /* PORT_HOST */
+	return n;
+}
+
+// returns the register writes so far, 0 on the board
+uint32_t bench_writes()
+{
+	uint32_t n = 0;
+#ifdef PORT_HOST
+	for(uint8_t id = 0; id < PORT_NUM; id++) n += port_host.writes[id];
+#endif /* PORT_HOST */
+	return n;
+}
+
+#endif /* INC_BENCH_H_ */
@@ -0,0 +1,134 @@
+/*
+ * event_ring.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the event rings between the interrupts and the main loop
+ *
+ *  	EVENTS
+ *  		every interrupt that has something for the main loop posts a typed
+ *  		event (type, value, 1us timestamp) instead of setting a flag, so an
+ *  		event is only lost when its ring is full, and then it is counted
+ *
+ *  	SINGLE PRODUCER, SINGLE CONSUMER
+ *  		each ring has exactly one writer (one interrupt) and one reader
+ *  		(the main loop), so no locking is needed
+ *  		only the writer changes head and only the reader changes tail, both
+ *  		are free running 16 bit counts (one store each on the Cortex-M4) and
+ *  		are masked into the buffer, so all EVENT_RING slots are usable
+ *  		the barrier makes the event data visible before the index that
+ *  		publishes it
+ *
+ *  	HOST BUILD
+ *  		port_host.h turns __DMB() into a full fence, so the ring builds and
+ *  		runs off target unchanged
+ */
+
+#ifndef INC_EVENT_RING_H_
+#define INC_EVENT_RING_H_
+
+
+// defines
+#define EVENT_RING_BARRIER() __DMB()
+
+// typedefs
+typedef enum EVENT_TYPE {
+		EVENT_NONE 			= 0,
+		EVENT_TICK 			= 1, // cursor tick, no value
+		EVENT_KEY_PRESS 	= 2, // value is the keypad index
+		EVENT_KEY_RELEASE 	= 3, // value is the keypad index
+		EVENT_BUTTON 		= 4, // value is the BUTTON_EVENT
+		EVENT_RX 			= 5  // value is the received serial byte
+} EVENT_TYPE;
+
+typedef struct event
+{
+	uint8_t  type; 	// EVENT_TYPE
+	uint16_t value; // meaning depends on the type
+	uint32_t time; 	// TIM5 timestamp, us
+} event;
+
+typedef struct event_ring
+{
+	event* 				buf; 		// storage, len entries
+	uint16_t 			mask; 		// len - 1, len must be a power of 2
+	volatile uint16_t 	head; 		// events posted, written by the interrupt
+	volatile uint16_t 	tail; 		// events taken, written by the main loop
+	volatile uint16_t 	dropped; 	// events lost because the ring was full
+	uint16_t 			high_water; // most events that were waiting at once
+} event_ring;
+
+// function declarations
+void ring_init(event_ring* r, event* buf, uint16_t len); // sets up an empty ring on the storage, len must be a power of 2
+uint8_t ring_post(event_ring* r, uint8_t type, uint16_t value, uint32_t time); // producer only, adds an event, returns 0 and counts a drop if full
+uint8_t ring_get(event_ring* r, event* ev); // consumer only, takes the oldest event, returns 0 if there is none
+uint16_t ring_count(const event_ring* r); // number of events waiting
+void ring_flush(event_ring* r); // consumer only, discards every waiting event
+
+
+// sets up an empty ring on the storage, len must be a power of 2
+void ring_init(event_ring* r, event* buf, uint16_t len)
+{
+	r->buf = buf;
+	r->mask = len - 1;
+	r->head = 0;
+	r->tail = 0;
+	r->dropped = 0;
+	r->high_water = 0;
+}
+
+// producer only, adds an event, returns 0 and counts a drop if full
+uint8_t ring_post(event_ring* r, uint8_t type, uint16_t value, uint32_t time)
+{
+	uint16_t head = r->head;
+	uint16_t used = (uint16_t)(head - r->tail);
+
+	if(used > r->mask)
+	{
+		r->dropped++;
+		return 0;
+	}
+
+	event* ev = &r->buf[head & r->mask];
+	ev->type = type;
+	ev->value = value;
+	ev->time = time;
+
+	if(used >= r->high_water) r->high_water = used + 1;
+
+	EVENT_RING_BARRIER(); // the event is written before it is published
+	r->head = head + 1;
+	return 1;
+}
+
+// consumer only, takes the oldest event, returns 0 if there is none
+uint8_t ring_get(event_ring* r, event* ev)
+{
+	uint16_t tail = r->tail;
+
+	if(tail == r->head)
+	{
+		return 0;
+	}
+
+	EVENT_RING_BARRIER(); // read the event after seeing the head that published it
+	*ev = r->buf[tail & r->mask];
+
+	EVENT_RING_BARRIER(); // the event is read before its slot is given back
+	r->tail = tail + 1;
+	return 1;
+}
+
+// number of events waiting
+uint16_t ring_count(const event_ring* r)
+{
+	return (uint16_t)(r->head - r->tail);
+}
+
+// consumer only, discards every waiting event
+void ring_flush(event_ring* r)
+{
+	r->tail = r->head;
+}
+
+#endif /* INC_EVENT_RING_H_ */
@@ -0,0 +1,227 @@
+/*
+ * format.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for formatting numbers into text without the C library
+ *
+ *  	WHY
+ *  		snprintf() links newlib's formatted output, its FILE locking and
+ *  		malloc() with the _sbrk() heap behind it, about 2.6KB of flash for
+ *  		printing an int, and walks the whole format machinery every call
+ *  		these only divide by the base and copy, and never allocate
+ *
+ *  	BUFFERS
+ *  		every function writes into a buffer given by the caller with its
+ *  		size, always ends it with '\0' (if size > 0) and returns the number
+ *  		of characters written without the '\0'
+ *  		text that doesn't fit is cut off, never written past the size
+ *
+ *  	FORMAT STRINGS
+ *  		fmt_format() takes %d %u %x %X %c %s and %%, each with an optional
+ *  		'-' (left align) or '0' (pad with zeros) flag and a width
+ *  		numbers are int32_t or uint32_t, there are no long or float types
+ *  		fixed point values go through fmt_fixed()
+ *
+ *  	HOST
+ *  		nothing in this file touches the hardware
+ */
+
+#ifndef INC_FORMAT_H_
+#define INC_FORMAT_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+
+
+// defines
+#define FMT_INT_LEN 	12 		// longest int32_t with its sign and '\0', "-2147483648"
+
+// function declarations
+uint16_t fmt_uint(char* out, uint16_t size, uint32_t value, uint8_t base, uint8_t width, char pad); // writes an unsigned number in base 2 to 16, padded on the left to width, nothing for another base
+uint16_t fmt_int(char* out, uint16_t size, int32_t value, uint8_t width, char pad); // writes a signed decimal number, padded on the left to width
+uint16_t fmt_hex(char* out, uint16_t size, uint32_t value, uint8_t digits); // writes a number as digits upper case hex digits, with leading zeros
+uint16_t fmt_fixed(char* out, uint16_t size, int32_t value, uint8_t frac_bits, uint8_t decimals); // writes a fixed point number with frac_bits (0 to 31) fractional bits, rounded to decimals places
+uint16_t fmt_format(char* out, uint16_t size, const char* format, ...); // writes a format string with its arguments
+uint16_t fmt_vformat(char* out, uint16_t size, const char* format, va_list args); // fmt_format() with a va_list
+uint16_t fmt_digits(char* digits, uint32_t value, uint8_t base, uint8_t upper); // writes the digits of a number backwards, returns how many
+uint16_t fmt_field(char* out, uint16_t size, uint16_t n, const char* prefix, const char* digits, uint16_t len, uint8_t reversed, uint8_t width, char pad); // copies a padded field into out at n, returns the new n
+
+
+// writes the digits of a number backwards, returns how many
+uint16_t fmt_digits(char* digits, uint32_t value, uint8_t base, uint8_t upper)
+{
+	const char* symbols = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	uint16_t len = 0;
+
+	do
+	{
+		digits[len++] = symbols[value % base];
+		value /= base;
+	} while(value);
+
+	return len;
+}
+
+// copies a padded field into out at n, returns the new n
+// a '0' pad goes between the prefix (the sign) and the digits, a ' ' pad before both, a '-' pad after both with spaces
+uint16_t fmt_field(char* out, uint16_t size, uint16_t n, const char* prefix, const char* digits, uint16_t len, uint8_t reversed, uint8_t width, char pad)
+{
+	uint16_t prefix_len = 0;
+	while(prefix && prefix[prefix_len]) prefix_len++;
+	uint16_t fill = (width > prefix_len + len) ? width - prefix_len - len : 0;
+
+	// leave room for the '\0'
+	#define FMT_PUT(c) do { if(n + 1 < size) out[n++] = (c); } while(0)
+
+	if(pad == ' ') for(uint16_t i = 0; i < fill; i++) FMT_PUT(' ');
+	for(uint16_t i = 0; i < prefix_len; i++) FMT_PUT(prefix[i]);
+	if(pad == '0') for(uint16_t i = 0; i < fill; i++) FMT_PUT('0');
+	for(uint16_t i = 0; i < len; i++) FMT_PUT(reversed ? digits[len - 1 - i] : digits[i]);
+	if(pad == '-') for(uint16_t i = 0; i < fill; i++) FMT_PUT(' ');
+
+	#undef FMT_PUT
+
+	if(size) out[n] = '\0';
+	return n;
+}
+
+// writes an unsigned number in base 2 to 16, padded on the left to width, nothing for another base
+uint16_t fmt_uint(char* out, uint16_t size, uint32_t value, uint8_t base, uint8_t width, char pad)
+{
+	char digits[32];
+
+	// base 0 would divide by zero and a base over 16 has no digit symbols, nothing is written
+	if(base < 2 || base > 16)
+	{
+		if(size) out[0] = '\0';
+		return 0;
+	}
+
+	uint16_t len = fmt_digits(digits, value, base, 0);
+	return fmt_field(out, size, 0, NULL, digits, len, 1, width, pad);
+}
+
+// writes a signed decimal number, padded on the left to width
+uint16_t fmt_int(char* out, uint16_t size, int32_t value, uint8_t width, char pad)
+{
+	char digits[10];
+	uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value; // INT32_MIN has no positive int32_t
+	uint16_t len = fmt_digits(digits, magnitude, 10, 0);
+	return fmt_field(out, size, 0, value < 0 ? "-" : NULL, digits, len, 1, width, pad);
+}
+
+// writes a number as digits upper case hex digits, with leading zeros
+uint16_t fmt_hex(char* out, uint16_t size, uint32_t value, uint8_t digits)
+{
+	char hex[8];
+	uint16_t len = fmt_digits(hex, value, 16, 1);
+	return fmt_field(out, size, 0, NULL, hex, len, 1, digits, '0');
+}
+
+// writes a fixed point number with frac_bits (0 to 31) fractional bits, rounded to decimals places
+uint16_t fmt_fixed(char* out, uint16_t size, int32_t value, uint8_t frac_bits, uint8_t decimals)
+{
+	uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+	uint32_t scale = 1;
+	for(uint8_t i = 0; i < decimals; i++) scale *= 10;
+
+	// round the fraction to the decimal places, done in 64 bits so Q16 with 4 places still fits
+	uint32_t whole = magnitude >> frac_bits;
+	uint64_t frac = (uint64_t)(magnitude & ((1u << frac_bits) - 1)) * scale;
+	frac = (frac + (1u << frac_bits >> 1)) >> frac_bits;
+	if(frac >= scale) // rounded up into the next whole number
+	{
+		whole++;
+		frac -= scale;
+	}
+
+	char digits[10];
+	uint16_t len = fmt_digits(digits, whole, 10, 0);
+	uint16_t n = fmt_field(out, size, 0, (value < 0 && (whole || frac)) ? "-" : NULL, digits, len, 1, 0, ' ');
+	if(decimals == 0)
+	{
+		return n;
+	}
+
+	n = fmt_field(out, size, n, NULL, ".", 1, 0, 0, ' ');
+	len = fmt_digits(digits, (uint32_t)frac, 10, 0);
+	return fmt_field(out, size, n, NULL, digits, len, 1, decimals, '0');
+}
+
+// writes a format string with its arguments
+uint16_t fmt_format(char* out, uint16_t size, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	uint16_t n = fmt_vformat(out, size, format, args);
+	va_end(args);
+	return n;
+}
+
+// fmt_format() with a va_list
+uint16_t fmt_vformat(char* out, uint16_t size, const char* format, va_list args)
+{
+	uint16_t n = 0;
+	char digits[32];
+
+	if(size) out[0] = '\0';
+
+	while(*format)
+	{
+		if(*format != '%')
+		{
+			n = fmt_field(out, size, n, NULL, format++, 1, 0, 0, ' ');
+			continue;
+		}
+		format++;
+
+		// flag and width
+		char pad = ' ';
+		uint8_t width = 0;
+		if(*format == '-' || *format == '0') pad = *format++;
+		while(*format >= '0' && *format <= '9') width = width * 10 + (*format++ - '0');
+
+		switch(*format)
+		{
+		case 'd':
+		{
+			int32_t value = va_arg(args, int32_t);
+			uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+			n = fmt_field(out, size, n, value < 0 ? "-" : NULL, digits, fmt_digits(digits, magnitude, 10, 0), 1, width, pad);
+			break;
+		}
+		case 'u':
+		case 'x':
+		case 'X':
+		{
+			uint32_t value = va_arg(args, uint32_t);
+			uint8_t base = (*format == 'u') ? 10 : 16;
+			n = fmt_field(out, size, n, NULL, digits, fmt_digits(digits, value, base, *format == 'X'), 1, width, pad);
+			break;
+		}
+		case 'c':
+			digits[0] = (char)va_arg(args, int);
+			n = fmt_field(out, size, n, NULL, digits, 1, 0, width, pad == '0' ? ' ' : pad);
+			break;
+		case 's':
+		{
+			const char* s = va_arg(args, const char*);
+			uint16_t len = 0;
+			while(s[len]) len++;
+			n = fmt_field(out, size, n, NULL, s, len, 0, width, pad == '0' ? ' ' : pad);
+			break;
+		}
+		case '%':
+			n = fmt_field(out, size, n, NULL, "%", 1, 0, 0, ' ');
+			break;
+		default: // unknown or cut off conversion, stop instead of guessing at the arguments
+			return n;
+		}
+		format++;
+	}
+
+	return n;
+}
+
+#endif /* INC_FORMAT_H_ */
@@ -0,0 +1,167 @@
+/*
+ * frame_mirror.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for streaming the canvas to a host over USART2
+ *
+ *  	DELTAS
+ *  		the mirror keeps a copy of the last frame it sent
+ *  		only the rows marked dirty are compared against that copy, each
+ *  		changed row is sent as the run length encoded XOR of its pixels
+ *  		with the copy, so unchanged pixels become long runs of 0
+ *  		one run is one byte, (length - 1) << 3 | color bits, 1 to 32 pixels
+ *
+ *  	FRAMES
+ *  		each delta is a protocol frame (frame_protocol.h) with cmd PROTO_MIRROR
+ *  		PROTO_MIRROR, seq, flags, time (4 bytes), rows (2 bytes), runs
+ *  		seq counts the deltas sent, so the host sees a lost one
+ *  		flags bit 0 is a key frame, the host clears its canvas first
+ *  		time is the TIM5 timestamp in us, low byte first
+ *  		rows has a bit per row that follows, low byte first, rows in order
+ *
+ *  	RATE
+ *  		a delta is only built once the transmit ring is empty, so the
+ *  		frame rate follows what the link can carry and never backs up
+ *
+ *  	DEPENDENCIES
+ *  		event_ring.h and frame_protocol.h must be included first
+ */
+
+#ifndef INC_FRAME_MIRROR_H_
+#define INC_FRAME_MIRROR_H_
+
+
+// defines
+#define PROTO_MIRROR 			0x40 	// unsolicited canvas delta, never a reply
+#define MIRROR_KEYFRAME 		0x01 	// flags bit, the host clears its canvas before applying the delta
+#define MIRROR_HEADER 			9 		// cmd, seq, flags, time, rows
+#define MIRROR_MAX_PAYLOAD 		(MIRROR_HEADER + PROTO_WIDTH * PROTO_HEIGHT + 2) // every pixel its own run, crc
+#define MIRROR_MAX_ENCODED 		(MIRROR_MAX_PAYLOAD + MIRROR_MAX_PAYLOAD / 254 + 3)
+
+// typedefs
+typedef struct frame_mirror
+{
+	uint8_t 	on; 		// 1 while streaming
+	uint8_t 	seq; 		// deltas sent, wraps
+	uint8_t 	keyframe; 	// 1 if the next delta is against a black canvas
+	uint16_t 	pending; 	// bit per row changed since the last delta
+	uint8_t 	last[PROTO_HEIGHT][PROTO_WIDTH]; // color bits of the last frame sent
+	uint32_t 	frames; 	// deltas sent
+	uint32_t 	bytes; 		// encoded bytes sent, delimiters included
+} frame_mirror;
+
+frame_mirror mirror = {0};
+
+// function declarations
+void mirror_start(); // starts streaming with a key frame
+void mirror_stop(); // stops streaming
+uint8_t mirror_encode_row(const uint8_t* row, uint8_t* last, uint8_t* out); // run length encodes the XOR of a row with the last one sent and updates it, returns 0 if it didn't change
+uint16_t mirror_build(const uint8_t pixels[PROTO_HEIGHT][PROTO_WIDTH], uint16_t rows, uint32_t time, uint8_t* out); // encodes the delta of the given rows, returns the encoded length, 0 if nothing changed
+
+
+// starts streaming with a key frame
+void mirror_start()
+{
+	for(uint8_t y = 0; y < PROTO_HEIGHT; y++)
+	{
+		for(uint8_t x = 0; x < PROTO_WIDTH; x++)
+		{
+			mirror.last[y][x] = 0;
+		}
+	}
+	mirror.keyframe = 1;
+	mirror.pending = 0xFFFF;
+	mirror.frames = 0;
+	mirror.bytes = 0;
+	mirror.on = 1;
+}
+
+// stops streaming
+void mirror_stop()
+{
+	mirror.on = 0;
+}
+
+// run length encodes the XOR of a row with the last one sent and updates it, returns 0 if it didn't change
+uint8_t mirror_encode_row(const uint8_t* row, uint8_t* last, uint8_t* out)
+{
+	uint8_t n = 0;
+	uint8_t changed = 0;
+	uint8_t x = 0;
+
+	while(x < PROTO_WIDTH)
+	{
+		uint8_t value = (row[x] ^ last[x]) & 0x07;
+		uint8_t run = 1;
+		while(x + run < PROTO_WIDTH && ((row[x + run] ^ last[x + run]) & 0x07) == value)
+		{
+			run++;
+		}
+		out[n++] = ((run - 1) << 3) | value;
+		changed |= value;
+		x += run;
+	}
+
+	if(!changed)
+	{
+		return 0;
+	}
+	for(x = 0; x < PROTO_WIDTH; x++)
+	{
+		last[x] = row[x];
+	}
+	return n;
+}
+
+// encodes the delta of the given rows, returns the encoded length, 0 if nothing changed
+uint16_t mirror_build(const uint8_t pixels[PROTO_HEIGHT][PROTO_WIDTH], uint16_t rows, uint32_t time, uint8_t* out)
+{
+	static uint8_t payload[MIRROR_MAX_PAYLOAD];
+	uint16_t n = MIRROR_HEADER;
+	uint16_t sent = 0;
+	uint16_t crc = PROTO_CRC_INIT;
+
+	for(uint8_t y = 0; y < PROTO_HEIGHT; y++)
+	{
+		if(rows & (1 << y))
+		{
+			uint8_t len = mirror_encode_row(pixels[y], mirror.last[y], &payload[n]);
+			if(len)
+			{
+				sent |= (1 << y);
+				n += len;
+			}
+		}
+	}
+
+	if(!sent && !mirror.keyframe)
+	{
+		return 0;
+	}
+
+	payload[0] = PROTO_MIRROR;
+	payload[1] = mirror.seq++;
+	payload[2] = mirror.keyframe ? MIRROR_KEYFRAME : 0;
+	payload[3] = time & 0xFF;
+	payload[4] = (time >> 8) & 0xFF;
+	payload[5] = (time >> 16) & 0xFF;
+	payload[6] = (time >> 24) & 0xFF;
+	payload[7] = sent & 0xFF;
+	payload[8] = sent >> 8;
+	mirror.keyframe = 0;
+
+	for(uint16_t i = 0; i < n; i++)
+	{
+		crc = proto_crc(crc, payload[i]);
+	}
+	payload[n++] = crc >> 8;
+	payload[n++] = crc & 0xFF;
+
+	n = proto_encode(payload, n, out);
+	mirror.frames++;
+	mirror.bytes += n;
+	return n;
+}
+
+#endif /* INC_FRAME_MIRROR_H_ */
@@ -0,0 +1,308 @@
+/*
+ * frame_protocol.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the binary canvas protocol on USART2
+ *
+ *  	FRAMING
+ *  		every frame is sent as 0x00, the COBS encoded payload, 0x00
+ *  		COBS removes every 0x00 from the payload, so 0x00 only marks the
+ *  		start and end of a frame
+ *  		a byte that is not inside a frame is a plain character, so the single
+ *  		character serial commands keep working next to the protocol
+ *
+ *  	PAYLOAD
+ *  		cmd, seq, arguments, crc high, crc low
+ *  		the crc is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) of cmd, seq
+ *  		and the arguments, sent high byte first so the crc of the whole
+ *  		payload is 0
+ *  		seq is chosen by the host and copied into the reply
+ *  		every command gets one reply, cmd | PROTO_REPLY, seq, status, data
+ *
+ *  	COMMANDS
+ *  		PROTO_SET_PIXEL 	x, y, color 						-> status
+ *  		PROTO_SET_RECT 		x0, y0, x1, y1, color 				-> status, filled rectangle
+ *  		PROTO_UPLOAD_FRAME 	PROTO_FRAME_BYTES of pixels 		-> status
+ *  		PROTO_READ_FRAME 	(none) 								-> status, PROTO_FRAME_BYTES of pixels
+ *  		PROTO_SET_MODE 		mode, option (0 = none) 			-> status
+ *  		PROTO_SET_BAUD 		baud (4 bytes, low byte first) 		-> status, sent at the old baud,
+ *  															   then the board switches
+ *  		a color is bit 0 red, bit 1 green, bit 2 blue
+ *  		a frame holds the pixels row by row from the top left, two pixels
+ *  		per byte, the left one in the low nibble
+ *
+ *  	RECEIVING
+ *  		proto_rx_byte() is called for every byte from the DMA1 channel 6
+ *  		half and full transfer interrupts and the USART2 idle line interrupt,
+ *  		it decodes the COBS and the crc as the bytes arrive, so a finished
+ *  		frame costs nothing extra in the interrupt
+ *  		good frames go into a single producer, single consumer queue that
+ *  		the main loop reads with proto_peek() and proto_release()
+ *  		bad frames are counted and dropped without a reply, the host retries
+ *
+ *  	HOST
+ *  		nothing in this file touches the hardware, tools/doodleproto.py is
+ *  		the host side of the same protocol
+ *  		event_ring.h must be included first
+ */
+
+#ifndef INC_FRAME_PROTOCOL_H_
+#define INC_FRAME_PROTOCOL_H_
+
+
+// defines
+#define PROTO_WIDTH 		32 		// matrix columns
+#define PROTO_HEIGHT 		16 		// matrix rows
+#define PROTO_FRAME_BYTES 	(PROTO_WIDTH * PROTO_HEIGHT / 2) // two pixels per byte
+#define PROTO_MAX_PAYLOAD 	(2 + 1 + PROTO_FRAME_BYTES + 2) // cmd, seq, status, frame, crc
+#define PROTO_MAX_ENCODED 	(PROTO_MAX_PAYLOAD + PROTO_MAX_PAYLOAD / 254 + 3) // COBS overhead and both delimiters
+#define PROTO_QUEUE_LEN 	2 		// decoded frames waiting for the main loop, must be a power of 2
+#define PROTO_CRC_INIT 		0xFFFF
+
+// typedefs
+typedef enum PROTO_CMD {
+		PROTO_SET_PIXEL 	= 0x01,
+		PROTO_SET_RECT 		= 0x02,
+		PROTO_UPLOAD_FRAME 	= 0x03,
+		PROTO_READ_FRAME 	= 0x04,
+		PROTO_SET_MODE 		= 0x05,
+		PROTO_SET_BAUD 		= 0x06,
+		PROTO_REPLY 		= 0x80 	// set in the cmd of every reply
+} PROTO_CMD;
+
+typedef enum PROTO_STATUS {
+		PROTO_OK 			= 0,
+		PROTO_BAD_LENGTH 	= 1, 	// wrong number of argument bytes for the command
+		PROTO_BAD_ARGUMENT 	= 2, 	// coordinate, color, mode or baud out of range
+		PROTO_UNKNOWN 		= 3 	// unknown command
+} PROTO_STATUS;
+
+typedef struct proto_frame
+{
+	uint16_t len; 							// bytes in data, cmd and seq included, crc removed
+	uint8_t  data[PROTO_MAX_PAYLOAD]; 		// cmd, seq, arguments
+} proto_frame;
+
+typedef struct proto_parser
+{
+	uint8_t 	in_frame; 		// 1 after a start delimiter
+	uint8_t 	discard; 		// 1 if the frame can't be kept (queue full or too long)
+	uint8_t 	code; 			// COBS code of the current block
+	uint8_t 	left; 			// bytes left in the current block
+	uint16_t 	len; 			// decoded bytes so far
+	uint16_t 	crc; 			// running crc of the decoded bytes
+	proto_frame queue[PROTO_QUEUE_LEN];
+	volatile uint16_t head; 	// frames decoded, written by the interrupt
+	volatile uint16_t tail; 	// frames handled, written by the main loop
+	volatile uint16_t frames; 	// good frames received
+	volatile uint16_t errors; 	// frames dropped for a bad crc, bad COBS or bad length
+	volatile uint16_t dropped; 	// good frames dropped because the queue was full
+} proto_parser;
+
+proto_parser proto = {0};
+
+// crc of one nibble, CRC-16/CCITT-FALSE
+const uint16_t proto_crc_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+// function declarations
+uint16_t proto_crc(uint16_t crc, uint8_t byte); // adds a byte to a running CRC-16/CCITT-FALSE
+uint8_t proto_rx_byte(uint8_t byte); // decodes a received byte, returns 0 if it is a plain character outside of a frame
+void proto_end_frame(); // checks the finished frame and queues it if it is good
+proto_frame* proto_peek(); // returns the oldest decoded frame, NULL if there is none
+void proto_release(); // gives the oldest decoded frame back to the interrupt
+uint16_t proto_encode(const uint8_t* payload, uint16_t len, uint8_t* out); // COBS encodes a payload between two delimiters, returns the encoded length
+uint16_t proto_reply(uint8_t cmd, uint8_t seq, uint8_t status, const uint8_t* data, uint16_t len, uint8_t* out); // builds and encodes a reply frame, returns the encoded length
+uint8_t proto_color_bits(uint8_t r, uint8_t g, uint8_t b); // packs a color into the 3 protocol bits
+uint8_t proto_get_pixel(const uint8_t* frame, uint8_t x, uint8_t y); // returns the color bits of a pixel in a packed frame
+void proto_set_pixel(uint8_t* frame, uint8_t x, uint8_t y, uint8_t bits); // sets the color bits of a pixel in a packed frame
+
+
+// adds a byte to a running CRC-16/CCITT-FALSE
+uint16_t proto_crc(uint16_t crc, uint8_t byte)
+{
+	crc = (crc << 4) ^ proto_crc_table[((crc >> 12) ^ (byte >> 4)) & 0x0F];
+	crc = (crc << 4) ^ proto_crc_table[((crc >> 12) ^ byte) & 0x0F];
+	return crc;
+}
+
+// decodes a received byte, returns 0 if it is a plain character outside of a frame
+uint8_t proto_rx_byte(uint8_t byte)
+{
+	if(byte == 0)
+	{
+		if(proto.in_frame && proto.len > 0)
+		{
+			proto_end_frame(); // end delimiter
+			proto.in_frame = 0;
+		}
+		else
+		{
+			// start delimiter, a second 0x00 in a row starts the frame again
+			proto.in_frame = 1;
+			proto.discard = ((uint16_t)(proto.head - proto.tail) >= PROTO_QUEUE_LEN);
+			proto.code = 0xFF; // no 0x00 before the first block
+			proto.left = 0;
+			proto.len = 0;
+			proto.crc = PROTO_CRC_INIT;
+		}
+		return 1;
+	}
+
+	if(!proto.in_frame)
+	{
+		return 0;
+	}
+
+	if(proto.left == 0)
+	{
+		// code byte, the block before it ended with a 0x00 unless it was full
+		if(proto.code != 0xFF)
+		{
+			if(proto.len < PROTO_MAX_PAYLOAD && !proto.discard)
+			{
+				proto.queue[proto.head & (PROTO_QUEUE_LEN - 1)].data[proto.len] = 0;
+			}
+			proto.crc = proto_crc(proto.crc, 0);
+			proto.len++;
+		}
+		proto.code = byte;
+		proto.left = byte - 1;
+	}
+	else
+	{
+		if(proto.len < PROTO_MAX_PAYLOAD && !proto.discard)
+		{
+			proto.queue[proto.head & (PROTO_QUEUE_LEN - 1)].data[proto.len] = byte;
+		}
+		proto.crc = proto_crc(proto.crc, byte);
+		proto.len++;
+		proto.left--;
+	}
+	return 1;
+}
+
+// checks the finished frame and queues it if it is good
+void proto_end_frame()
+{
+	// a cut off block, a payload too short for cmd, seq and crc, too long or a bad crc
+	if(proto.left != 0 || proto.len < 4 || proto.len > PROTO_MAX_PAYLOAD || proto.crc != 0)
+	{
+		proto.errors++;
+		return;
+	}
+
+	if(proto.discard)
+	{
+		proto.dropped++;
+		return;
+	}
+
+	proto.queue[proto.head & (PROTO_QUEUE_LEN - 1)].len = proto.len - 2;
+	proto.frames++;
+	EVENT_RING_BARRIER(); // the frame is written before it is published
+	proto.head++;
+}
+
+// returns the oldest decoded frame, NULL if there is none
+proto_frame* proto_peek()
+{
+	if(proto.tail == proto.head)
+	{
+		return NULL;
+	}
+	EVENT_RING_BARRIER(); // read the frame after seeing the head that published it
+	return &proto.queue[proto.tail & (PROTO_QUEUE_LEN - 1)];
+}
+
+// gives the oldest decoded frame back to the interrupt
+void proto_release()
+{
+	EVENT_RING_BARRIER(); // the frame is read before its slot is given back
+	proto.tail++;
+}
+
+// COBS encodes a payload between two delimiters, returns the encoded length
+uint16_t proto_encode(const uint8_t* payload, uint16_t len, uint8_t* out)
+{
+	uint16_t code_at = 1; 	// where the code of the current block goes
+	uint16_t n = 2; 		// after the start delimiter and the first code
+	uint8_t code = 1;
+
+	out[0] = 0;
+	for(uint16_t i = 0; i < len; i++)
+	{
+		if(payload[i] == 0)
+		{
+			out[code_at] = code;
+			code_at = n++;
+			code = 1;
+		}
+		else
+		{
+			out[n++] = payload[i];
+			code++;
+			if(code == 0xFF && i + 1 < len) // full block, no 0x00 after it
+			{
+				out[code_at] = code;
+				code_at = n++;
+				code = 1;
+			}
+		}
+	}
+	out[code_at] = code;
+	out[n++] = 0;
+	return n;
+}
+
+// builds and encodes a reply frame, returns the encoded length
+uint16_t proto_reply(uint8_t cmd, uint8_t seq, uint8_t status, const uint8_t* data, uint16_t len, uint8_t* out)
+{
+	static uint8_t payload[PROTO_MAX_PAYLOAD];
+	uint16_t n = 0;
+	uint16_t crc = PROTO_CRC_INIT;
+
+	if(len > PROTO_FRAME_BYTES) len = PROTO_FRAME_BYTES;
+
+	payload[n++] = cmd | PROTO_REPLY;
+	payload[n++] = seq;
+	payload[n++] = status;
+	for(uint16_t i = 0; i < len; i++)
+	{
+		payload[n++] = data[i];
+	}
+	for(uint16_t i = 0; i < n; i++)
+	{
+		crc = proto_crc(crc, payload[i]);
+	}
+	payload[n++] = crc >> 8;
+	payload[n++] = crc & 0xFF;
+
+	return proto_encode(payload, n, out);
+}
+
+// packs a color into the 3 protocol bits
+uint8_t proto_color_bits(uint8_t r, uint8_t g, uint8_t b)
+{
+	return (r ? 1 : 0) | (g ? 2 : 0) | (b ? 4 : 0);
+}
+
+// returns the color bits of a pixel in a packed frame
+uint8_t proto_get_pixel(const uint8_t* frame, uint8_t x, uint8_t y)
+{
+	uint16_t i = y * PROTO_WIDTH + x;
+	return (frame[i >> 1] >> ((i & 1) * 4)) & 0x07;
+}
+
+// sets the color bits of a pixel in a packed frame
+void proto_set_pixel(uint8_t* frame, uint8_t x, uint8_t y, uint8_t bits)
+{
+	uint16_t i = y * PROTO_WIDTH + x;
+	uint8_t shift = (i & 1) * 4;
+	frame[i >> 1] = (frame[i >> 1] & ~(0x0F << shift)) | ((bits & 0x07) << shift);
+}
+
+#endif /* INC_FRAME_PROTOCOL_H_ */
@@ -0,0 +1,231 @@
+/*
+ * input_journal.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the input event journal
+ *
+ *  	RECORDING
+ *  		every change of the joystick x, joystick y, keys held on the keypad or joystick
+ *  		button is stored as one entry with a timestamp from TIM5
+ *  		TIM5 is a 32-bit timer that free runs at 1MHz (1us per count)
+ *  		the journal only holds changes, so a held key or a still joystick
+ *  		does not fill up the journal, the joystick is the quantized sample
+ *  		of axis_quantize() (joystick_cal.h), its noise isn't a change
+ *
+ *  	REPLAY
+ *  		the recorded entries are fed back into the input state in place of the
+ *  		live inputs, each entry is applied once its timestamp (relative to the
+ *  		start of the replay) has passed
+ *  		a key change or a button event ends the entries applied in one
+ *  		update, so a click or a short tap that was recorded one update
+ *  		apart isn't merged with the entry after it, and the button event
+ *  		is cleared again at the next update as it is when live
+ *  		this makes a session repeatable so a drawing workload can be benchmarked
+ *
+ *  	HOST BUILD
+ *  		port_host.h models TIM5, so doodle_sim records and replays the
+ *  		same journal as the board
+ */
+
+#ifndef INC_INPUT_JOURNAL_H_
+#define INC_INPUT_JOURNAL_H_
+
+
+// defines
+#define JOURNAL_SIZE 		512 	// number of entries that can be recorded
+#define JOURNAL_TICK_HZ 	1000000 // TIM5 counts per second
+#define JOURNAL_CLK 		32000000 // clock into TIM5, same as the system clock
+
+// typedefs
+typedef enum JOURNAL_EVENT {
+		JOURNAL_XCOORD 	= 0, // value is the 12 bit joystick x sample
+		JOURNAL_YCOORD 	= 1, // value is the 12 bit joystick y sample
+		JOURNAL_KEYPAD 	= 2, // value is the bitmask of held keys, bit n is keypad index n
+		JOURNAL_BUTTON 	= 3  // value is the joystick button event (BUTTON_EVENT), 0 when none
+} JOURNAL_EVENT;
+
+typedef enum JOURNAL_MODE {
+		JOURNAL_LIVE 	= 0, // inputs pass through untouched
+		JOURNAL_RECORD 	= 1, // inputs pass through and changes are stored
+		JOURNAL_REPLAY 	= 2  // inputs are replaced with the stored entries
+} JOURNAL_MODE;
+
+typedef struct journal_entry
+{
+	uint32_t time; 	// us since the start of the recording
+	uint8_t  type; 	// JOURNAL_EVENT
+	uint16_t value; // new value of the input
+} journal_entry;
+
+typedef struct input_state
+{
+	uint16_t xcoord, ycoord; 	// joystick samples
+	uint16_t keys; 				// bitmask of the held keys, bit n is keypad index n
+	uint8_t  button; 			// joystick button event this loop, 0 if none
+} input_state;
+
+typedef struct input_journal
+{
+	journal_entry 	entries[JOURNAL_SIZE];
+	uint16_t 		count; 		// number of entries recorded
+	uint16_t 		next; 		// next entry to replay
+	uint8_t 		mode; 		// JOURNAL_MODE
+	uint8_t 		overflow; 	// 1 if the recording ran out of room
+	uint32_t 		start; 		// timestamp of the start of the recording or replay
+	input_state 	last; 		// last input state seen by the journal
+} input_journal;
+
+// function declarations
+void journal_timer_init(); // initializes TIM5 as a free running 1MHz timestamp counter
+uint32_t journal_now(); // returns the current timestamp in us
+void journal_record_start(input_journal* j, const input_state* in); // clears the journal and starts recording from the current inputs
+void journal_replay_start(input_journal* j, input_state* in); // rewinds the journal and starts replaying into the inputs
+void journal_stop(input_journal* j); // goes back to live inputs
+void journal_update(input_journal* j, input_state* in); // records the changes in the inputs or replaces them with the replayed ones
+uint8_t journal_replay_done(const input_journal* j); // returns 1 if every recorded entry has been replayed
+void journal_add(input_journal* j, uint32_t time, uint8_t type, uint16_t value); // adds an entry to the journal, sets overflow if full
+void journal_apply(const journal_entry* e, input_state* in); // applies a journal entry to the input state
+
+
+// initializes TIM5 as a free running 1MHz timestamp counter
+void journal_timer_init()
+{
+	// enable the clock for TIM5
+	RCC->APB1ENR1 |= RCC_APB1ENR1_TIM5EN;
+
+	// count up, one count per us, wrap at the full 32 bits
+	TIM5->CR1 &= ~(TIM_CR1_CMS | TIM_CR1_DIR);
+	TIM5->PSC = (JOURNAL_CLK / JOURNAL_TICK_HZ) - 1;
+	TIM5->ARR = 0xFFFFFFFF;
+	TIM5->EGR = TIM_EGR_UG; // load the prescaler now instead of at the first overflow
+	TIM5->CNT = 0;
+
+	// start timer, no interrupts needed
+	TIM5->CR1 |= TIM_CR1_CEN;
+}
+
+// returns the current timestamp in us
+uint32_t journal_now()
+{
+	return TIM5->CNT;
+}
+
+// clears the journal and starts recording from the current inputs
+void journal_record_start(input_journal* j, const input_state* in)
+{
+	j->count = 0;
+	j->next = 0;
+	j->overflow = 0;
+	j->start = journal_now();
+	j->mode = JOURNAL_RECORD;
+
+	// store the starting state so a replay begins from the same inputs
+	j->last = *in;
+	journal_add(j, 0, JOURNAL_XCOORD, in->xcoord);
+	journal_add(j, 0, JOURNAL_YCOORD, in->ycoord);
+	journal_add(j, 0, JOURNAL_KEYPAD, in->keys);
+	journal_add(j, 0, JOURNAL_BUTTON, in->button);
+}
+
+// rewinds the journal and starts replaying into the inputs
+void journal_replay_start(input_journal* j, input_state* in)
+{
+	j->next = 0;
+	j->start = journal_now();
+	j->mode = JOURNAL_REPLAY;
+
+	// the entries at time 0 are the starting state
+	journal_update(j, in);
+}
+
+// goes back to live inputs
+void journal_stop(input_journal* j)
+{
+	j->mode = JOURNAL_LIVE;
+}
+
+// records the changes in the inputs or replaces them with the replayed ones
+void journal_update(input_journal* j, input_state* in)
+{
+	uint32_t time = journal_now() - j->start; // wraps correctly with unsigned math
+
+	switch(j->mode)
+	{
+	case JOURNAL_RECORD:
+		// only store the inputs that changed
+		if(in->xcoord != j->last.xcoord) journal_add(j, time, JOURNAL_XCOORD, in->xcoord);
+		if(in->ycoord != j->last.ycoord) journal_add(j, time, JOURNAL_YCOORD, in->ycoord);
+		if(in->keys != j->last.keys) journal_add(j, time, JOURNAL_KEYPAD, in->keys);
+		if(in->button != j->last.button) journal_add(j, time, JOURNAL_BUTTON, in->button);
+		j->last = *in;
+		break;
+
+	case JOURNAL_REPLAY:
+		// start from the last replayed state, the live inputs are ignored
+		*in = j->last;
+		in->button = 0; // an event, seen by one update only
+		while(j->next < j->count && j->entries[j->next].time <= time)
+		{
+			const journal_entry* e = &j->entries[j->next];
+			journal_apply(e, in);
+			j->next++;
+
+			// one key change or button event per update, the same as when recorded
+			if(e->type == JOURNAL_KEYPAD || (e->type == JOURNAL_BUTTON && e->value))
+			{
+				break;
+			}
+		}
+		j->last = *in;
+		break;
+
+	default: // live, nothing to do
+		break;
+	}
+}
+
+// returns 1 if every recorded entry has been replayed
+uint8_t journal_replay_done(const input_journal* j)
+{
+	return j->mode == JOURNAL_REPLAY && j->next >= j->count;
+}
+
+// adds an entry to the journal, sets overflow if full
+void journal_add(input_journal* j, uint32_t time, uint8_t type, uint16_t value)
+{
+	if(j->count >= JOURNAL_SIZE)
+	{
+		j->overflow = 1;
+		return;
+	}
+
+	j->entries[j->count].time = time;
+	j->entries[j->count].type = type;
+	j->entries[j->count].value = value;
+	j->count++;
+}
+
+// applies a journal entry to the input state
+void journal_apply(const journal_entry* e, input_state* in)
+{
+	switch(e->type)
+	{
+	case JOURNAL_XCOORD:
+		in->xcoord = e->value;
+		break;
+	case JOURNAL_YCOORD:
+		in->ycoord = e->value;
+		break;
+	case JOURNAL_KEYPAD:
+		in->keys = e->value;
+		break;
+	case JOURNAL_BUTTON:
+		in->button = (uint8_t)e->value;
+		break;
+	default: // unknown entry, ignore
+		break;
+	}
+}
+
+#endif /* INC_INPUT_JOURNAL_H_ */
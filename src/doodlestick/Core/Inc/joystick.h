@@ -28,8 +28,28 @@
  *					check that doesn't interfere with USART
  *					comment out the FCLK declaration in USART header
  *
- *		INTERRUPTS
- *			1)	uses interrupts to trigger each new ADC conversion
+ *		SAMPLING
+ *			1)	ADC1 (x) and ADC2 (y) run in dual regular simultaneous mode
+ *					both axes are converted at the same instant on each trigger
+ *			2)	TIM6 update events trigger the conversions at JOYSTICK_SAMPLE_HZ
+ *					change the define, or pass another rate to joystick_adc_init()
+ *			3)	the packed x/y results are written by DMA1 channel 1 into the
+ *					circular buffer joystick_samples, no interrupt per sample
+ *					and no start conversion call is needed from the main loop
+ *
+ *		FILTERING
+ *			1)	the ADC hardware oversampler averages JOYSTICK_OVS_RATIO conversions
+ *					per trigger (OVSR) and shifts the sum back to 12 bits (OVSS)
+ *			2)	a fixed-point IIR low pass, y += (x - y) >> JOYSTICK_IIR_SHIFT,
+ *					runs over the new DMA samples each time joystick_read() is called
+ *					so there is no interrupt or extra pass for it
+ *			3)	the filter state is kept with 4 fractional bits (Q4)
+ *			4)	joystick_stats holds the average sample to sample change before
+ *					and after the filter, to compare the noise, and the filter delay
+ *			5)	if the main loop stalls for a whole buffer pass (a flash erase)
+ *					the DMA laps the filter, the half and full transfer flags show
+ *					it, the lap is counted and the filter starts again from the
+ *					newest sample instead of filtering a mix of two passes
  *
  *
  *		RANGE OF VALUES
@@ -37,12 +57,8 @@
  *
  *
  *		IMPLEMENTATIONS
- *			1)	the user of this file must include the IRQ for the ADC's
- *					the IRQ must check for the ADC1 (xcoord) and ADC2 (ycoord) individually
- *					example code commented out in this file-------------------------------------------------------------
- *			2)	the ADC for the X coordinate must be initialized before the ADC for the Y coordinate
- *
- *					maybe doesn't matter, need to check with ADC123 clock initialization
+ *			1)	call joystick_read() whenever the latest position is needed
+ *					it returns the newest x/y pair written by the DMA
  *
  *
  */
@@ -51,37 +67,66 @@
 #define SRC_JOYSTICK_H_
 
 
+// defines
+#define JOYSTICK_SAMPLE_HZ 	1000 		// default rate of the TIM6 trigger, one x/y pair per trigger
+#define JOYSTICK_DMA_LEN 	16 			// number of x/y pairs in the circular DMA buffer
+#define JOYSTICK_TIM_HZ 	1000000 	// TIM6 counts per second after the prescaler
+#define JOYSTICK_CLK 		32000000 	// clock into TIM6, same as the system clock
+#define JOYSTICK_OVSR 		3 			// oversampling ratio select, ratio = 2^(OVSR + 1) = 16
+#define JOYSTICK_OVSS 		4 			// oversampling right shift, 16 summed 12 bit samples back to 12 bits
+#define JOYSTICK_OVS_RATIO 	(2 << JOYSTICK_OVSR)
+#define JOYSTICK_IIR_SHIFT 	2 			// filter coefficient is 1/2^shift = 1/4
+#define JOYSTICK_FRAC 		4 			// fractional bits of the filter state
+
+// typedefs
+typedef struct joystick_filter
+{
+	uint32_t x, y; 			// filter output in Q4
+	uint32_t last_index; 	// next DMA buffer index the filter has not seen yet
+	uint8_t  primed; 		// 0 until the first sample loads the filter
+	uint32_t samples; 		// DMA samples filtered since boot, for the telemetry sample rate
+	uint32_t laps; 			// times the DMA went a whole buffer past the filter
+} joystick_filter;
+
+typedef struct joystick_noise
+{
+	uint32_t raw_delta; 	// sum of |sample - previous sample| in Q4
+	uint32_t filt_delta; 	// sum of |output - previous output| in Q4
+	uint32_t count; 		// number of samples summed
+	uint16_t prev_raw; 		// previous raw sample
+} joystick_noise;
+
+typedef struct joystick_stat
+{
+	joystick_noise x, y;
+} joystick_stat;
+
+// circular DMA buffer, each word is x (ADC1) in the low half and y (ADC2) in the high half
+volatile uint32_t joystick_samples[JOYSTICK_DMA_LEN];
+
+// filter state and noise statistics
+joystick_filter joystick_iir 	= {0};
+joystick_stat 	joystick_stats 	= {0};
+
 // function declarations
 void SystemClock_Config(void); // configures the system clock to 32MHz
 void Error_Handler(void); // error handler for system clock configuration
-void init_ADCs(); // initializes the system clock to 32MHz and ADC for x coordinate and ADC for y coordinate
-void xcoord_adc_init(); // initializes ADC1 for reading the X coordinate on PA0
-void ycoord_adc_init(); // initializes ADC2 for reading the Y coordinate on PA1
-void xcoord_start_conversion(); // starts the ADC conversion for the x coordinate
-void ycoord_start_conversion(); // starts the ADC conversion for the y coordinate
+void init_ADCs(); // initializes the system clock to 32MHz and the joystick ADCs at the default sample rate
+void joystick_adc_init(uint32_t sample_hz); // initializes ADC1 (x on PA0) and ADC2 (y on PA1) in dual mode, sampled by TIM6 into DMA
+void joystick_set_sample_rate(uint32_t sample_hz); // changes the TIM6 trigger rate of the joystick ADCs
+void adc_calibrate(ADC_TypeDef* adc); // takes the ADC out of deep power down, then calibrates it for single ended inputs
+void adc_enable(ADC_TypeDef* adc); // enables the ADC and waits until it is ready
+void joystick_read(uint16_t* x, uint16_t* y); // runs the filter over the new DMA samples and gets the filtered x and y
+void joystick_filter_update(); // runs the IIR filter over every DMA sample written since the last call
+void joystick_filter_restart(); // drops the samples written so far, the filter starts again from the newest one
+void joystick_filter_step(uint32_t* out, joystick_noise* noise, uint16_t sample); // filters one sample and adds it to the noise statistics
+uint8_t joystick_crossed(uint32_t from, uint32_t to, uint32_t index); // returns 1 if the DMA wrote up to index going from from to to
+void joystick_stats_reset(); // clears the noise statistics
+uint32_t joystick_latency_us(); // returns the delay of the oversampler and IIR filter in us
 void joystick_button_init(); // initializes the GPIO pin PA4 for the input from the button (as interrupt ? )
 uint8_t get_joystick_button(); // gets the value of the button where 1 is being pressed and 0 is not pressed
 
 
-// THIS FUNCTION DECLARATION INDICATES THAT NEED TO IMPLEMENT IN THE MAIN.C FILE
-// clear flag and set globals
-void ADC1_2_IRQHandler();/*
-{
-	// Vref for X is the input to ADC1
-	if (ADC1->ISR & ADC_ISR_EOC)
-	{
-		xcoord_data = ADC1->DR;
-		xcoord_adc_flag = 1;
-	}
-
-	// Vref for Y is the input to ADC2
-	if(ADC2->ISR & ADC_ISR_EOC)
-	{
-		ycoord_data = ADC2->DR;
-		ycoord_adc_flag = 1;
-	}
-}*/
-
 // gets the value of the button where 1 is being pressed and 0 is not pressed
 uint8_t get_joystick_button()
 {
@@ -102,132 +147,236 @@ void joystick_button_init()
 	GPIOA->PUPDR |=  (GPIO_PUPDR_PUPD4_0);
 }
 
-// starts the ADC conversion for the y coordinate
-void ycoord_start_conversion()
+// runs the filter over the new DMA samples and gets the filtered x and y
+void joystick_read(uint16_t* x, uint16_t* y)
 {
-	// Vref for y is the input to ADC2
-	ADC2->CR |= ADC_CR_ADSTART;
+	joystick_filter_update();
+
+	// round the Q4 outputs back to 12 bits
+	*x = (joystick_iir.x + (1 << (JOYSTICK_FRAC - 1))) >> JOYSTICK_FRAC;
+	*y = (joystick_iir.y + (1 << (JOYSTICK_FRAC - 1))) >> JOYSTICK_FRAC;
 }
 
-// starts the ADC conversion for the x coordinate
-void xcoord_start_conversion()
+// runs the IIR filter over every DMA sample written since the last call
+void joystick_filter_update()
 {
-	// Vref for x is the input to ADC1
-	ADC1->CR |= ADC_CR_ADSTART;
+	uint32_t next, flags, cndtr;
+
+	// the flags and the index must be from the same moment, read again if a sample came in between
+	do
+	{
+		// CNDTR counts down from the buffer length, this is the index the DMA writes next
+		cndtr = DMA1_Channel1->CNDTR;
+		flags = DMA1->ISR & (DMA_ISR_HTIF1 | DMA_ISR_TCIF1);
+		DMA1->IFCR = flags;
+	} while(cndtr != DMA1_Channel1->CNDTR);
+	next = JOYSTICK_DMA_LEN - cndtr;
+	if(next >= JOYSTICK_DMA_LEN) next = 0; // CNDTR reloads to the length on the wrap
+
+	// a flag for a boundary the index didn't cross means the DMA went around a whole pass
+	if(((flags & DMA_ISR_HTIF1) && !joystick_crossed(joystick_iir.last_index, next, JOYSTICK_DMA_LEN / 2))
+			|| ((flags & DMA_ISR_TCIF1) && !joystick_crossed(joystick_iir.last_index, next, 0)))
+	{
+		joystick_iir.laps++;
+		joystick_iir.primed = 0; // start again from the newest sample
+		joystick_iir.last_index = (next + JOYSTICK_DMA_LEN - 1) % JOYSTICK_DMA_LEN;
+	}
+
+	while(joystick_iir.last_index != next)
+	{
+		uint32_t sample = joystick_samples[joystick_iir.last_index];
+
+		joystick_filter_step(&joystick_iir.x, &joystick_stats.x, sample & 0xFFFF); // ADC1 result
+		joystick_filter_step(&joystick_iir.y, &joystick_stats.y, sample >> 16);	   // ADC2 result
+		joystick_iir.primed = 1;
+		joystick_iir.samples++;
+
+		joystick_iir.last_index = (joystick_iir.last_index + 1) % JOYSTICK_DMA_LEN;
+	}
 }
 
-// initializes ADC2 for reading the Y coordinate on PA1
-void ycoord_adc_init()
+// drops the samples written so far, the filter starts again from the newest one
+void joystick_filter_restart()
 {
-	// turns on the clock for ADC
-	RCC->AHB2ENR |= RCC_AHB2ENR_ADCEN;
-	ADC123_COMMON->CCR = ((ADC123_COMMON->CCR & ~(ADC_CCR_CKMODE)) | ADC_CCR_CKMODE_0);
+	DMA1->IFCR = DMA_IFCR_CHTIF1 | DMA_IFCR_CTCIF1;
+	uint32_t next = (JOYSTICK_DMA_LEN - DMA1_Channel1->CNDTR) % JOYSTICK_DMA_LEN;
+	joystick_iir.primed = 0;
+	joystick_iir.last_index = (next + JOYSTICK_DMA_LEN - 1) % JOYSTICK_DMA_LEN;
+}
 
-	// make sure conversion isn't started
-	ADC2->CR &= ~(ADC_CR_ADSTART);
+// returns 1 if the DMA wrote up to index going from from to to
+uint8_t joystick_crossed(uint32_t from, uint32_t to, uint32_t index)
+{
+	// the DMA's next index went from + 1 up to to, the flag is set when it reaches index
+	uint32_t steps = (to + JOYSTICK_DMA_LEN - from) % JOYSTICK_DMA_LEN;
+	return (index + JOYSTICK_DMA_LEN - from - 1) % JOYSTICK_DMA_LEN < steps;
+}
 
-	// take the ADC out of deep power down mode
-	ADC2->CR &= ~(ADC_CR_DEEPPWD);
+// filters one sample and adds it to the noise statistics
+void joystick_filter_step(uint32_t* out, joystick_noise* noise, uint16_t sample)
+{
+	uint32_t in = (uint32_t)sample << JOYSTICK_FRAC;
+	uint32_t prev = *out;
 
-	// enable to voltage regulator guards the voltage
-	ADC2->CR |= (ADC_CR_ADVREGEN);
+	// load the filter with the first sample so it doesn't ramp up from 0
+	if(!joystick_iir.primed)
+	{
+		*out = in;
+		noise->prev_raw = sample;
+		return;
+	}
 
-	// delay at least 20 microseconds (to power up) before calibration
-	for(uint16_t i =0; i<1000; i++)
-		for(uint16_t j = 0;  j<100; j++); //delay at least 20us
+	// y += (x - y) / 2^shift, done on signed values so it can step down
+	*out = (uint32_t)((int32_t)prev + (((int32_t)in - (int32_t)prev) >> JOYSTICK_IIR_SHIFT));
 
-	// calibrate, you need to digitally calibrate
-	ADC2->CR &= ~(ADC_CR_ADEN | ADC_CR_ADCALDIF); //ensure ADC is not enabled, also choose single ended calibration
-	ADC2->CR |= ADC_CR_ADCAL;       // start calibration
-	while(ADC2->CR & ADC_CR_ADCAL); // wait for calibration
+	// average change between consecutive samples, before and after the filter
+	noise->raw_delta += (sample > noise->prev_raw ? sample - noise->prev_raw : noise->prev_raw - sample) << JOYSTICK_FRAC;
+	noise->filt_delta += *out > prev ? *out - prev : prev - *out;
+	noise->count++;
+	noise->prev_raw = sample;
+}
 
-	// configure single ended mode before enabling ADC
-	ADC2->DIFSEL &= ~(ADC_DIFSEL_DIFSEL_6); // PA1 is ADC1_IN6 (found via nucleo_board.pdf), single ended mode, DIFFERENT PER CHANNEL
-	ADC2->SMPR1 |= 0x7 << 18; // configures sample period, DIFFERENT FOR EACH CHANNEL
-
-	// enable ADC
-	ADC2->ISR |= (ADC_ISR_ADRDY); // tells hardware that ADC is ready for conversion
-	ADC2->CR |= ADC_CR_ADEN; // enables the ADC
-	while(!(ADC2->ISR & ADC_ISR_ADRDY)); // waits until the ADC sets this flag low
-	ADC2->ISR |= (ADC_ISR_ADRDY); // sets the flag high again
-
-	// configure ADC
-	ADC2->SQR1 = (ADC2->SQR1 & ~(ADC_SQR1_SQ1_Msk | ADC_SQR1_L_Msk)) |(6 << ADC_SQR1_SQ1_Pos); // DIFFERENT PER CHANNEL
-	ADC2->ISR &= ~(ADC_ISR_EOC); // clears end of conversion flag
-
-	// enables interrupts
-	ADC2->IER |= (ADC_IER_EOC); // enables ADC interrupt
-	NVIC->ISER[0] |= (1 << (ADC1_2_IRQn & 0x1F)); // enables NVIC interrupt
-	__enable_irq(); // enables ARM interrupts
-
-	//configure GPIO pin PA0
-	RCC->AHB2ENR |= (RCC_AHB2ENR_GPIOAEN); 	// enables the GPIOA peripheral clock
-	GPIOA->MODER |= (GPIO_MODER_MODE1); 	// analog mode for PA1
-	GPIOA->ASCR |= GPIO_ASCR_ASC1; 			// set PA1 to analog
+// clears the noise statistics
+void joystick_stats_reset()
+{
+	joystick_stats.x.raw_delta = 0;
+	joystick_stats.x.filt_delta = 0;
+	joystick_stats.x.count = 0;
+	joystick_stats.y.raw_delta = 0;
+	joystick_stats.y.filt_delta = 0;
+	joystick_stats.y.count = 0;
 }
 
-// initializes ADC1 for reading the X coordinate on PA0
-void xcoord_adc_init()
+// returns the delay of the oversampler and IIR filter in us
+uint32_t joystick_latency_us()
 {
-//	// configures the system clock to be 32MHz for ADC
-//	SystemClock_Config();
+	// the IIR delays a step by 2^shift - 1 samples
+	// the oversampler averages over its conversions, about half of them late
+	// each conversion is 640.5 + 12.5 ADC clocks at 32MHz, about 20us
+	uint32_t sample_us = TIM6->ARR + 1; // TIM6 counts in us
+	uint32_t iir_us = ((1 << JOYSTICK_IIR_SHIFT) - 1) * sample_us;
+	uint32_t ovs_us = (JOYSTICK_OVS_RATIO * 653 / 32) / 2;
+	return iir_us + ovs_us;
+}
 
-	// turns on the clock for ADC
-	RCC->AHB2ENR |= RCC_AHB2ENR_ADCEN;
-	ADC123_COMMON->CCR = ((ADC123_COMMON->CCR & ~(ADC_CCR_CKMODE)) | ADC_CCR_CKMODE_0);
+// changes the TIM6 trigger rate of the joystick ADCs
+void joystick_set_sample_rate(uint32_t sample_hz)
+{
+	TIM6->ARR = (JOYSTICK_TIM_HZ / sample_hz) - 1;
+}
 
+// takes the ADC out of deep power down, then calibrates it for single ended inputs
+void adc_calibrate(ADC_TypeDef* adc)
+{
 	// make sure conversion isn't started
-	ADC1->CR &= ~(ADC_CR_ADSTART);
+	adc->CR &= ~(ADC_CR_ADSTART);
 
 	// take the ADC out of deep power down mode
-	ADC1->CR &= ~(ADC_CR_DEEPPWD);
+	adc->CR &= ~(ADC_CR_DEEPPWD);
 
 	// enable to voltage regulator guards the voltage
-	ADC1->CR |= (ADC_CR_ADVREGEN);
+	adc->CR |= (ADC_CR_ADVREGEN);
 
 	// delay at least 20 microseconds (to power up) before calibration
 	for(uint16_t i =0; i<1000; i++)
 		for(uint16_t j = 0;  j<100; j++); //delay at least 20us
 
 	// calibrate, you need to digitally calibrate
-	ADC1->CR &= ~(ADC_CR_ADEN | ADC_CR_ADCALDIF); //ensure ADC is not enabled, also choose single ended calibration
-	ADC1->CR |= ADC_CR_ADCAL;       // start calibration
-	while(ADC1->CR & ADC_CR_ADCAL); // wait for calibration
+	adc->CR &= ~(ADC_CR_ADEN | ADC_CR_ADCALDIF); //ensure ADC is not enabled, also choose single ended calibration
+	adc->CR |= ADC_CR_ADCAL;       // start calibration
+	while(adc->CR & ADC_CR_ADCAL) PORT_WAIT(); // wait for calibration
+}
+
+// enables the ADC and waits until it is ready
+void adc_enable(ADC_TypeDef* adc)
+{
+	adc->ISR |= (ADC_ISR_ADRDY); // tells hardware that ADC is ready for conversion
+	adc->CR |= ADC_CR_ADEN; // enables the ADC
+	while(!(adc->ISR & ADC_ISR_ADRDY)) PORT_WAIT(); // waits until the ADC sets this flag low
+	adc->ISR |= (ADC_ISR_ADRDY); // sets the flag high again
+}
+
+// initializes ADC1 (x on PA0) and ADC2 (y on PA1) in dual mode, sampled by TIM6 into DMA
+void joystick_adc_init(uint32_t sample_hz)
+{
+	// turns on the clocks for the ADCs, GPIOA, DMA1 and TIM6
+	RCC->AHB2ENR |= RCC_AHB2ENR_ADCEN | RCC_AHB2ENR_GPIOAEN;
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+	RCC->APB1ENR1 |= RCC_APB1ENR1_TIM6EN;
+
+	// common settings can only be written while both ADCs are disabled
+	// HCLK/1 clock, dual regular simultaneous mode (DUAL = 00110),
+	// one DMA request per x/y pair with both 12 bit results packed in CDR (MDMA = 10), circular DMA
+	ADC123_COMMON->CCR = (ADC123_COMMON->CCR & ~(ADC_CCR_CKMODE | ADC_CCR_DUAL | ADC_CCR_MDMA))
+			| ADC_CCR_CKMODE_0
+			| (0x6 << ADC_CCR_DUAL_Pos)
+			| (0x2 << ADC_CCR_MDMA_Pos)
+			| ADC_CCR_DMACFG;
+
+	adc_calibrate(ADC1);
+	adc_calibrate(ADC2);
 
 	// configure single ended mode before enabling ADC
 	ADC1->DIFSEL &= ~(ADC_DIFSEL_DIFSEL_5); // PA0 is ADC1_IN5 (found via nucleo_board.pdf), single ended mode
+	ADC2->DIFSEL &= ~(ADC_DIFSEL_DIFSEL_6); // PA1 is ADC2_IN6, single ended mode
 	ADC1->SMPR1 |= 0x7 << 15; // configures sample period, DIFFERENT FOR EACH CHANNEL
+	ADC2->SMPR1 |= 0x7 << 18;
+
+	// hardware oversampling on the regular channels, both ADCs need the same setting in dual mode
+	ADC1->CFGR2 = (ADC1->CFGR2 & ~(ADC_CFGR2_OVSR | ADC_CFGR2_OVSS | ADC_CFGR2_TROVS))
+			| (JOYSTICK_OVSR << ADC_CFGR2_OVSR_Pos)
+			| (JOYSTICK_OVSS << ADC_CFGR2_OVSS_Pos)
+			| ADC_CFGR2_ROVSE;
+	ADC2->CFGR2 = ADC1->CFGR2;
+
+	adc_enable(ADC1);
+	adc_enable(ADC2);
+
+	// one conversion per sequence
+	ADC1->SQR1 = (ADC1->SQR1 & ~(ADC_SQR1_SQ1_Msk | ADC_SQR1_L_Msk)) | (5 << ADC_SQR1_SQ1_Pos); // DIFFERENT PER CHANNEL
+	ADC2->SQR1 = (ADC2->SQR1 & ~(ADC_SQR1_SQ1_Msk | ADC_SQR1_L_Msk)) | (6 << ADC_SQR1_SQ1_Pos);
+
+	// ADC1 is the master, it starts both conversions on the rising edge of TIM6_TRGO (EXT13)
+	// overrun mode keeps the newest result if the DMA ever falls behind
+	ADC1->CFGR = (ADC1->CFGR & ~(ADC_CFGR_EXTEN | ADC_CFGR_EXTSEL | ADC_CFGR_CONT))
+			| ADC_CFGR_EXTEN_0
+			| (13 << ADC_CFGR_EXTSEL_Pos)
+			| ADC_CFGR_OVRMOD;
+	ADC2->CFGR = (ADC2->CFGR & ~(ADC_CFGR_CONT)) | ADC_CFGR_OVRMOD;
+
+	// no ADC interrupts, the DMA takes every result
+	ADC1->IER &= ~(ADC_IER_EOC);
+	ADC2->IER &= ~(ADC_IER_EOC);
+
+	// DMA1 channel 1 request 0 is ADC1, copies CDR into the circular buffer as 32 bit words
+	DMA1_Channel1->CCR &= ~(DMA_CCR_EN);
+	DMA1_CSELR->CSELR &= ~(DMA_CSELR_C1S);
+	DMA1_Channel1->CPAR = (uint32_t)&ADC123_COMMON->CDR;
+	DMA1_Channel1->CMAR = (uint32_t)joystick_samples;
+	DMA1_Channel1->CNDTR = JOYSTICK_DMA_LEN;
+	DMA1_Channel1->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PSIZE_1 | DMA_CCR_MSIZE_1 | DMA_CCR_PL_0;
+	DMA1_Channel1->CCR |= DMA_CCR_EN;
+
+	// arm the master, conversions now wait for the trigger
+	ADC1->CR |= ADC_CR_ADSTART;
 
-	// enable ADC
-	ADC1->ISR |= (ADC_ISR_ADRDY); // tells hardware that ADC is ready for conversion
-	ADC1->CR |= ADC_CR_ADEN; // enables the ADC
-	while(!(ADC1->ISR & ADC_ISR_ADRDY)); // waits until the ADC sets this flag low
-	ADC1->ISR |= (ADC_ISR_ADRDY); // sets the flag high again
-
-	// configure ADC
-	ADC1->SQR1 = (ADC1->SQR1 & ~(ADC_SQR1_SQ1_Msk | ADC_SQR1_L_Msk)) |(5 << ADC_SQR1_SQ1_Pos); // DIFFERENT PER CHANNEL
-	ADC1->ISR &= ~(ADC_ISR_EOC); // clears end of conversion flag
-
-	// enables interrupts
-	ADC1->IER |= (ADC_IER_EOC); // enables ADC interrupt
-	NVIC->ISER[0] |= (1 << (ADC1_2_IRQn & 0x1F)); // enables NVIC interrupt
-	__enable_irq(); // enables ARM interrupts
-
-	//configure GPIO pin PA0
-	RCC->AHB2ENR |= (RCC_AHB2ENR_GPIOAEN); 	// enables the GPIOA peripheral clock
-	GPIOA->MODER |= (GPIO_MODER_MODE0); 	// analog mode for PA0
-	GPIOA->ASCR |= GPIO_ASCR_ASC0; 			// set PA0 to analog
+	// TIM6 update event is the trigger output (MMS = 010)
+	TIM6->PSC = (JOYSTICK_CLK / JOYSTICK_TIM_HZ) - 1;
+	joystick_set_sample_rate(sample_hz);
+	TIM6->CR2 = (TIM6->CR2 & ~(TIM_CR2_MMS)) | TIM_CR2_MMS_1;
+	TIM6->EGR = TIM_EGR_UG;
+	TIM6->CR1 |= TIM_CR1_CEN;
 
-//	// start conversion
-//	ADC1->CR |= ADC_CR_ADSTART;
+	//configure GPIO pins PA0 and PA1
+	GPIOA->MODER |= (GPIO_MODER_MODE0 | GPIO_MODER_MODE1); 	// analog mode for PA0 and PA1
+	GPIOA->ASCR |= (GPIO_ASCR_ASC0 | GPIO_ASCR_ASC1); 		// connect PA0 and PA1 to the ADCs
 }
 
-// initializes the system clock to 32MHz and ADC for x coordinate and ADC for y coordinate
+// initializes the system clock to 32MHz and the joystick ADCs at the default sample rate
 void init_ADCs()
 {
 	SystemClock_Config();
-	xcoord_adc_init();
-	ycoord_adc_init();
+	joystick_adc_init(JOYSTICK_SAMPLE_HZ);
 }
 
 // error handler for system clock configuration
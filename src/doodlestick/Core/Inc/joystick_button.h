@@ -0,0 +1,247 @@
+/*
+ * joystick_button.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the joystick button events
+ *
+ *  	EDGE DETECTION
+ *  		the button on PA4 (active low) is an EXTI line 4 interrupt on both edges
+ *  		the first edge masks the line and starts the TIM16 1ms tick
+ *  		the tick runs only while the button is busy, once the button is idle
+ *  		and released the tick stops and the EXTI line is armed again
+ *
+ *  	DEBOUNCE
+ *  		the pin must read the same level for BUTTON_DEBOUNCE_MS ticks before
+ *  		the button counts as pressed or released
+ *
+ *  	CLASSIFICATION
+ *  		BUTTON_CLICK 		press and release, with no second press within BUTTON_DOUBLE_MS
+ *  		BUTTON_DOUBLE_CLICK second press within BUTTON_DOUBLE_MS of the first release
+ *  		BUTTON_LONG_PRESS 	held for BUTTON_LONG_MS, posted while still held
+ *  		each event carries the TIM5 timestamp (1us, same clock as the input
+ *  		journal) of the press that started it
+ *  		events are posted as EVENT_BUTTON into an event ring for the main
+ *  		loop, read with button_get_event()
+ *
+ *  	DEPENDENCIES
+ *  		joystick.h, event_ring.h, profile.h and telemetry.h must be included first,
+ *  		TIM5 must be running (journal_timer_init)
+ */
+
+#ifndef INC_JOYSTICK_BUTTON_H_
+#define INC_JOYSTICK_BUTTON_H_
+
+
+// defines
+#define BUTTON_DEBOUNCE_MS 	20 		// time the pin must be stable
+#define BUTTON_DOUBLE_MS 	300 	// time after a release that a second press makes a double click
+#define BUTTON_LONG_MS 		800 	// time held that makes a long press
+#define BUTTON_TICK_HZ 		1000 	// TIM16 tick while the button is busy
+#define BUTTON_TIM_HZ 		1000000 // TIM16 counts per second after the prescaler
+#define BUTTON_CLK 			32000000 // clock into TIM16, same as the system clock
+#define BUTTON_QUEUE_LEN 	8 		// events the ring can hold, must be a power of 2
+
+// typedefs
+typedef enum BUTTON_EVENT {
+		BUTTON_NONE 		= 0,
+		BUTTON_CLICK 		= 1,
+		BUTTON_DOUBLE_CLICK = 2,
+		BUTTON_LONG_PRESS 	= 3
+} BUTTON_EVENT;
+
+typedef enum BUTTON_STATE {
+		BUTTON_IDLE 		= 0, // released, nothing pending
+		BUTTON_DOWN 		= 1, // pressed, timing a long press
+		BUTTON_WAIT_SECOND 	= 2, // released after a click, waiting for a second press
+		BUTTON_HELD 		= 3  // long press posted, waiting for the release
+} BUTTON_STATE;
+
+typedef struct joystick_button
+{
+	uint8_t 	state; 				// BUTTON_STATE
+	uint8_t 	stable; 			// debounced level, 1 = pressed
+	uint8_t 	debounce; 			// ticks the pin has read the opposite of stable
+	uint8_t 	clicks; 			// completed clicks waiting for a possible double click
+	uint16_t 	ms; 				// ticks spent in the current state
+	uint32_t 	press_time; 		// TIM5 timestamp of the press that started the event
+	event 		queue[BUTTON_QUEUE_LEN]; 	// storage for the event ring
+	event_ring 	events; 			// EVENT_BUTTON events, value is the BUTTON_EVENT, posted by TIM16
+} joystick_button;
+
+joystick_button button = {0};
+
+// function declarations
+void button_events_init(); // arms the EXTI on PA4 and sets up the TIM16 debounce tick
+uint8_t button_get_event(event* ev); // takes the oldest button event, returns 0 if there is none
+void button_post_event(uint8_t type, uint32_t time); // posts a BUTTON_EVENT, counted as dropped if the ring is full
+void button_tick(); // debounces the pin and steps the click state machine, called every 1ms while busy
+void button_set_state(uint8_t state); // changes the click state and restarts its timer
+void EXTI4_IRQHandler(void); // first edge of a button action, starts the tick
+void TIM1_UP_TIM16_IRQHandler(void); // 1ms button tick
+
+
+// arms the EXTI on PA4 and sets up the TIM16 debounce tick
+void button_events_init()
+{
+	joystick_button_init();
+	ring_init(&button.events, button.queue, BUTTON_QUEUE_LEN);
+
+	// PA4 on EXTI line 4, both edges
+	RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+	SYSCFG->EXTICR[1] = (SYSCFG->EXTICR[1] & ~(SYSCFG_EXTICR2_EXTI4)) | SYSCFG_EXTICR2_EXTI4_PA;
+	EXTI->RTSR1 |= EXTI_RTSR1_RT4;
+	EXTI->FTSR1 |= EXTI_FTSR1_FT4;
+	EXTI->PR1 = EXTI_PR1_PIF4;
+	EXTI->IMR1 |= EXTI_IMR1_IM4;
+
+	// TIM16 1ms tick, started by the first edge
+	RCC->APB2ENR |= RCC_APB2ENR_TIM16EN;
+	TIM16->PSC = (BUTTON_CLK / BUTTON_TIM_HZ) - 1;
+	TIM16->ARR = (BUTTON_TIM_HZ / BUTTON_TICK_HZ) - 1;
+	TIM16->EGR = TIM_EGR_UG;
+	TIM16->SR &= ~TIM_SR_UIF;
+	TIM16->DIER |= TIM_DIER_UIE;
+
+	// enable interrupts
+	NVIC->ISER[0] = (1 << (EXTI4_IRQn & 0x1F)) | (1 << (TIM1_UP_TIM16_IRQn & 0x1F));
+	__enable_irq();
+}
+
+// takes the oldest button event, returns 0 if there is none
+uint8_t button_get_event(event* ev)
+{
+	return ring_get(&button.events, ev);
+}
+
+// posts a BUTTON_EVENT, counted as dropped if the ring is full
+void button_post_event(uint8_t type, uint32_t time)
+{
+	ring_post(&button.events, EVENT_BUTTON, type, time);
+}
+
+// changes the click state and restarts its timer
+void button_set_state(uint8_t state)
+{
+	button.state = state;
+	button.ms = 0;
+}
+
+// debounces the pin and steps the click state machine, called every 1ms while busy
+void button_tick()
+{
+	uint8_t level = get_joystick_button();
+	uint8_t pressed = 0, released = 0;
+
+	// debounce
+	if(level == button.stable)
+	{
+		button.debounce = 0;
+	}
+	else if(++button.debounce >= BUTTON_DEBOUNCE_MS)
+	{
+		button.debounce = 0;
+		button.stable = level;
+		pressed = level;
+		released = !level;
+	}
+	button.ms++;
+
+	// classify
+	switch(button.state)
+	{
+	case BUTTON_IDLE:
+		if(pressed)
+		{
+			button.clicks = 0;
+			button.press_time = TIM5->CNT - BUTTON_DEBOUNCE_MS * 1000; // when the pin first went down
+			button_set_state(BUTTON_DOWN);
+		}
+		break;
+
+	case BUTTON_DOWN:
+		if(released)
+		{
+			if(button.clicks)
+			{
+				button_post_event(BUTTON_DOUBLE_CLICK, button.press_time);
+				button_set_state(BUTTON_IDLE);
+			}
+			else
+			{
+				button.clicks = 1;
+				button_set_state(BUTTON_WAIT_SECOND);
+			}
+		}
+		else if(button.ms >= BUTTON_LONG_MS)
+		{
+			// a long second press still counts the first click
+			if(button.clicks) button_post_event(BUTTON_CLICK, button.press_time);
+			button_post_event(BUTTON_LONG_PRESS, button.press_time);
+			button_set_state(BUTTON_HELD);
+		}
+		break;
+
+	case BUTTON_WAIT_SECOND:
+		if(pressed)
+		{
+			button_set_state(BUTTON_DOWN); // keeps the first press time and click
+		}
+		else if(button.ms >= BUTTON_DOUBLE_MS)
+		{
+			button_post_event(BUTTON_CLICK, button.press_time);
+			button_set_state(BUTTON_IDLE);
+		}
+		break;
+
+	case BUTTON_HELD:
+		if(released)
+		{
+			button_set_state(BUTTON_IDLE);
+		}
+		break;
+
+	default:
+		button_set_state(BUTTON_IDLE);
+		break;
+	}
+
+	// nothing pending, stop the tick and wait for the next edge
+	if(button.state == BUTTON_IDLE && !button.stable && !button.debounce)
+	{
+		TIM16->CR1 &= ~TIM_CR1_CEN;
+		EXTI->PR1 = EXTI_PR1_PIF4;
+		EXTI->IMR1 |= EXTI_IMR1_IM4;
+	}
+}
+
+// first edge of a button action, starts the tick
+void EXTI4_IRQHandler(void)
+{
+	PROFILE_BEGIN(PROFILE_EXTI4);
+	telemetry.isr[TELEMETRY_ISR_EXTI4]++;
+	if(EXTI->PR1 & EXTI_PR1_PIF4)
+	{
+		EXTI->PR1 = EXTI_PR1_PIF4; 		// clear pending
+		EXTI->IMR1 &= ~EXTI_IMR1_IM4; 	// the tick follows the bounces from here
+
+		TIM16->CNT = 0;
+		TIM16->CR1 |= TIM_CR1_CEN;
+	}
+	PROFILE_END(PROFILE_EXTI4);
+}
+
+// 1ms button tick
+void TIM1_UP_TIM16_IRQHandler(void)
+{
+	PROFILE_BEGIN(PROFILE_TIM16);
+	telemetry.isr[TELEMETRY_ISR_TIM16]++;
+	if(TIM16->SR & TIM_SR_UIF)
+	{
+		TIM16->SR &= ~TIM_SR_UIF; // reset interrupt flag
+		button_tick();
+	}
+	PROFILE_END(PROFILE_TIM16);
+}
+
+#endif /* INC_JOYSTICK_BUTTON_H_ */
@@ -0,0 +1,366 @@
+/*
+ * joystick_cal.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the joystick calibration
+ *
+ *  	BOOT CALIBRATION
+ *  		the stick must be left at rest while the board starts
+ *  		the neutral point is the average of JOYSTICK_CAL_BATCHES full passes
+ *  		of the circular DMA buffer from joystick.h, each pass is picked up
+ *  		when the DMA transfer complete flag says the buffer wrapped
+ *  		a pass that doesn't come within JOYSTICK_CAL_WAIT_US means the ADC
+ *  		isn't converting, the stored or default calibration is kept as it is
+ *
+ *  	CONTINUOUS CALIBRATION
+ *  		while the stick sits inside the dead zone the neutral point follows
+ *  		the samples slowly, by 1/2^JOYSTICK_CAL_TRACK_SHIFT of the error per call
+ *  		the range grows while the samples stay past the stored min or max,
+ *  		by at most JOYSTICK_CAL_WIDEN per call, so a single glitch stretches
+ *  		it by a few lsb instead of to the glitch and into the flash
+ *  		the deflection of each direction is scaled by the range on that side
+ *  		of the neutral point, so full deflection means the same on each stick
+ *
+ *  	QUANTIZING
+ *  		axis_quantize() gives the sample the mode logic and the journal use,
+ *  		the neutral point inside the dead zone and otherwise the last sample
+ *  		until the stick moves JOYSTICK_CAL_STEP away, so the noise of a stick
+ *  		at rest or held still doesn't become journal entries
+ *
+ *  	FLASH STORAGE
+ *  		the calibration is kept in the last 2KB page of flash bank 2
+ *  		(0x080FF800), which the linker script leaves out of the FLASH region
+ *  		it is loaded at boot for the range and written again once the
+ *  		neutral point or range has drifted far enough from the stored copy
+ *
+ *  	DEPENDENCIES
+ *  		joystick.h must be included first
+ *  		TIM5 must be counting microseconds (journal_timer_init() in
+ *  		input_journal.h) before joystick_cal_init() is called
+ */
+
+#ifndef INC_JOYSTICK_CAL_H_
+#define INC_JOYSTICK_CAL_H_
+
+
+// defines
+#define JOYSTICK_DEFAULT_X_NEUTRAL 	2050 	// neutral points of the original joystick, used before the first samples
+#define JOYSTICK_DEFAULT_Y_NEUTRAL 	1950
+#define JOYSTICK_DEFAULT_SPAN 		1600 	// range on each side of neutral until the stick has been pushed further
+#define JOYSTICK_CAL_BATCHES 		8 		// DMA buffer passes averaged at boot
+#define JOYSTICK_CAL_TRACK_SHIFT 	8 		// neutral point tracking speed, 1/256 of the error per call
+#define JOYSTICK_CAL_DEADZONE 		16 		// dead zone is 1/16 of the range on each side of neutral
+#define JOYSTICK_FULL_DEFLECTION 	256 	// axis_deflection() at the end of the range, 8 fractional bits
+#define JOYSTICK_CAL_WIDEN 			4 		// range growth (lsb) per call while a sample is past the min or max
+#define JOYSTICK_CAL_WAIT_US 		100000 	// wait for a DMA buffer pass (us) before the ADC is taken as stopped
+#define JOYSTICK_CAL_STEP 			16 		// move (lsb) outside the dead zone before axis_quantize() passes a new sample
+#define JOYSTICK_CAL_SAVE_DRIFT 	24 		// neutral drift (lsb) before the calibration is stored again
+#define JOYSTICK_CAL_SAVE_RANGE 	64 		// range growth (lsb) before the calibration is stored again
+#define JOYSTICK_CAL_MAGIC 			0x4A43414C // "JCAL"
+#define JOYSTICK_CAL_ADDR 			0x080FF800 // last page of bank 2
+#define JOYSTICK_CAL_PAGE 			255
+#define JOYSTICK_CAL_BANK 			FLASH_BANK_2
+
+// typedefs
+typedef struct axis_cal
+{
+	uint16_t neutral; 		// rest position
+	uint16_t min, max; 		// furthest positions seen on each side
+	uint32_t neutral_q8; 	// rest position with 8 fractional bits, for the slow tracking
+} axis_cal;
+
+typedef struct joystick_cal_record
+{
+	uint32_t magic;
+	uint16_t x_neutral, x_min, x_max;
+	uint16_t y_neutral, y_min, y_max;
+	uint32_t checksum;
+	uint32_t pad; 			// flash is written in 64 bit double words
+} joystick_cal_record;
+
+typedef struct joystick_calibration
+{
+	axis_cal x, y;
+	joystick_cal_record saved; // copy of what is in flash
+} joystick_calibration;
+
+// calibration used by the cursor
+joystick_calibration joystick_cal;
+
+// function declarations
+void joystick_cal_init(); // loads the stored calibration, then measures the neutral point from the DMA buffer
+void joystick_cal_track(uint16_t x, uint16_t y); // follows the neutral point while idle and widens the range
+uint8_t joystick_cal_idle(uint16_t x, uint16_t y); // returns 1 if both axes are inside the dead zone
+int16_t axis_deflection(const axis_cal* a, uint16_t sample); // returns the signed deflection past the dead zone, -256 to 256
+uint16_t axis_quantize(const axis_cal* a, uint16_t sample, uint16_t last); // returns neutral inside the dead zone, else last until the sample moved JOYSTICK_CAL_STEP from it
+uint16_t axis_upper_span(const axis_cal* a); // returns the range from the neutral point to the max
+uint16_t axis_lower_span(const axis_cal* a); // returns the range from the min to the neutral point
+void axis_set_neutral(axis_cal* a, uint16_t neutral); // sets the neutral point and the tracking state
+void axis_default_range(axis_cal* a); // sets the range to the default span around the neutral point
+uint8_t joystick_cal_load(); // loads the calibration from flash, returns 1 if a valid one was found
+void joystick_cal_save(); // writes the calibration to flash if it has drifted from the stored copy
+uint32_t joystick_cal_checksum(const joystick_cal_record* r); // returns the checksum of the record fields
+uint16_t cal_distance(uint16_t a, uint16_t b); // returns the absolute difference of two samples
+
+
+// loads the stored calibration, then measures the neutral point from the DMA buffer
+void joystick_cal_init()
+{
+	uint32_t x_sum = 0, y_sum = 0;
+	uint8_t loaded = joystick_cal_load(); // range of this stick from an earlier run
+
+	// average whole passes of the DMA buffer, the stick is at rest during boot
+	for(uint8_t batch = 0; batch < JOYSTICK_CAL_BATCHES; batch++)
+	{
+		uint32_t start = TIM5->CNT;
+		DMA1->IFCR = DMA_IFCR_CTCIF1; 			// clear transfer complete
+		while(!(DMA1->ISR & DMA_ISR_TCIF1)) 	// wait for the buffer to wrap
+		{
+			// no samples are coming, don't average or store garbage
+			if(TIM5->CNT - start > JOYSTICK_CAL_WAIT_US)
+			{
+				if(!loaded)
+				{
+					axis_set_neutral(&joystick_cal.x, JOYSTICK_DEFAULT_X_NEUTRAL);
+					axis_set_neutral(&joystick_cal.y, JOYSTICK_DEFAULT_Y_NEUTRAL);
+					axis_default_range(&joystick_cal.x);
+					axis_default_range(&joystick_cal.y);
+				}
+				return;
+			}
+		}
+
+		for(uint8_t i = 0; i < JOYSTICK_DMA_LEN; i++)
+		{
+			x_sum += joystick_samples[i] & 0xFFFF;
+			y_sum += joystick_samples[i] >> 16;
+		}
+	}
+	axis_set_neutral(&joystick_cal.x, x_sum / (JOYSTICK_CAL_BATCHES * JOYSTICK_DMA_LEN));
+	axis_set_neutral(&joystick_cal.y, y_sum / (JOYSTICK_CAL_BATCHES * JOYSTICK_DMA_LEN));
+
+	// without a stored range start narrow, it grows the first time the stick is pushed to its ends
+	if(!loaded)
+	{
+		axis_default_range(&joystick_cal.x);
+		axis_default_range(&joystick_cal.y);
+	}
+
+	// store it if it moved since the last boot
+	joystick_cal_save();
+
+	// the passes averaged above aren't a lap of the filter
+	joystick_filter_restart();
+}
+
+// follows the neutral point while idle and widens the range
+void joystick_cal_track(uint16_t x, uint16_t y)
+{
+	axis_cal* axes[2] = {&joystick_cal.x, &joystick_cal.y};
+	uint16_t samples[2] = {x, y};
+
+	for(uint8_t i = 0; i < 2; i++)
+	{
+		axis_cal* a = axes[i];
+
+		// the range only grows, a step at a time
+		if(samples[i] < a->min)
+		{
+			uint16_t past = a->min - samples[i];
+			a->min -= past < JOYSTICK_CAL_WIDEN ? past : JOYSTICK_CAL_WIDEN;
+		}
+		if(samples[i] > a->max)
+		{
+			uint16_t past = samples[i] - a->max;
+			a->max += past < JOYSTICK_CAL_WIDEN ? past : JOYSTICK_CAL_WIDEN;
+		}
+	}
+
+	// the neutral point only moves while the stick is left alone
+	if(joystick_cal_idle(x, y))
+	{
+		for(uint8_t i = 0; i < 2; i++)
+		{
+			axis_cal* a = axes[i];
+			int32_t error = ((int32_t)samples[i] << 8) - (int32_t)a->neutral_q8;
+			a->neutral_q8 += error >> JOYSTICK_CAL_TRACK_SHIFT;
+			a->neutral = (a->neutral_q8 + 0x80) >> 8;
+		}
+
+		// only written while idle, so the flash stall can't be felt
+		joystick_cal_save();
+	}
+}
+
+// returns 1 if both axes are inside the dead zone
+uint8_t joystick_cal_idle(uint16_t x, uint16_t y)
+{
+	const axis_cal* axes[2] = {&joystick_cal.x, &joystick_cal.y};
+	uint16_t samples[2] = {x, y};
+
+	for(uint8_t i = 0; i < 2; i++)
+	{
+		const axis_cal* a = axes[i];
+		if(samples[i] > a->neutral + axis_upper_span(a) / JOYSTICK_CAL_DEADZONE) return 0;
+		if(samples[i] + axis_lower_span(a) / JOYSTICK_CAL_DEADZONE < a->neutral) return 0;
+	}
+	return 1;
+}
+
+// returns the signed deflection past the dead zone, -256 to 256
+int16_t axis_deflection(const axis_cal* a, uint16_t sample)
+{
+	uint16_t span = sample >= a->neutral ? axis_upper_span(a) : axis_lower_span(a);
+	uint16_t dead = span / JOYSTICK_CAL_DEADZONE;
+	uint16_t dist = cal_distance(sample, a->neutral);
+	int32_t deflection;
+
+	if(dist <= dead || span <= dead)
+	{
+		return 0;
+	}
+
+	// 0 at the edge of the dead zone, full deflection at the end of the range
+	deflection = (int32_t)(dist - dead) * JOYSTICK_FULL_DEFLECTION / (span - dead);
+	if(deflection > JOYSTICK_FULL_DEFLECTION) deflection = JOYSTICK_FULL_DEFLECTION;
+
+	return sample >= a->neutral ? deflection : -deflection;
+}
+
+// returns neutral inside the dead zone, else last until the sample moved JOYSTICK_CAL_STEP from it
+uint16_t axis_quantize(const axis_cal* a, uint16_t sample, uint16_t last)
+{
+	if(axis_deflection(a, sample) == 0)
+	{
+		return a->neutral;
+	}
+
+	// coming out of the dead zone is always a step, the noise of a held stick isn't
+	if(axis_deflection(a, last) != 0 && cal_distance(sample, last) < JOYSTICK_CAL_STEP)
+	{
+		return last;
+	}
+	return sample;
+}
+
+// returns the range from the neutral point to the max
+uint16_t axis_upper_span(const axis_cal* a)
+{
+	return a->max > a->neutral ? a->max - a->neutral : 0;
+}
+
+// returns the range from the min to the neutral point
+uint16_t axis_lower_span(const axis_cal* a)
+{
+	return a->neutral > a->min ? a->neutral - a->min : 0;
+}
+
+// sets the neutral point and the tracking state
+void axis_set_neutral(axis_cal* a, uint16_t neutral)
+{
+	a->neutral = neutral;
+	a->neutral_q8 = (uint32_t)neutral << 8;
+}
+
+// sets the range to the default span around the neutral point
+void axis_default_range(axis_cal* a)
+{
+	a->min = a->neutral > JOYSTICK_DEFAULT_SPAN ? a->neutral - JOYSTICK_DEFAULT_SPAN : 0;
+	a->max = a->neutral + JOYSTICK_DEFAULT_SPAN < 4095 ? a->neutral + JOYSTICK_DEFAULT_SPAN : 4095;
+}
+
+// loads the calibration from flash, returns 1 if a valid one was found
+uint8_t joystick_cal_load()
+{
+	const joystick_cal_record* r = (const joystick_cal_record*)PORT_FLASH(JOYSTICK_CAL_ADDR);
+
+	if(r->magic != JOYSTICK_CAL_MAGIC || r->checksum != joystick_cal_checksum(r))
+	{
+		return 0; // erased or corrupt, keep the defaults
+	}
+
+	joystick_cal.saved = *r;
+	joystick_cal.x.min = r->x_min;
+	joystick_cal.x.max = r->x_max;
+	joystick_cal.y.min = r->y_min;
+	joystick_cal.y.max = r->y_max;
+	axis_set_neutral(&joystick_cal.x, r->x_neutral);
+	axis_set_neutral(&joystick_cal.y, r->y_neutral);
+	return 1;
+}
+
+// writes the calibration to flash if it has drifted from the stored copy
+void joystick_cal_save()
+{
+	joystick_cal_record r;
+	const joystick_cal_record* old = &joystick_cal.saved;
+
+	r.magic = JOYSTICK_CAL_MAGIC;
+	r.x_neutral = joystick_cal.x.neutral;
+	r.x_min = joystick_cal.x.min;
+	r.x_max = joystick_cal.x.max;
+	r.y_neutral = joystick_cal.y.neutral;
+	r.y_min = joystick_cal.y.min;
+	r.y_max = joystick_cal.y.max;
+	r.checksum = joystick_cal_checksum(&r);
+	r.pad = 0xFFFFFFFF;
+
+	// only wear the flash when something moved far enough
+	if(old->magic == JOYSTICK_CAL_MAGIC
+			&& cal_distance(r.x_neutral, old->x_neutral) < JOYSTICK_CAL_SAVE_DRIFT
+			&& cal_distance(r.y_neutral, old->y_neutral) < JOYSTICK_CAL_SAVE_DRIFT
+			&& old->x_min - r.x_min < JOYSTICK_CAL_SAVE_RANGE
+			&& r.x_max - old->x_max < JOYSTICK_CAL_SAVE_RANGE
+			&& old->y_min - r.y_min < JOYSTICK_CAL_SAVE_RANGE
+			&& r.y_max - old->y_max < JOYSTICK_CAL_SAVE_RANGE)
+	{
+		return;
+	}
+
+	// erase the page, then program the record one double word at a time
+	FLASH_EraseInitTypeDef erase = {0};
+	uint32_t page_error = 0;
+	erase.TypeErase = FLASH_TYPEERASE_PAGES;
+	erase.Banks = JOYSTICK_CAL_BANK;
+	erase.Page = JOYSTICK_CAL_PAGE;
+	erase.NbPages = 1;
+
+	HAL_FLASH_Unlock();
+	if(HAL_FLASHEx_Erase(&erase, &page_error) == HAL_OK)
+	{
+		const uint64_t* words = (const uint64_t*)&r;
+		for(uint8_t i = 0; i < sizeof(r) / sizeof(uint64_t); i++)
+		{
+			if(HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, JOYSTICK_CAL_ADDR + i * 8, words[i]) != HAL_OK)
+			{
+				break;
+			}
+		}
+	}
+	HAL_FLASH_Lock();
+
+	// remember what was stored even if the write failed, so it isn't retried every call
+	joystick_cal.saved = r;
+}
+
+// returns the checksum of the record fields
+uint32_t joystick_cal_checksum(const joystick_cal_record* r)
+{
+	uint32_t sum = r->magic;
+	sum = (sum << 5) + sum + r->x_neutral;
+	sum = (sum << 5) + sum + r->x_min;
+	sum = (sum << 5) + sum + r->x_max;
+	sum = (sum << 5) + sum + r->y_neutral;
+	sum = (sum << 5) + sum + r->y_min;
+	sum = (sum << 5) + sum + r->y_max;
+	return ~sum;
+}
+
+// returns the absolute difference of two samples
+uint16_t cal_distance(uint16_t a, uint16_t b)
+{
+	return a > b ? a - b : b - a;
+}
+
+#endif /* INC_JOYSTICK_CAL_H_ */
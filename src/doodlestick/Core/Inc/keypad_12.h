@@ -5,6 +5,44 @@
  *      Author: jackkrammer
  *
  *  header file for the COM-14662 keypad
+ *
+ *  	TIMER SCAN
+ *  		keypad_scan_init() scans the keypad from the TIM7 interrupt
+ *  		each interrupt reads the rows of the column driven by the previous
+ *  		interrupt, so every column gets one scan period to settle, then
+ *  		drives the next column
+ *  		every key has its own debounce counter, a key only changes state
+ *  		after reading the new state for the whole debounce time
+ *  		each change is posted as an EVENT_KEY_PRESS or EVENT_KEY_RELEASE event
+ *  		into an event ring that the main loop reads with keypad_get_event()
+ *  		(event_ring.h must be included first)
+ *  		the interrupts are counted in telemetry.h and timed in profile.h, which
+ *  		must be included first
+ *
+ *  	ROLLOVER AND GHOSTING
+ *  		any number of keys can be held, keypad_scan.state is the debounced
+ *  		bitmask of all of them (bit n is keypad index n)
+ *  		the keypad has no diodes, so with three keys held on the corners of
+ *  		a rectangle the fourth corner reads as pressed too
+ *  		a new press is not accepted while the raw matrix holds a rectangle,
+ *  		keypad_has_ghost() checks a bitmask for one
+ *
+ *  	IDLE
+ *  		after KEYPAD_IDLE_MS with no key down the scan timer is stopped,
+ *  		all columns are driven high and the row pins (PC0..PC3) are armed
+ *  		as rising edge EXTI interrupts
+ *  		a key press raises its row, the EXTI interrupt then restarts the
+ *  		timer scan which debounces the press as usual
+ *  		while idle the keypad costs no CPU time, so the core can sleep
+ *
+ *  	WHY ONE COLUMN PER INTERRUPT
+ *  		the keypad used to be polled, every column driven and read in one
+ *  		pass that returned the first key it found
+ *  		a one pass scan has to wait for the driven column to settle before
+ *  		reading it, three times per pass, so it was replaced by the column
+ *  		per TIM7 interrupt scan above and its polling functions removed
+ *  		the 12 bit mask a full pass would return is keypad_scan.state, with
+ *  		the ghost check of keypad_has_ghost() on the raw readings
  */
 
 #ifndef SRC_KEYPAD_12_H_
@@ -12,6 +50,33 @@
 
 #define NUM_COL 	3
 #define NUM_ROW 	4
+#define NUM_KEYS 	(NUM_ROW * NUM_COL)
+
+#define KEYPAD_SCAN_HZ 		3000 	// default column scan rate, each key is read at KEYPAD_SCAN_HZ / NUM_COL
+#define KEYPAD_DEBOUNCE_MS 	10 		// default time a key must read the same before its state changes
+#define KEYPAD_TIM_HZ 		1000000 // TIM7 counts per second after the prescaler
+#define KEYPAD_CLK 			32000000 // clock into TIM7, same as the system clock
+#define KEYPAD_QUEUE_LEN 	16 		// events the queue can hold, must be a power of 2
+#define KEYPAD_IDLE_MS 		100 	// time with no key down before the scan stops and waits on the row EXTI
+#define KEYPAD_COL_PINS 	(GPIO_ODR_OD4 | GPIO_ODR_OD5 | GPIO_ODR_OD6)
+#define KEYPAD_ROW_LINES 	(EXTI_IMR1_IM0 | EXTI_IMR1_IM1 | EXTI_IMR1_IM2 | EXTI_IMR1_IM3)
+
+// typedefs
+typedef struct keypad_scanner
+{
+	uint8_t 	col; 					// column being driven
+	uint8_t 	debounce_scans; 		// scans a key must read the same before it changes
+	uint16_t 	idle_scans; 			// full scans with no key down before going idle
+	uint16_t 	quiet; 					// full scans in a row with no key down and nothing bouncing
+	volatile uint8_t idle; 				// 1 while the scan is stopped and the rows wait on EXTI
+	uint8_t 	count[NUM_KEYS]; 		// scans each key has read the opposite of its state
+	uint16_t 	state; 					// debounced state, bit per keypad index
+	uint16_t 	raw; 					// last reading of every key, bit per keypad index
+	event 		queue[KEYPAD_QUEUE_LEN]; 	// storage for the event ring
+	event_ring 	events; 				// press and release events, posted by TIM7
+} keypad_scanner;
+
+keypad_scanner keypad_scan = {0};
 
 const char keypad_chars[NUM_ROW * NUM_COL] = {
 	'1', '2', '3',
@@ -28,100 +93,244 @@ const uint8_t keypad_vals[NUM_ROW * NUM_COL] = {
 };
 
 void keypad_init(); // initializes keypad
-int8_t loop_keypad_once(); // returns index of button pressed or -1 if nothing is pressed
-int8_t multiplex_keypad(); // returns index of button pressed by multiplexing keypad until button is pressed
-char get_keypad_char(); // returns the char of the button pressed, null if invalid or error
-int8_t get_keypad_value(); // returns the value of the button pressed, -1 if invalid or error
-
-
-// returns the value of the button pressed, -1 if invalid or error
-int8_t get_keypad_value()
+uint8_t keypad_has_ghost(uint16_t keys); // returns 1 if the keys hold a rectangle, so one of its corners may be a ghost
+uint16_t keypad_row_bits(uint16_t keys, uint8_t row); // returns the column bits of one row of a key bitmask
+void keypad_scan_init(uint32_t scan_hz, uint32_t debounce_ms); // starts scanning the keypad from the TIM7 interrupt
+uint8_t keypad_get_event(event* ev); // takes the oldest key event, returns 0 if there is none
+void keypad_scan_column(); // debounces the rows of the driven column, then drives the next column
+void keypad_post_event(uint8_t index, uint8_t pressed); // posts a press or release event, counted as dropped if the ring is full
+void TIM7_IRQHandler(void); // scans one keypad column
+void keypad_idle(); // stops the scan, drives every column and waits for a row edge on EXTI
+void keypad_wake(); // stops waiting on the rows and restarts the timer scan
+void keypad_row_irq(); // any row went high while idle, starts scanning again
+void EXTI0_IRQHandler(void); // row 1 went high
+void EXTI1_IRQHandler(void); // row 2 went high
+void EXTI2_IRQHandler(void); // row 3 went high
+void EXTI3_IRQHandler(void); // row 4 went high
+
+
+// returns 1 if the keys hold a rectangle, so one of its corners may be a ghost
+uint8_t keypad_has_ghost(uint16_t keys)
 {
-	int8_t index = multiplex_keypad(); // get the index
-
-	if(index != -1)
+	// two rows sharing two or more columns make a rectangle
+	for(uint8_t a = 0; a < NUM_ROW; a++)
 	{
-		return keypad_vals[index];
+		for(uint8_t b = a + 1; b < NUM_ROW; b++)
+		{
+			uint16_t shared = keypad_row_bits(keys, a) & keypad_row_bits(keys, b);
+			if(shared & (shared - 1)) // more than one bit set
+			{
+				return 1;
+			}
+		}
 	}
+	return 0;
+}
 
-	return -1;
+// returns the column bits of one row of a key bitmask
+uint16_t keypad_row_bits(uint16_t keys, uint8_t row)
+{
+	return (keys >> (NUM_COL * row)) & ((1 << NUM_COL) - 1);
 }
 
-// returns the char of the button pressed
-char get_keypad_char()
+// starts scanning the keypad from the TIM7 interrupt
+void keypad_scan_init(uint32_t scan_hz, uint32_t debounce_ms)
 {
-	int8_t index = multiplex_keypad(); // get the index
+	// debounce time in whole scans of the matrix
+	uint32_t scans = debounce_ms * (scan_hz / NUM_COL) / 1000;
+	keypad_scan.debounce_scans = scans > 0 ? (scans < 255 ? scans : 255) : 1;
+	keypad_scan.idle_scans = KEYPAD_IDLE_MS * (scan_hz / NUM_COL) / 1000;
+	keypad_scan.quiet = 0;
+	keypad_scan.idle = 0;
+	ring_init(&keypad_scan.events, keypad_scan.queue, KEYPAD_QUEUE_LEN);
+
+	// rows PC0..PC3 on EXTI lines 0..3, rising edge, left masked until idle
+	RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+	SYSCFG->EXTICR[0] = (SYSCFG->EXTICR[0] & ~(SYSCFG_EXTICR1_EXTI0 | SYSCFG_EXTICR1_EXTI1 |
+						SYSCFG_EXTICR1_EXTI2 | SYSCFG_EXTICR1_EXTI3))
+						| SYSCFG_EXTICR1_EXTI0_PC | SYSCFG_EXTICR1_EXTI1_PC
+						| SYSCFG_EXTICR1_EXTI2_PC | SYSCFG_EXTICR1_EXTI3_PC;
+	EXTI->IMR1 &= ~KEYPAD_ROW_LINES;
+	EXTI->RTSR1 |= KEYPAD_ROW_LINES;
+	EXTI->FTSR1 &= ~KEYPAD_ROW_LINES;
+	EXTI->PR1 = KEYPAD_ROW_LINES;
+	NVIC->ISER[0] = (1 << (EXTI0_IRQn & 0x1F)) | (1 << (EXTI1_IRQn & 0x1F))
+					| (1 << (EXTI2_IRQn & 0x1F)) | (1 << (EXTI3_IRQn & 0x1F));
+
+	// drive the first column so it settles before the first interrupt
+	keypad_scan.col = 0;
+	GPIOC->ODR &= ~(GPIO_ODR_OD4 | GPIO_ODR_OD5 | GPIO_ODR_OD6);
+	GPIOC->BSRR = (1 << NUM_ROW);
 
-	if(index != -1) // there is a valid index
-	{
-		return keypad_chars[index];
-	}
+	// enable the clock for TIM7
+	RCC->APB1ENR1 |= RCC_APB1ENR1_TIM7EN;
+
+	// one update per column scan
+	TIM7->PSC = (KEYPAD_CLK / KEYPAD_TIM_HZ) - 1;
+	TIM7->ARR = (KEYPAD_TIM_HZ / scan_hz) - 1;
+	TIM7->EGR = TIM_EGR_UG;
+	TIM7->SR &= ~TIM_SR_UIF;
+
+	// enable interrupts
+	TIM7->DIER |= TIM_DIER_UIE;
+	NVIC->ISER[TIM7_IRQn >> 5] = (1 << (TIM7_IRQn & 0x1F));
+	__enable_irq();
+
+	// start timer
+	TIM7->CR1 |= TIM_CR1_CEN;
+}
 
-	return '\0';
+// takes the oldest key event, returns 0 if there is none
+uint8_t keypad_get_event(event* ev)
+{
+	return ring_get(&keypad_scan.events, ev);
 }
 
-// returns index of button pressed or -1 if nothing is pressed
-int8_t loop_keypad_once()
+// posts a press or release event, counted as dropped if the ring is full
+void keypad_post_event(uint8_t index, uint8_t pressed)
 {
-	uint8_t col, row = 0;
+	ring_post(&keypad_scan.events, pressed ? EVENT_KEY_PRESS : EVENT_KEY_RELEASE, index, TIM5->CNT);
+}
 
-	// clear column ODR
-	GPIOC->ODR &= ~(GPIO_ODR_OD4 | GPIO_ODR_OD5 | GPIO_ODR_OD6);
+// debounces the rows of the driven column, then drives the next column
+void keypad_scan_column()
+{
+	uint8_t col = keypad_scan.col;
+	uint32_t rows = GPIOC->IDR;
+
+	// update this column in the raw reading of the whole matrix
+	for(uint8_t row = 0; row < NUM_ROW; row++)
+	{
+		uint16_t bit = 1 << (NUM_COL * row + col);
+		if(rows & (1 << row)) keypad_scan.raw |= bit;
+		else keypad_scan.raw &= ~bit;
+	}
 
-	// drive each column once
-	for(col = 0; col < NUM_COL; col++)
+	for(uint8_t row = 0; row < NUM_ROW; row++)
 	{
-		// drive column
-		GPIOC->BSRR = (1 << NUM_ROW) << col;
+		uint8_t index = NUM_COL * row + col;
+		uint8_t raw = !!(rows & (1 << row));
+		uint8_t state = !!(keypad_scan.state & (1 << index));
 
-		// check rows
-		for(row = 0; row < NUM_ROW; row++)
+		if(raw == state)
 		{
-			if(GPIOC->IDR & (1 << row))
+			keypad_scan.count[index] = 0; // bounced back, start over
+		}
+		else if(++keypad_scan.count[index] >= keypad_scan.debounce_scans)
+		{
+			// a press that could be a ghost waits until the rectangle is gone
+			if(raw && keypad_has_ghost(keypad_scan.raw))
 			{
-				return NUM_COL * row + col;
+				keypad_scan.count[index] = keypad_scan.debounce_scans - 1;
+				continue;
 			}
+
+			keypad_scan.count[index] = 0;
+			keypad_scan.state ^= (1 << index);
+			keypad_post_event(index, raw);
 		}
+	}
 
-		// disable column
-		GPIOC->BSRR = ((1 << GPIO_BSRR_BR0_Pos) << NUM_ROW) << col;
+	// disable column, drive the next one, it settles until the next interrupt
+	GPIOC->BSRR = ((1 << GPIO_BSRR_BR0_Pos) << NUM_ROW) << col;
+	col = (col + 1) % NUM_COL;
+	GPIOC->BSRR = (1 << NUM_ROW) << col;
+	keypad_scan.col = col;
+
+	// after each full scan, count how long nothing has happened
+	if(col == 0)
+	{
+		uint8_t bouncing = 0;
+		for(uint8_t i = 0; i < NUM_KEYS; i++) bouncing |= keypad_scan.count[i];
+
+		if(keypad_scan.state || bouncing) keypad_scan.quiet = 0;
+		else if(++keypad_scan.quiet >= keypad_scan.idle_scans) keypad_idle();
 	}
+}
+
+// stops the scan, drives every column and waits for a row edge on EXTI
+void keypad_idle()
+{
+	TIM7->CR1 &= ~TIM_CR1_CEN;
+	keypad_scan.idle = 1;
+
+	// any key now connects a high column to its row
+	GPIOC->BSRR = KEYPAD_COL_PINS;
+
+	EXTI->PR1 = KEYPAD_ROW_LINES;
+	EXTI->IMR1 |= KEYPAD_ROW_LINES;
 
-	return -1;
+	// a key that went down before the EXTI was armed made no edge
+	if(GPIOC->IDR & 0xF)
+	{
+		keypad_wake();
+	}
 }
 
+// stops waiting on the rows and restarts the timer scan
+void keypad_wake()
+{
+	EXTI->IMR1 &= ~KEYPAD_ROW_LINES;
+	EXTI->PR1 = KEYPAD_ROW_LINES;
+
+	// back to one column at a time, starting from the first
+	GPIOC->BSRR = KEYPAD_COL_PINS << GPIO_BSRR_BR0_Pos;
+	keypad_scan.col = 0;
+	GPIOC->BSRR = (1 << NUM_ROW);
+	keypad_scan.quiet = 0;
+	keypad_scan.idle = 0;
+
+	TIM7->CNT = 0;
+	TIM7->CR1 |= TIM_CR1_CEN;
+}
 
-// returns index of button pressed by multiplexing keypad until button is pressed
-int8_t multiplex_keypad()
+// any row went high while idle, starts scanning again
+void keypad_row_irq()
 {
-	uint8_t col, row = 0;
+	PROFILE_BEGIN(PROFILE_KEYPAD_ROW);
+	telemetry.isr[TELEMETRY_ISR_KEYPAD_ROW]++;
+	if(EXTI->PR1 & KEYPAD_ROW_LINES)
+	{
+		keypad_wake();
+	}
+	PROFILE_END(PROFILE_KEYPAD_ROW);
+}
 
-	// clear column ODR
-	GPIOC->ODR &= ~(GPIO_ODR_OD4 | GPIO_ODR_OD5 | GPIO_ODR_OD6);
+// row 1 went high
+void EXTI0_IRQHandler(void)
+{
+	keypad_row_irq();
+}
 
-	// multiplex columns
-	while(1)
-	{
-		// drive column
-		GPIOC->BSRR = (1 << NUM_ROW) << col;
+// row 2 went high
+void EXTI1_IRQHandler(void)
+{
+	keypad_row_irq();
+}
 
-		// check rows
-		for(row = 0; row < NUM_ROW; row++)
-		{
-			if(GPIOC->IDR & (1 << row))
-			{
-				return NUM_COL * row + col;
-			}
-		}
+// row 3 went high
+void EXTI2_IRQHandler(void)
+{
+	keypad_row_irq();
+}
 
-		// disable column
-		GPIOC->BSRR = ((1 << GPIO_BSRR_BR0_Pos) << NUM_ROW) << col;
+// row 4 went high
+void EXTI3_IRQHandler(void)
+{
+	keypad_row_irq();
+}
 
-		// go to next column, loops through
-		col = (col + 1) % NUM_COL;
+// scans one keypad column
+void TIM7_IRQHandler(void)
+{
+	PROFILE_BEGIN(PROFILE_TIM7);
+	telemetry.isr[TELEMETRY_ISR_TIM7]++;
+	if(TIM7->SR & TIM_SR_UIF)
+	{
+		TIM7->SR &= ~TIM_SR_UIF; // reset interrupt flag
+		keypad_scan_column();
 	}
-
-	return -1;
+	PROFILE_END(PROFILE_TIM7);
 }
 
 void keypad_init()
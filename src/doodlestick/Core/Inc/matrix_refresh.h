@@ -0,0 +1,173 @@
+/*
+ * matrix_refresh.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for refreshing the RGB matrix from the TIM3 interrupt
+ *
+ *  	SECTIONS
+ *  		the panel shows one section (row y and row y + 8) at a time, so it
+ *  		has to be redrawn all the time even when the image doesn't change
+ *  		TIM3 interrupts MATRIX_SECTIONS times per frame, each interrupt
+ *  		latches the section shifted in by the one before and lights it,
+ *  		then shifts the next section's columns in while this one is shown
+ *  		every section is lit for the same time, so the brightness is even
+ *  		and the main loop never waits on the panel, it only writes the
+ *  		matrix buffer, which the next pass of the interrupt picks up
+ *
+ *  	BRIGHTNESS
+ *  		TIM3 CC1 turns the output off part way through each section,
+ *  		below 100% the section is dark for the rest of its period
+ *  		0% leaves the output off, matrix_refresh_stop() also stops the timer
+ *
+ *  	DEPENDENCIES
+ *  		rgb_matrix.h, profile.h and telemetry.h must be included first
+ *  		update_display() leaves the pins alone once the refresh owns them
+ */
+
+#ifndef INC_MATRIX_REFRESH_H_
+#define INC_MATRIX_REFRESH_H_
+
+
+// defines
+#define MATRIX_SECTIONS 		(NUM_ROWS / 2) 	// sections lit one at a time
+#define MATRIX_FRAME_HZ 		120 			// default full frames per second
+#define MATRIX_TIM_HZ 			1000000 		// TIM3 counts per second after the prescaler
+#define MATRIX_CLK 				32000000 		// clock into TIM3, same as the system clock
+
+// typedefs
+typedef struct matrix_refresh
+{
+	color 		(*buffer)[NUM_ROWS]; 	// matrix buffer, indexed [x][y]
+	uint8_t 	owned; 		// 1 once TIM3 drives the pins
+	uint8_t 	running; 	// 1 while TIM3 is counting
+	uint8_t 	section; 	// section whose columns are in the shift registers
+	uint8_t 	brightness; // percent of each section period the output is on
+	uint32_t 	frames; 	// full frames shown
+} matrix_refresh;
+
+matrix_refresh refresh = {0};
+
+// function declarations
+void matrix_refresh_init(color (*buffer)[NUM_ROWS], uint32_t frame_hz); // sets up TIM3 to show the buffer at frame_hz and starts it
+void matrix_refresh_start(); // shifts in the first section and starts the timer
+void matrix_refresh_stop(); // stops the timer with the output off, the panel goes dark
+void matrix_set_brightness(uint8_t percent); // sets the part of each section period the output is on, 0 to 100
+void matrix_shift_section(uint8_t section); // clocks the columns of a section into the shift registers
+void matrix_show_section(); // latches the shifted section and lights it, then shifts in the next one
+void TIM3_IRQHandler(void); // end of a section period, or end of its lit part when dimmed
+
+
+// sets up TIM3 to show the buffer at frame_hz and starts it
+void matrix_refresh_init(color (*buffer)[NUM_ROWS], uint32_t frame_hz)
+{
+	refresh.buffer = buffer;
+	refresh.owned = 1;
+
+	// enable the clock for TIM3
+	RCC->APB1ENR1 |= RCC_APB1ENR1_TIM3EN;
+
+	// count in us, one update per section
+	TIM3->CR1 &= ~(TIM_CR1_CMS | TIM_CR1_DIR);
+	TIM3->PSC = (MATRIX_CLK / MATRIX_TIM_HZ) - 1;
+	TIM3->ARR = (MATRIX_TIM_HZ / (frame_hz * MATRIX_SECTIONS)) - 1;
+	matrix_set_brightness(100);
+
+	// enable interrupts
+	NVIC->ISER[0] = (1 << (TIM3_IRQn & 0x1F));
+	TIM3->SR = ~(uint32_t)(TIM_SR_UIF | TIM_SR_CC1IF);
+	TIM3->DIER |= TIM_DIER_UIE | TIM_DIER_CC1IE;
+
+	matrix_refresh_start();
+}
+
+// shifts in the first section and starts the timer
+void matrix_refresh_start()
+{
+	if(refresh.running)
+	{
+		return;
+	}
+
+	refresh.section = 0;
+	matrix_shift_section(0);
+	TIM3->CNT = 0;
+	refresh.running = 1;
+	TIM3->CR1 |= TIM_CR1_CEN;
+}
+
+// stops the timer with the output off, the panel goes dark
+void matrix_refresh_stop()
+{
+	TIM3->CR1 &= ~TIM_CR1_CEN;
+	TIM3->SR = ~(uint32_t)(TIM_SR_UIF | TIM_SR_CC1IF);
+	refresh.running = 0;
+	set_OE(HIGH); // a section left lit would stay lit
+}
+
+// sets the part of each section period the output is on, 0 to 100
+void matrix_set_brightness(uint8_t percent)
+{
+	if(percent > 100) percent = 100;
+	refresh.brightness = percent;
+
+	// at 100 CCR1 is past ARR and never matches, the output stays on until the next section
+	TIM3->CCR1 = (percent == 100) ? TIM3->ARR + 1 : (TIM3->ARR + 1) * percent / 100;
+}
+
+// clocks the columns of a section into the shift registers
+void matrix_shift_section(uint8_t section)
+{
+	for(uint8_t col = 0; col < NUM_COLS; col++)
+	{
+		set_RGB_val(refresh.buffer[col][section], refresh.buffer[col][section + MATRIX_SECTIONS]);
+		drive_matrix_clk();
+		clear_RGB_val();
+	}
+}
+
+// latches the shifted section and lights it, then shifts in the next one
+void matrix_show_section()
+{
+	set_OE(HIGH); // dark while the address and outputs change
+	set_matrix_section(refresh.section);
+	set_LAT(HIGH);
+	set_LAT(LOW);
+	if(refresh.brightness)
+	{
+		set_OE(LOW);
+	}
+
+	// the shift registers are free again while this section is shown
+	refresh.section = (refresh.section + 1) % MATRIX_SECTIONS;
+	matrix_shift_section(refresh.section);
+	if(refresh.section == 0)
+	{
+		refresh.frames++;
+		telemetry.refreshes++;
+	}
+}
+
+// end of a section period, or end of its lit part when dimmed
+void TIM3_IRQHandler(void)
+{
+	PROFILE_BEGIN(PROFILE_TIM3);
+	telemetry.isr[TELEMETRY_ISR_TIM3]++;
+
+	// lit part of a dimmed section is over
+	if(TIM3->SR & TIM_SR_CC1IF)
+	{
+		TIM3->SR = ~(uint32_t)TIM_SR_CC1IF; // rc_w0, a read modify write could clear a UIF set since the read
+		set_OE(HIGH);
+	}
+
+	// next section
+	if(TIM3->SR & TIM_SR_UIF)
+	{
+		TIM3->SR = ~(uint32_t)TIM_SR_UIF;
+		matrix_show_section();
+	}
+	PROFILE_END(PROFILE_TIM3);
+}
+
+#endif /* INC_MATRIX_REFRESH_H_ */
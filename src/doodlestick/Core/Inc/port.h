@@ -0,0 +1,32 @@
+/*
+ * port.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the port layer, the one place the target is chosen
+ *
+ *  	BACKENDS
+ *  		port_stm32.h 	the STM32L476, the HAL headers and the real registers
+ *  		port_host.h 	define PORT_HOST to build for Linux, every peripheral
+ *  						is a copy of its registers in RAM and the effects of
+ *  						the register writes are simulated
+ *
+ *  	WHAT A BACKEND GIVES
+ *  		the CMSIS peripheral names (GPIOB, TIM3, ...) and register layouts,
+ *  		so the drivers keep their direct register access on both
+ *  		the CMSIS intrinsics (__WFI, __disable_irq, __DMB, ...)
+ *  		PORT_WAIT() 		the body of a busy wait that only reads RAM or a
+ *  							peripheral through a pointer it was passed
+ *  		PORT_FLASH(addr) 	a pointer to the flash at a target address
+ */
+
+#ifndef INC_PORT_H_
+#define INC_PORT_H_
+
+#ifdef PORT_HOST
+#include "port_host.h"
+#else
+#include "port_stm32.h"
+#endif /* PORT_HOST */
+
+#endif /* INC_PORT_H_ */
@@ -0,0 +1,1300 @@
+/*
+ * port_host.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the Linux backend of the port layer, a simulated board
+ *
+ *  	REGISTERS
+ *  		every peripheral the firmware uses is a copy of its CMSIS register
+ *  		struct in RAM, the peripheral names (GPIOB, TIM3, ...) are redefined
+ *  		to port_host_access(), which runs the board up to the access and
+ *  		returns the copy, so the drivers build unchanged
+ *  		a write can't be trapped, so each access first compares the
+ *  		registers touched by the access before it with the copy taken then,
+ *  		a difference is a write and gets the hardware's side effects
+ *  		(BSRR and BRR set ODR, the ICR and IFCR registers clear flags, a CNT
+ *  		or UG write restarts a timer, ...)
+ *  		a write of the value a register already holds can't be seen, the
+ *  		EXTI pending bit of a line is cleared after its handler returns
+ *  		for that reason
+ *
+ *  	TIME
+ *  		the clock is in core cycles at PORT_HOST_CLK, every register access
+ *  		costs PORT_HOST_ACCESS_CYCLES and every pass of a PORT_WAIT() loop
+ *  		PORT_HOST_WAIT_CYCLES, code between accesses takes no time
+ *  		WFI jumps to the next event, in Stop 2 (SLEEPDEEP) the core clock
+ *  		stands still and only the wall clock moves, so TIM5 stops as on
+ *  		the board
+ *
+ *  	MODELS
+ *  		TIM2 3 5 6 7 16 	counter, update and CC1 flags and interrupts,
+ *  							a zero written to SR clears a flag, a one
+ *  							leaves it
+ *  		TIM6 -> ADC1/2 		each update converts the joystick into the
+ *  							DMA1 channel 1 buffer, x low and y high
+ *  		USART2 + DMA1 		channel 7 sends a byte per 10 bit times at BRR,
+ *  							channel 6 takes bytes given to port_host_send(),
+ *  							IDLE one byte time after the last, ORE
+ *  							interrupts with EIE
+ *  		LPTIM1 				counts the LSI, ARR match wakes Stop 2
+ *  		GPIO and EXTI 		IDR from ODR, the keys (row high when its
+ *  							column is driven) and the button (PA4 low when
+ *  							pressed), edges set the EXTI pending bits
+ *  		RGB matrix 			CLK, LAT and OE on GPIOC shift, latch and show
+ *  							the colors on GPIOB, port_host.panel keeps what
+ *  							each row showed last and how long it was lit
+ *  		flash 				the calibration page, through PORT_FLASH()
+ *  		DWT 				CYCCNT counts the core clock while TRCENA
+ *  							and CYCCNTENA are set
+ *  		interrupts go to the handlers in IRQ number order when enabled in
+ *  		the NVIC and not masked, one at a time, each costs
+ *  		PORT_HOST_IRQ_CYCLES on top of its accesses
+ *
+ *  	HOST PROGRAM
+ *  		port_host_reset(seconds) then setjmp(port_host.done) and call the
+ *  		firmware's main, the board jumps back when the time is up
+ *  		port_host.script is called at port_host.script_at to move the inputs,
+ *  		port_host.tx is called with every byte sent
+ *  		the handlers are weak, a program without one just never gets it
+ *
+ *  	DEPENDENCIES
+ *  		included by port.h with PORT_HOST defined, the program must be
+ *  		linked with -no-pie, the DMA address registers are 32 bits
+ */
+
+#ifndef INC_PORT_HOST_H_
+#define INC_PORT_HOST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stddef.h>
+#include "stm32l4xx_hal.h"
+
+
+// defines
+#define PORT_HOST_CLK 			32000000 	// core cycles per second
+#define PORT_HOST_LSI_HZ 		32000 		// LPTIM1 clock
+#define PORT_HOST_ACCESS_CYCLES 2 			// cost of a register access
+#define PORT_HOST_WAIT_CYCLES 	4 			// cost of a pass of a PORT_WAIT() loop
+#define PORT_HOST_IRQ_CYCLES 	24 			// stacking on the way into a handler and unstacking on the way out
+#define PORT_HOST_TICK_CYCLES 	(PORT_HOST_CLK / 1000) // SysTick period
+#define PORT_HOST_NEVER 		UINT64_MAX 	// time of an event that isn't coming
+#define PORT_HOST_RX_LEN 		4096 		// serial bytes waiting to arrive
+#define PORT_HOST_FLASH_ADDR 	0x080FF800 	// the one simulated flash page
+#define PORT_HOST_FLASH_LEN 	2048
+#define PORT_HOST_PANEL_W 		32
+#define PORT_HOST_PANEL_H 		16
+#define PORT_HOST_STORM 		100000 		// interrupts in a row before the board gives up
+#define PORT_HOST_ADC_MID 		2048 		// joystick at rest
+
+#define PORT_WAIT() 			port_host_wait()
+#define PORT_FLASH(addr) 		((const void*)port_host_flash_at(addr))
+
+// typedefs
+typedef enum PORT_HOST_PERIPH {
+		PORT_GPIOA, PORT_GPIOB, PORT_GPIOC,
+		PORT_TIM2, PORT_TIM3, PORT_TIM5, PORT_TIM6, PORT_TIM7, PORT_TIM16,
+		PORT_LPTIM1, PORT_ADC1, PORT_ADC2, PORT_ADC_COMMON,
+		PORT_DMA1, PORT_DMA1_CH1, PORT_DMA1_CH6, PORT_DMA1_CH7, PORT_DMA1_CSELR,
+		PORT_USART2, PORT_RCC, PORT_EXTI, PORT_PWR, PORT_FLASH_REGS, PORT_SYSCFG,
+		PORT_NVIC, PORT_SCB, PORT_DWT, PORT_COREDEBUG,
+		PORT_NUM
+} PORT_HOST_PERIPH;
+
+typedef enum PORT_HOST_EVENT {
+		PORT_EV_NONE, PORT_EV_TIMER, PORT_EV_CC1, PORT_EV_LPTIM, PORT_EV_TICK,
+		PORT_EV_TX, PORT_EV_RX, PORT_EV_IDLE, PORT_EV_SCRIPT, PORT_EV_END
+} PORT_HOST_EVENT;
+
+#define PORT_HOST_TIMERS 	6 	// TIM2 TIM3 TIM5 TIM6 TIM7 TIM16, in PORT_HOST_PERIPH order
+
+typedef struct port_host_timer
+{
+	uint64_t 	base; 	// core cycle the counter was 0
+	uint8_t 	cc1; 	// 1 once CC1 matched in this period
+} port_host_timer;
+
+typedef struct port_host_panel
+{
+	uint8_t 	shift[2][PORT_HOST_PANEL_W]; 	// upper and lower shift registers, [0] is x = 0
+	uint8_t 	latch[2][PORT_HOST_PANEL_W]; 	// latched outputs
+	uint8_t 	shown[PORT_HOST_PANEL_H][PORT_HOST_PANEL_W]; // colors each row had when last lit, bit 0 red
+	uint32_t 	pins; 		// GPIOC ODR at the last decode
+	uint64_t 	lit_since; 	// core cycle of the last decode
+	uint64_t 	lit_cycles; // cycles the output was on
+	uint32_t 	clocks; 	// CLK rising edges
+	uint32_t 	latches; 	// LAT rising edges
+	uint32_t 	sections; 	// times a section was lit
+} port_host_panel;
+
+typedef struct port_host_irq
+{
+	const char* name;
+	IRQn_Type 	irq;
+	void 		(*handler)(void);
+	uint8_t 	(*active)(void); // returns 1 if the peripheral requests it
+	uint32_t 	count;
+	uint64_t 	cycles; 	// core cycles in the handler, entry and exit included
+} port_host_irq;
+
+typedef struct port_host_board
+{
+	// registers, and their copies after the last access or side effect
+	GPIO_TypeDef 		gpio[3], gpio_seen[3];
+	TIM_TypeDef 		tim[PORT_HOST_TIMERS], tim_seen[PORT_HOST_TIMERS];
+	LPTIM_TypeDef 		lptim1, lptim1_seen;
+	ADC_TypeDef 		adc[2], adc_seen[2];
+	ADC_Common_TypeDef 	adc_common, adc_common_seen;
+	DMA_TypeDef 		dma1, dma1_seen;
+	DMA_Channel_TypeDef dma_ch[3], dma_ch_seen[3]; // channels 1 6 7
+	DMA_Request_TypeDef dma_cselr, dma_cselr_seen;
+	USART_TypeDef 		usart2, usart2_seen;
+	RCC_TypeDef 		rcc, rcc_seen;
+	EXTI_TypeDef 		exti, exti_seen;
+	PWR_TypeDef 		pwr, pwr_seen;
+	FLASH_TypeDef 		flash, flash_seen;
+	SYSCFG_TypeDef 		syscfg, syscfg_seen;
+	NVIC_Type 			nvic, nvic_seen;
+	SCB_Type 			scb, scb_seen;
+	DWT_Type 			dwt, dwt_seen;
+	CoreDebug_Type 		coredebug, coredebug_seen;
+	uint32_t 			touched; 	// bit per peripheral accessed since the last compare
+
+	// time
+	uint64_t 	wall; 		// cycles since reset
+	uint64_t 	stop_cycles; // cycles spent in Stop 2, the core clock is wall - stop_cycles
+	uint64_t 	stop_wall; 	// wall cycle the current Stop 2 started
+	uint64_t 	end_at; 	// wall cycle the run ends
+	jmp_buf 	done; 		// where the board jumps at end_at
+
+	// models
+	port_host_timer timer[PORT_HOST_TIMERS];
+	uint64_t 	lptim_base; // wall cycle LPTIM1 was 0, PORT_HOST_NEVER while stopped
+	uint64_t 	dwt_base; 	// core cycle CYCCNT was 0
+	uint64_t 	tick_at; 	// core cycle of the next SysTick, PORT_HOST_NEVER while suspended
+	uint8_t 	tick_flag; 	// a SysTick came
+	uint16_t 	dma_len[3]; // CNDTR when each channel was enabled
+	uint64_t 	tx_at; 		// core cycle the byte being sent is done
+	uint64_t 	rx_at; 		// wall cycle the next received byte is in
+	uint64_t 	idle_at; 	// core cycle the line counts as idle
+	uint8_t 	rx[PORT_HOST_RX_LEN];
+	uint16_t 	rx_head, rx_tail;
+	uint8_t 	exti_levels; // lines 0 to 4 at the last edge check
+	uint8_t 	flash_page[PORT_HOST_FLASH_LEN];
+
+	// processor
+	uint8_t 	primask;
+	uint8_t 	in_isr;
+	uint8_t 	asleep; 	// in WFI, the interrupts wait for the wake up
+	uint8_t 	stopped; 	// in Stop 2
+
+	// inputs
+	uint16_t 	keys; 		// bit per pressed key, row * 3 + column
+	uint8_t 	button; 	// 1 while pressed
+	uint16_t 	joy_x, joy_y; // ADC results
+	uint64_t 	script_at; 	// wall cycle to call script, PORT_HOST_NEVER for none
+	void 		(*script)(void);
+	void 		(*tx)(uint8_t byte); // every byte sent, NULL to drop them
+
+	// outputs and statistics
+	port_host_panel panel;
+	uint32_t 	accesses[PORT_NUM];
+	uint32_t 	writes[PORT_NUM]; // accesses that changed a register
+	uint32_t 	tx_bytes, rx_bytes, rx_lost;
+	uint32_t 	sleeps, stops;
+	uint64_t 	sleep_cycles; // in WFI, Stop 2 included
+} port_host_board;
+
+port_host_board port_host;
+
+// the firmware's interrupt handlers, weak so a program without one still links
+void TIM2_IRQHandler(void) __attribute__((weak));
+void TIM3_IRQHandler(void) __attribute__((weak));
+void TIM7_IRQHandler(void) __attribute__((weak));
+void TIM1_UP_TIM16_IRQHandler(void) __attribute__((weak));
+void EXTI0_IRQHandler(void) __attribute__((weak));
+void EXTI1_IRQHandler(void) __attribute__((weak));
+void EXTI2_IRQHandler(void) __attribute__((weak));
+void EXTI3_IRQHandler(void) __attribute__((weak));
+void EXTI4_IRQHandler(void) __attribute__((weak));
+void USART2_IRQHandler(void) __attribute__((weak));
+void DMA1_Channel6_IRQHandler(void) __attribute__((weak));
+void DMA1_Channel7_IRQHandler(void) __attribute__((weak));
+void LPTIM1_IRQHandler(void) __attribute__((weak));
+
+// function declarations
+void port_host_reset(double seconds); // powers the board up, the run ends after seconds
+void* port_host_access(uint8_t id); // runs the board up to an access of a peripheral and returns its registers
+void port_host_wait(); // a pass of a busy wait, looks at every peripheral and moves the time on
+void port_host_wfi(); // sleeps until an interrupt, Stop 2 if SLEEPDEEP is set
+uint64_t port_host_core(); // returns the core clock in cycles
+uint8_t* port_host_flash_at(uint32_t addr); // returns the simulated flash at a target address
+void port_host_send(const uint8_t* bytes, uint16_t len); // queues bytes to arrive on the USART2 RX pin back to back
+void port_host_set_keys(uint16_t keys); // sets the pressed keys, bit row * 3 + column
+void port_host_set_button(uint8_t pressed); // sets the joystick button
+void port_host_set_joystick(uint16_t x, uint16_t y); // sets the ADC results of the joystick
+void port_host_irq_on(); // __enable_irq()
+void port_host_irq_off(); // __disable_irq()
+uint32_t port_host_get_primask(); // __get_PRIMASK()
+void port_host_set_primask(uint32_t mask); // __set_PRIMASK()
+void port_host_writes(uint32_t ids); // applies the side effects of the writes to the given peripherals
+void port_host_apply(uint8_t id); // gives one peripheral's changed registers their side effects
+void port_host_apply_timer(uint8_t i); // a timer register was written
+void port_host_apply_dma_channel(uint8_t c); // a DMA channel register was written
+uint8_t port_host_dwt_on(); // returns 1 if CYCCNT is counting
+void port_host_seen(uint8_t id); // takes the copy that the next writes are found against
+void port_host_render(uint8_t id); // updates the registers that count by themselves before a read
+void port_host_pins(); // recomputes the inputs and the EXTI edges
+void port_host_panel_decode(); // follows the matrix pins
+void port_host_advance(uint64_t until); // runs every event up to a wall cycle
+uint64_t port_host_next(uint8_t* kind, uint8_t* arg); // returns the wall cycle of the next event
+void port_host_event(uint8_t kind, uint8_t arg); // runs an event
+uint8_t port_host_pending(); // returns the index of the first requested and enabled interrupt + 1, 0 if none
+void port_host_dispatch(); // runs the pending interrupt handlers unless masked or asleep
+void port_host_adc_sample(); // a TIM6 trigger, converts the joystick into the DMA buffer
+uint32_t port_host_byte_cycles(); // returns the cycles of a USART2 frame
+uint8_t port_host_timer_irq(uint8_t i); // returns 1 if timer i requests its interrupt
+uint8_t port_host_dma_irq(uint8_t ch); // returns 1 if DMA1 channel ch requests its interrupt
+uint8_t port_host_exti_irq(uint8_t line); // returns 1 if an EXTI line requests its interrupt
+
+// intrinsics, the asm ones can't run here
+#undef __WFI
+#undef __WFE
+#undef __NOP
+#undef __SEV
+#define __WFI() 		port_host_wfi()
+#define __WFE() 		port_host_wfi()
+#define __NOP() 		port_host_wait()
+#define __SEV()
+#define __enable_irq() 	port_host_irq_on()
+#define __disable_irq() port_host_irq_off()
+#define __get_PRIMASK() port_host_get_primask()
+#define __set_PRIMASK(mask) port_host_set_primask(mask)
+#define __DMB() 		__sync_synchronize()
+#define __DSB() 		__sync_synchronize()
+#define __ISB() 		__sync_synchronize()
+
+// peripherals
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef TIM2
+#undef TIM3
+#undef TIM5
+#undef TIM6
+#undef TIM7
+#undef TIM16
+#undef LPTIM1
+#undef ADC1
+#undef ADC2
+#undef ADC123_COMMON
+#undef DMA1
+#undef DMA1_Channel1
+#undef DMA1_Channel6
+#undef DMA1_Channel7
+#undef DMA1_CSELR
+#undef USART2
+#undef RCC
+#undef EXTI
+#undef PWR
+#undef FLASH
+#undef SYSCFG
+#undef NVIC
+#undef SCB
+#undef DWT
+#undef CoreDebug
+#define GPIOA 			((GPIO_TypeDef*)port_host_access(PORT_GPIOA))
+#define GPIOB 			((GPIO_TypeDef*)port_host_access(PORT_GPIOB))
+#define GPIOC 			((GPIO_TypeDef*)port_host_access(PORT_GPIOC))
+#define TIM2 			((TIM_TypeDef*)port_host_access(PORT_TIM2))
+#define TIM3 			((TIM_TypeDef*)port_host_access(PORT_TIM3))
+#define TIM5 			((TIM_TypeDef*)port_host_access(PORT_TIM5))
+#define TIM6 			((TIM_TypeDef*)port_host_access(PORT_TIM6))
+#define TIM7 			((TIM_TypeDef*)port_host_access(PORT_TIM7))
+#define TIM16 			((TIM_TypeDef*)port_host_access(PORT_TIM16))
+#define LPTIM1 			((LPTIM_TypeDef*)port_host_access(PORT_LPTIM1))
+#define ADC1 			((ADC_TypeDef*)port_host_access(PORT_ADC1))
+#define ADC2 			((ADC_TypeDef*)port_host_access(PORT_ADC2))
+#define ADC123_COMMON 	((ADC_Common_TypeDef*)port_host_access(PORT_ADC_COMMON))
+#define DMA1 			((DMA_TypeDef*)port_host_access(PORT_DMA1))
+#define DMA1_Channel1 	((DMA_Channel_TypeDef*)port_host_access(PORT_DMA1_CH1))
+#define DMA1_Channel6 	((DMA_Channel_TypeDef*)port_host_access(PORT_DMA1_CH6))
+#define DMA1_Channel7 	((DMA_Channel_TypeDef*)port_host_access(PORT_DMA1_CH7))
+#define DMA1_CSELR 		((DMA_Request_TypeDef*)port_host_access(PORT_DMA1_CSELR))
+#define USART2 			((USART_TypeDef*)port_host_access(PORT_USART2))
+#define RCC 			((RCC_TypeDef*)port_host_access(PORT_RCC))
+#define EXTI 			((EXTI_TypeDef*)port_host_access(PORT_EXTI))
+#define PWR 			((PWR_TypeDef*)port_host_access(PORT_PWR))
+#define FLASH 			((FLASH_TypeDef*)port_host_access(PORT_FLASH_REGS))
+#define SYSCFG 			((SYSCFG_TypeDef*)port_host_access(PORT_SYSCFG))
+#define NVIC 			((NVIC_Type*)port_host_access(PORT_NVIC))
+#define SCB 			((SCB_Type*)port_host_access(PORT_SCB))
+#define DWT 			((DWT_Type*)port_host_access(PORT_DWT))
+#define CoreDebug 		((CoreDebug_Type*)port_host_access(PORT_COREDEBUG))
+
+// registers and copies of each peripheral, in PORT_HOST_PERIPH order
+#define PORT_HOST_REGS(regs, seen) { &port_host.regs, &port_host.seen, sizeof(port_host.regs) }
+#define PORT_HOST_NVIC_SIZE offsetof(NVIC_Type, ISPR) // only ISER and ICER do anything
+#define PORT_HOST_DWT_SIZE offsetof(DWT_Type, CPICNT) // only CTRL and CYCCNT do anything
+struct { void* regs; void* seen; uint16_t size; } const port_host_periph[PORT_NUM] = {
+		PORT_HOST_REGS(gpio[0], gpio_seen[0]), PORT_HOST_REGS(gpio[1], gpio_seen[1]), PORT_HOST_REGS(gpio[2], gpio_seen[2]),
+		PORT_HOST_REGS(tim[0], tim_seen[0]), PORT_HOST_REGS(tim[1], tim_seen[1]), PORT_HOST_REGS(tim[2], tim_seen[2]),
+		PORT_HOST_REGS(tim[3], tim_seen[3]), PORT_HOST_REGS(tim[4], tim_seen[4]), PORT_HOST_REGS(tim[5], tim_seen[5]),
+		PORT_HOST_REGS(lptim1, lptim1_seen), PORT_HOST_REGS(adc[0], adc_seen[0]), PORT_HOST_REGS(adc[1], adc_seen[1]),
+		PORT_HOST_REGS(adc_common, adc_common_seen), PORT_HOST_REGS(dma1, dma1_seen),
+		PORT_HOST_REGS(dma_ch[0], dma_ch_seen[0]), PORT_HOST_REGS(dma_ch[1], dma_ch_seen[1]),
+		PORT_HOST_REGS(dma_ch[2], dma_ch_seen[2]), PORT_HOST_REGS(dma_cselr, dma_cselr_seen),
+		PORT_HOST_REGS(usart2, usart2_seen), PORT_HOST_REGS(rcc, rcc_seen), PORT_HOST_REGS(exti, exti_seen),
+		PORT_HOST_REGS(pwr, pwr_seen), PORT_HOST_REGS(flash, flash_seen), PORT_HOST_REGS(syscfg, syscfg_seen),
+		{ &port_host.nvic, &port_host.nvic_seen, PORT_HOST_NVIC_SIZE }, PORT_HOST_REGS(scb, scb_seen),
+		{ &port_host.dwt, &port_host.dwt_seen, PORT_HOST_DWT_SIZE }, PORT_HOST_REGS(coredebug, coredebug_seen)
+};
+
+uint8_t port_host_tim2_irq() { return port_host_timer_irq(0); }
+uint8_t port_host_tim3_irq() { return port_host_timer_irq(1); }
+uint8_t port_host_tim7_irq() { return port_host_timer_irq(4); }
+uint8_t port_host_tim16_irq() { return port_host_timer_irq(5); }
+uint8_t port_host_exti0_irq() { return port_host_exti_irq(0); }
+uint8_t port_host_exti1_irq() { return port_host_exti_irq(1); }
+uint8_t port_host_exti2_irq() { return port_host_exti_irq(2); }
+uint8_t port_host_exti3_irq() { return port_host_exti_irq(3); }
+uint8_t port_host_exti4_irq() { return port_host_exti_irq(4); }
+uint8_t port_host_ch6_irq() { return port_host_dma_irq(6); }
+uint8_t port_host_ch7_irq() { return port_host_dma_irq(7); }
+uint8_t port_host_usart2_irq()
+{
+	USART_TypeDef* u = &port_host.usart2;
+	return ((u->ISR & USART_ISR_IDLE) && (u->CR1 & USART_CR1_IDLEIE))
+			|| ((u->ISR & USART_ISR_TC) && (u->CR1 & USART_CR1_TCIE))
+			|| ((u->ISR & USART_ISR_RXNE) && (u->CR1 & USART_CR1_RXNEIE))
+			|| ((u->ISR & USART_ISR_ORE) && (u->CR3 & USART_CR3_EIE));
+}
+uint8_t port_host_lptim1_irq() { return (port_host.lptim1.ISR & port_host.lptim1.IER) != 0; }
+
+// every interrupt the firmware uses, in IRQ number order, which is the order they are taken in
+port_host_irq port_host_irqs[] = {
+		{ "EXTI0", EXTI0_IRQn, EXTI0_IRQHandler, port_host_exti0_irq, 0 },
+		{ "EXTI1", EXTI1_IRQn, EXTI1_IRQHandler, port_host_exti1_irq, 0 },
+		{ "EXTI2", EXTI2_IRQn, EXTI2_IRQHandler, port_host_exti2_irq, 0 },
+		{ "EXTI3", EXTI3_IRQn, EXTI3_IRQHandler, port_host_exti3_irq, 0 },
+		{ "EXTI4", EXTI4_IRQn, EXTI4_IRQHandler, port_host_exti4_irq, 0 },
+		{ "DMA1_CH6", DMA1_Channel6_IRQn, DMA1_Channel6_IRQHandler, port_host_ch6_irq, 0 },
+		{ "DMA1_CH7", DMA1_Channel7_IRQn, DMA1_Channel7_IRQHandler, port_host_ch7_irq, 0 },
+		{ "TIM16", TIM1_UP_TIM16_IRQn, TIM1_UP_TIM16_IRQHandler, port_host_tim16_irq, 0 },
+		{ "TIM2", TIM2_IRQn, TIM2_IRQHandler, port_host_tim2_irq, 0 },
+		{ "TIM3", TIM3_IRQn, TIM3_IRQHandler, port_host_tim3_irq, 0 },
+		{ "USART2", USART2_IRQn, USART2_IRQHandler, port_host_usart2_irq, 0 },
+		{ "TIM7", TIM7_IRQn, TIM7_IRQHandler, port_host_tim7_irq, 0 },
+		{ "LPTIM1", LPTIM1_IRQn, LPTIM1_IRQHandler, port_host_lptim1_irq, 0 }
+};
+#define PORT_HOST_IRQS (sizeof(port_host_irqs) / sizeof(port_host_irqs[0]))
+
+
+// powers the board up, the run ends after seconds
+void port_host_reset(double seconds)
+{
+	memset(&port_host, 0, sizeof(port_host));
+
+	// reset values that aren't 0
+	port_host.gpio[0].MODER = 0xABFFFFFF;
+	port_host.gpio[1].MODER = 0xFFFFFEBF;
+	port_host.gpio[2].MODER = 0xFFFFFFFF;
+	for(uint8_t i = 0; i < PORT_HOST_TIMERS; i++)
+	{
+		port_host.tim[i].ARR = (i == 0 || i == 2) ? 0xFFFFFFFF : 0xFFFF; // TIM2 and TIM5 are 32 bits
+	}
+	port_host.lptim1.ARR = 1;
+	port_host.usart2.ISR = USART_ISR_TXE | USART_ISR_TC;
+	port_host.rcc.CR = RCC_CR_MSION | RCC_CR_MSIRDY;
+	memset(port_host.flash_page, 0xFF, PORT_HOST_FLASH_LEN);
+	for(uint8_t id = 0; id < PORT_NUM; id++)
+	{
+		port_host_seen(id);
+	}
+
+	port_host.end_at = (uint64_t)(seconds * PORT_HOST_CLK);
+	port_host.lptim_base = PORT_HOST_NEVER;
+	port_host.tick_at = PORT_HOST_NEVER;
+	port_host.tx_at = PORT_HOST_NEVER;
+	port_host.rx_at = PORT_HOST_NEVER;
+	port_host.idle_at = PORT_HOST_NEVER;
+	port_host.script_at = PORT_HOST_NEVER;
+	port_host.joy_x = PORT_HOST_ADC_MID;
+	port_host.joy_y = PORT_HOST_ADC_MID;
+	port_host.panel.pins = 1 << 12; // OE high, dark
+	port_host_pins();
+	for(uint8_t i = 0; i < PORT_HOST_IRQS; i++)
+	{
+		port_host_irqs[i].count = 0;
+		port_host_irqs[i].cycles = 0;
+	}
+}
+
+// runs the board up to an access of a peripheral and returns its registers
+void* port_host_access(uint8_t id)
+{
+	port_host.accesses[id]++;
+	port_host_writes(port_host.touched);
+	port_host.touched = 0;
+	port_host_advance(port_host.wall + PORT_HOST_ACCESS_CYCLES);
+	port_host_render(id);
+	port_host.touched = 1u << id;
+	return port_host_periph[id].regs;
+}
+
+// a pass of a busy wait, looks at every peripheral and moves the time on
+void port_host_wait()
+{
+	// the wait may poll through a pointer that never went through port_host_access()
+	port_host_writes(0xFFFFFFFF);
+	port_host.touched = 0;
+	port_host_advance(port_host.wall + PORT_HOST_WAIT_CYCLES);
+	for(uint8_t id = PORT_TIM2; id <= PORT_LPTIM1; id++)
+	{
+		port_host_render(id);
+	}
+}
+
+// sleeps until an interrupt, Stop 2 if SLEEPDEEP is set
+void port_host_wfi()
+{
+	port_host_writes(0xFFFFFFFF);
+	port_host.touched = 0;
+
+	uint64_t start = port_host.wall;
+	uint8_t deep = (port_host.scb.SCR & SCB_SCR_SLEEPDEEP_Msk) != 0;
+	if(deep)
+	{
+		port_host.stop_wall = port_host.wall;
+		port_host.stopped = 1;
+		port_host.stops++;
+	}
+	port_host.sleeps++;
+	port_host.asleep = 1;
+	port_host.tick_flag = 0;
+
+	// a pending interrupt wakes it even while masked
+	while(!port_host_pending() && !port_host.tick_flag)
+	{
+		uint8_t kind, arg;
+		port_host_advance(port_host_next(&kind, &arg)); // the end of the run is always an event
+	}
+
+	port_host.asleep = 0;
+	if(deep)
+	{
+		port_host.stop_cycles += port_host.wall - port_host.stop_wall;
+		port_host.stopped = 0;
+	}
+	port_host.sleep_cycles += port_host.wall - start;
+	port_host_dispatch();
+}
+
+// returns the core clock in cycles
+uint64_t port_host_core()
+{
+	return (port_host.stopped ? port_host.stop_wall : port_host.wall) - port_host.stop_cycles;
+}
+
+// returns the simulated flash at a target address
+uint8_t* port_host_flash_at(uint32_t addr)
+{
+	if(addr < PORT_HOST_FLASH_ADDR || addr >= PORT_HOST_FLASH_ADDR + PORT_HOST_FLASH_LEN)
+	{
+		fprintf(stderr, "port_host: flash 0x%08x is not simulated\n", (unsigned)addr);
+		exit(1);
+	}
+	return &port_host.flash_page[addr - PORT_HOST_FLASH_ADDR];
+}
+
+// queues bytes to arrive on the USART2 RX pin back to back
+void port_host_send(const uint8_t* bytes, uint16_t len)
+{
+	for(uint16_t i = 0; i < len; i++)
+	{
+		if((uint16_t)(port_host.rx_head - port_host.rx_tail) >= PORT_HOST_RX_LEN)
+		{
+			port_host.rx_lost++;
+			continue;
+		}
+		port_host.rx[port_host.rx_head++ % PORT_HOST_RX_LEN] = bytes[i];
+	}
+	if(port_host.rx_at == PORT_HOST_NEVER && port_host.rx_head != port_host.rx_tail)
+	{
+		port_host.rx_at = port_host.wall + port_host_byte_cycles();
+	}
+}
+
+// sets the pressed keys, bit row * 3 + column
+void port_host_set_keys(uint16_t keys)
+{
+	port_host.keys = keys;
+	port_host_pins();
+}
+
+// sets the joystick button
+void port_host_set_button(uint8_t pressed)
+{
+	port_host.button = pressed;
+	port_host_pins();
+}
+
+// sets the ADC results of the joystick
+void port_host_set_joystick(uint16_t x, uint16_t y)
+{
+	port_host.joy_x = x;
+	port_host.joy_y = y;
+}
+
+// __enable_irq()
+void port_host_irq_on()
+{
+	port_host.primask = 0;
+	port_host_writes(port_host.touched);
+	port_host.touched = 0;
+	port_host_dispatch();
+}
+
+// __disable_irq()
+void port_host_irq_off()
+{
+	port_host.primask = 1;
+}
+
+// __get_PRIMASK()
+uint32_t port_host_get_primask()
+{
+	return port_host.primask;
+}
+
+// __set_PRIMASK()
+void port_host_set_primask(uint32_t mask)
+{
+	if(mask & 1)
+	{
+		port_host_irq_off();
+	}
+	else
+	{
+		port_host_irq_on();
+	}
+}
+
+// applies the side effects of the writes to the given peripherals
+void port_host_writes(uint32_t ids)
+{
+	uint8_t pins = 0;
+
+	for(uint8_t id = 0; ids && id < PORT_NUM; id++, ids >>= 1)
+	{
+		if(!(ids & 1) || !memcmp(port_host_periph[id].regs, port_host_periph[id].seen, port_host_periph[id].size))
+		{
+			continue;
+		}
+		port_host.writes[id]++;
+		port_host_apply(id);
+		port_host_seen(id);
+		if(id <= PORT_GPIOC || id == PORT_SYSCFG || id == PORT_EXTI)
+		{
+			pins = 1;
+		}
+	}
+
+	if(pins)
+	{
+		port_host_panel_decode();
+		port_host_pins();
+	}
+}
+
+// gives one peripheral's changed registers their side effects
+void port_host_apply(uint8_t id)
+{
+	switch(id)
+	{
+	case PORT_GPIOA:
+	case PORT_GPIOB:
+	case PORT_GPIOC:
+	{
+		GPIO_TypeDef* g = &port_host.gpio[id - PORT_GPIOA];
+		GPIO_TypeDef* gs = &port_host.gpio_seen[id - PORT_GPIOA];
+		g->IDR = gs->IDR; // read only
+		g->ODR = (g->ODR & ~(g->BSRR >> 16) & ~g->BRR) | (g->BSRR & 0xFFFF); // set wins over reset
+		g->BSRR = 0;
+		g->BRR = 0;
+		break;
+	}
+	case PORT_TIM2: case PORT_TIM3: case PORT_TIM5:
+	case PORT_TIM6: case PORT_TIM7: case PORT_TIM16:
+		port_host_apply_timer(id - PORT_TIM2);
+		break;
+	case PORT_LPTIM1:
+	{
+		LPTIM_TypeDef* l = &port_host.lptim1;
+		l->ISR = port_host.lptim1_seen.ISR & ~l->ICR; // ISR is read only, ICR clears
+		l->ICR = 0;
+		if(l->ARR != port_host.lptim1_seen.ARR)
+		{
+			l->ISR |= LPTIM_ISR_ARROK;
+		}
+		if(!(l->CR & LPTIM_CR_ENABLE))
+		{
+			l->CNT = 0;
+			port_host.lptim_base = PORT_HOST_NEVER;
+		}
+		else if(l->CR & LPTIM_CR_CNTSTRT)
+		{
+			l->CR &= ~LPTIM_CR_CNTSTRT;
+			port_host.lptim_base = port_host.wall;
+		}
+		break;
+	}
+	case PORT_ADC1:
+	case PORT_ADC2:
+	{
+		ADC_TypeDef* a = &port_host.adc[id - PORT_ADC1];
+		ADC_TypeDef* as = &port_host.adc_seen[id - PORT_ADC1];
+		if(a->ISR != as->ISR)
+		{
+			a->ISR = as->ISR & ~a->ISR; // written ones clear
+		}
+		if(a->CR & ADC_CR_ADCAL)
+		{
+			a->CR &= ~ADC_CR_ADCAL; // calibrated right away
+		}
+		if((a->CR & ADC_CR_ADEN) && !(as->CR & ADC_CR_ADEN))
+		{
+			a->ISR |= ADC_ISR_ADRDY;
+		}
+		if(a->CR & ADC_CR_ADDIS)
+		{
+			a->CR &= ~(ADC_CR_ADDIS | ADC_CR_ADEN | ADC_CR_ADSTART);
+		}
+		break;
+	}
+	case PORT_DMA1:
+	{
+		DMA_TypeDef* d = &port_host.dma1;
+		uint32_t clear = d->IFCR;
+		for(uint8_t ch = 0; ch < 7; ch++)
+		{
+			if(clear & (DMA_IFCR_CGIF1 << (ch * 4)))
+			{
+				clear |= 0xF << (ch * 4); // the global clear clears every flag of the channel
+			}
+		}
+		d->ISR = port_host.dma1_seen.ISR & ~clear;
+		d->IFCR = 0;
+		break;
+	}
+	case PORT_DMA1_CH1:
+	case PORT_DMA1_CH6:
+	case PORT_DMA1_CH7:
+		port_host_apply_dma_channel(id - PORT_DMA1_CH1);
+		break;
+	case PORT_USART2:
+	{
+		USART_TypeDef* u = &port_host.usart2;
+		u->ISR = port_host.usart2_seen.ISR & ~u->ICR;
+		u->ICR = 0;
+		break;
+	}
+	case PORT_RCC:
+	{
+		RCC_TypeDef* r = &port_host.rcc;
+		r->CSR = (r->CSR & ~RCC_CSR_LSIRDY) | ((r->CSR & RCC_CSR_LSION) ? RCC_CSR_LSIRDY : 0);
+		r->CR = (r->CR & ~(RCC_CR_MSIRDY | RCC_CR_HSIRDY | RCC_CR_PLLRDY))
+				| ((r->CR & RCC_CR_MSION) ? RCC_CR_MSIRDY : 0)
+				| ((r->CR & RCC_CR_HSION) ? RCC_CR_HSIRDY : 0)
+				| ((r->CR & RCC_CR_PLLON) ? RCC_CR_PLLRDY : 0);
+		break;
+	}
+	case PORT_EXTI:
+	{
+		EXTI_TypeDef* e = &port_host.exti;
+		if(e->PR1 != port_host.exti_seen.PR1)
+		{
+			e->PR1 = port_host.exti_seen.PR1 & ~e->PR1; // written ones clear
+		}
+		break;
+	}
+	case PORT_NVIC:
+	{
+		// ISER sets, ICER clears, both read back the enabled interrupts
+		NVIC_Type* n = &port_host.nvic;
+		for(uint8_t i = 0; i < 8; i++)
+		{
+			uint32_t enabled = port_host.nvic_seen.ISER[i];
+			if(n->ISER[i] != enabled) enabled |= n->ISER[i];
+			if(n->ICER[i] != port_host.nvic_seen.ICER[i]) enabled &= ~n->ICER[i];
+			n->ISER[i] = enabled;
+			n->ICER[i] = enabled;
+		}
+		break;
+	}
+	case PORT_DWT:
+	case PORT_COREDEBUG:
+	{
+		// a new count, or the counter starting, restarts it from the written count
+		uint8_t was_on = (port_host.dwt_seen.CTRL & DWT_CTRL_CYCCNTENA_Msk) && (port_host.coredebug_seen.DEMCR & CoreDebug_DEMCR_TRCENA_Msk);
+		if(port_host.dwt.CYCCNT != port_host.dwt_seen.CYCCNT || (port_host_dwt_on() && !was_on))
+		{
+			port_host.dwt_base = port_host_core() - port_host.dwt.CYCCNT;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// returns 1 if CYCCNT is counting
+uint8_t port_host_dwt_on()
+{
+	return (port_host.dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) && (port_host.coredebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk);
+}
+
+// a timer register was written
+void port_host_apply_timer(uint8_t i)
+{
+	TIM_TypeDef* t = &port_host.tim[i];
+	TIM_TypeDef* s = &port_host.tim_seen[i];
+	port_host_timer* p = &port_host.timer[i];
+	uint64_t core = port_host_core();
+	uint8_t was_on = (s->CR1 & TIM_CR1_CEN) != 0;
+	uint32_t cnt = was_on ? (uint32_t)((core - p->base) / (s->PSC + 1)) : s->CNT;
+	uint8_t restart = (t->PSC != s->PSC) || ((t->CR1 & TIM_CR1_CEN) && !was_on);
+
+	// SR is rc_w0, SR = ~flag clears the flag without clearing one set since the read
+	t->SR = s->SR & t->SR;
+
+	// only a new count moves the counter, the flag writes of a handler leave it running
+	if(t->CNT != s->CNT)
+	{
+		cnt = t->CNT;
+		p->cc1 = cnt > t->CCR1;
+		restart = 1;
+	}
+	if(t->EGR & TIM_EGR_UG)
+	{
+		cnt = 0;
+		p->cc1 = 0;
+		restart = 1;
+		if(!(t->CR1 & TIM_CR1_URS)) t->SR |= TIM_SR_UIF;
+	}
+	if(t->CCR1 != s->CCR1)
+	{
+		p->cc1 = cnt >= t->CCR1;
+	}
+	t->EGR = 0;
+
+	if(restart)
+	{
+		p->base = core - (uint64_t)cnt * (t->PSC + 1);
+	}
+	if(restart || !(t->CR1 & TIM_CR1_CEN))
+	{
+		t->CNT = cnt; // a stopped counter holds its count
+	}
+}
+
+// a DMA channel register was written
+void port_host_apply_dma_channel(uint8_t c)
+{
+	DMA_Channel_TypeDef* ch = &port_host.dma_ch[c];
+	DMA_Channel_TypeDef* s = &port_host.dma_ch_seen[c];
+
+	if((ch->CCR & DMA_CCR_EN) && !(s->CCR & DMA_CCR_EN))
+	{
+		port_host.dma_len[c] = ch->CNDTR;
+
+		// channel 7 starts sending right away
+		if(c == 2 && ch->CNDTR && port_host.tx_at == PORT_HOST_NEVER)
+		{
+			port_host.usart2.ISR &= ~USART_ISR_TC;
+			port_host_seen(PORT_USART2);
+			port_host.tx_at = port_host_core() + port_host_byte_cycles();
+		}
+	}
+	if(!(ch->CCR & DMA_CCR_EN) && c == 2)
+	{
+		port_host.tx_at = PORT_HOST_NEVER;
+	}
+}
+
+// takes the copy that the next writes are found against
+void port_host_seen(uint8_t id)
+{
+	memcpy(port_host_periph[id].seen, port_host_periph[id].regs, port_host_periph[id].size);
+}
+
+// updates the registers that count by themselves before a read
+void port_host_render(uint8_t id)
+{
+	if(id >= PORT_TIM2 && id <= PORT_TIM16)
+	{
+		TIM_TypeDef* t = &port_host.tim[id - PORT_TIM2];
+		if(t->CR1 & TIM_CR1_CEN)
+		{
+			t->CNT = (uint32_t)((port_host_core() - port_host.timer[id - PORT_TIM2].base) / (t->PSC + 1));
+		}
+	}
+	else if(id == PORT_LPTIM1 && port_host.lptim_base != PORT_HOST_NEVER)
+	{
+		uint64_t tick = (uint64_t)PORT_HOST_CLK * (1 << ((port_host.lptim1.CFGR & LPTIM_CFGR_PRESC) >> LPTIM_CFGR_PRESC_Pos)) / PORT_HOST_LSI_HZ;
+		port_host.lptim1.CNT = (uint32_t)((port_host.wall - port_host.lptim_base) / tick);
+	}
+	else if(id == PORT_DWT && port_host_dwt_on())
+	{
+		port_host.dwt.CYCCNT = (uint32_t)(port_host_core() - port_host.dwt_base);
+	}
+	port_host_seen(id);
+}
+
+// recomputes the inputs and the EXTI edges
+void port_host_pins()
+{
+	GPIO_TypeDef* a = &port_host.gpio[0];
+	GPIO_TypeDef* c = &port_host.gpio[2];
+
+	// outputs read back, PA4 is pulled up and the button pulls it down
+	a->IDR = (a->ODR & ~(1 << 4)) | (port_host.button ? 0 : (1 << 4));
+
+	// a pressed key connects its column (PC4 to PC6) to its row (PC0 to PC3)
+	uint32_t rows = 0;
+	for(uint8_t key = 0; key < 12; key++)
+	{
+		if((port_host.keys & (1 << key)) && (c->ODR & (1 << (4 + key % 3))))
+		{
+			rows |= 1 << (key / 3);
+		}
+	}
+	c->IDR = (c->ODR & ~0xF) | rows;
+	port_host.gpio[1].IDR = port_host.gpio[1].ODR;
+
+	// edges on lines 0 to 4, from the port SYSCFG picked for each
+	uint8_t levels = 0;
+	for(uint8_t line = 0; line < 5; line++)
+	{
+		uint8_t port = (port_host.syscfg.EXTICR[line / 4] >> ((line % 4) * 4)) & 0x7;
+		if(port < 3 && (port_host.gpio[port].IDR & (1 << line)))
+		{
+			levels |= 1 << line;
+		}
+	}
+	uint8_t rose = levels & ~port_host.exti_levels;
+	uint8_t fell = ~levels & port_host.exti_levels & 0x1F;
+	port_host.exti.PR1 |= (rose & port_host.exti.RTSR1) | (fell & port_host.exti.FTSR1);
+	port_host.exti_levels = levels;
+
+	port_host_seen(PORT_GPIOA);
+	port_host_seen(PORT_GPIOB);
+	port_host_seen(PORT_GPIOC);
+	port_host_seen(PORT_EXTI);
+}
+
+// follows the matrix pins
+void port_host_panel_decode()
+{
+	port_host_panel* p = &port_host.panel;
+	uint32_t pins = port_host.gpio[2].ODR;
+	uint32_t rose = pins & ~p->pins;
+	uint8_t rgb = port_host.gpio[1].ODR & 0x3F;
+	uint64_t core = port_host_core();
+
+	if(!(p->pins & (1 << 12)))
+	{
+		p->lit_cycles += core - p->lit_since;
+	}
+	p->lit_since = core;
+
+	// CLK on PC10, the first column clocked in ends up at x = 0
+	if(rose & (1 << 10))
+	{
+		memmove(&p->shift[0][0], &p->shift[0][1], PORT_HOST_PANEL_W - 1);
+		memmove(&p->shift[1][0], &p->shift[1][1], PORT_HOST_PANEL_W - 1);
+		p->shift[0][PORT_HOST_PANEL_W - 1] = rgb & 0x7;
+		p->shift[1][PORT_HOST_PANEL_W - 1] = rgb >> 3;
+		p->clocks++;
+	}
+
+	// LAT on PC11
+	if(rose & (1 << 11))
+	{
+		memcpy(p->latch, p->shift, sizeof(p->latch));
+		p->latches++;
+	}
+
+	// OE on PC12 is active low, the address on PC7 to PC9 picks the rows
+	if(!(pins & (1 << 12)))
+	{
+		uint8_t section = (pins >> 7) & 0x7;
+		memcpy(p->shown[section], p->latch[0], PORT_HOST_PANEL_W);
+		memcpy(p->shown[section + PORT_HOST_PANEL_H / 2], p->latch[1], PORT_HOST_PANEL_W);
+		if(p->pins & (1 << 12))
+		{
+			p->sections++;
+		}
+	}
+	p->pins = pins;
+}
+
+// runs every event up to a wall cycle
+void port_host_advance(uint64_t until)
+{
+	while(1)
+	{
+		uint8_t kind, arg;
+		uint64_t at = port_host_next(&kind, &arg);
+		if(at > until)
+		{
+			break;
+		}
+		if(at > port_host.wall)
+		{
+			port_host.wall = at;
+		}
+		port_host_event(kind, arg);
+		port_host_dispatch();
+	}
+	if(until > port_host.wall)
+	{
+		port_host.wall = until;
+	}
+}
+
+// returns the wall cycle of the next event
+uint64_t port_host_next(uint8_t* kind, uint8_t* arg)
+{
+	uint64_t next = port_host.end_at;
+	*kind = PORT_EV_END;
+	*arg = 0;
+
+	#define PORT_HOST_SOONER(at, k, a) if((at) < next) { next = (at); *kind = (k); *arg = (a); }
+
+	// the core clock is behind the wall clock by the time in Stop 2, and doesn't move in it
+	if(!port_host.stopped)
+	{
+		uint64_t offset = port_host.stop_cycles;
+		for(uint8_t i = 0; i < PORT_HOST_TIMERS; i++)
+		{
+			TIM_TypeDef* t = &port_host.tim[i];
+			if(!(t->CR1 & TIM_CR1_CEN))
+			{
+				continue;
+			}
+			uint64_t tick = t->PSC + 1;
+			uint64_t base = port_host.timer[i].base + offset;
+			PORT_HOST_SOONER(base + ((uint64_t)t->ARR + 1) * tick, PORT_EV_TIMER, i);
+			if(!port_host.timer[i].cc1 && (t->DIER & TIM_DIER_CC1IE) && t->CCR1 <= t->ARR)
+			{
+				PORT_HOST_SOONER(base + (uint64_t)t->CCR1 * tick, PORT_EV_CC1, i);
+			}
+		}
+		if(port_host.tick_at != PORT_HOST_NEVER) PORT_HOST_SOONER(port_host.tick_at + offset, PORT_EV_TICK, 0);
+		if(port_host.tx_at != PORT_HOST_NEVER) PORT_HOST_SOONER(port_host.tx_at + offset, PORT_EV_TX, 0);
+		if(port_host.idle_at != PORT_HOST_NEVER) PORT_HOST_SOONER(port_host.idle_at + offset, PORT_EV_IDLE, 0);
+	}
+
+	if(port_host.lptim_base != PORT_HOST_NEVER)
+	{
+		uint64_t tick = (uint64_t)PORT_HOST_CLK * (1 << ((port_host.lptim1.CFGR & LPTIM_CFGR_PRESC) >> LPTIM_CFGR_PRESC_Pos)) / PORT_HOST_LSI_HZ;
+		PORT_HOST_SOONER(port_host.lptim_base + ((uint64_t)port_host.lptim1.ARR + 1) * tick, PORT_EV_LPTIM, 0);
+	}
+	PORT_HOST_SOONER(port_host.rx_at, PORT_EV_RX, 0);
+	PORT_HOST_SOONER(port_host.script_at, PORT_EV_SCRIPT, 0);
+
+	#undef PORT_HOST_SOONER
+	return next;
+}
+
+// runs an event
+void port_host_event(uint8_t kind, uint8_t arg)
+{
+	switch(kind)
+	{
+	case PORT_EV_TIMER:
+	{
+		TIM_TypeDef* t = &port_host.tim[arg];
+		port_host.timer[arg].base += ((uint64_t)t->ARR + 1) * (t->PSC + 1);
+		port_host.timer[arg].cc1 = 0;
+		t->SR |= TIM_SR_UIF;
+		port_host_seen(PORT_TIM2 + arg);
+		if(arg == 3)
+		{
+			port_host_adc_sample(); // TIM6 TRGO
+		}
+		break;
+	}
+	case PORT_EV_CC1:
+		port_host.timer[arg].cc1 = 1;
+		port_host.tim[arg].SR |= TIM_SR_CC1IF;
+		port_host_seen(PORT_TIM2 + arg);
+		break;
+	case PORT_EV_LPTIM:
+	{
+		uint64_t tick = (uint64_t)PORT_HOST_CLK * (1 << ((port_host.lptim1.CFGR & LPTIM_CFGR_PRESC) >> LPTIM_CFGR_PRESC_Pos)) / PORT_HOST_LSI_HZ;
+		port_host.lptim_base += ((uint64_t)port_host.lptim1.ARR + 1) * tick;
+		port_host.lptim1.ISR |= LPTIM_ISR_ARRM;
+		port_host_seen(PORT_LPTIM1);
+		break;
+	}
+	case PORT_EV_TICK:
+		port_host.tick_at += PORT_HOST_TICK_CYCLES;
+		port_host.tick_flag = 1;
+		break;
+	case PORT_EV_TX:
+	{
+		DMA_Channel_TypeDef* ch = &port_host.dma_ch[2];
+		uint8_t* mem = (uint8_t*)(uintptr_t)ch->CMAR;
+		if(port_host.tx)
+		{
+			port_host.tx(mem[port_host.dma_len[2] - ch->CNDTR]);
+		}
+		port_host.tx_bytes++;
+		if(--ch->CNDTR)
+		{
+			port_host.tx_at += port_host_byte_cycles();
+		}
+		else
+		{
+			port_host.tx_at = PORT_HOST_NEVER;
+			port_host.dma1.ISR |= DMA_ISR_TCIF7 | DMA_ISR_GIF7;
+			port_host.usart2.ISR |= USART_ISR_TC;
+		}
+		port_host_seen(PORT_DMA1);
+		port_host_seen(PORT_DMA1_CH7);
+		port_host_seen(PORT_USART2);
+		break;
+	}
+	case PORT_EV_RX:
+	{
+		uint8_t byte = port_host.rx[port_host.rx_tail++ % PORT_HOST_RX_LEN];
+		USART_TypeDef* u = &port_host.usart2;
+		DMA_Channel_TypeDef* ch = &port_host.dma_ch[1];
+		uint32_t on = USART_CR1_UE | USART_CR1_RE;
+
+		// the USART is off in Stop 2, the byte is lost
+		if(port_host.stopped || (u->CR1 & on) != on)
+		{
+			port_host.rx_lost++;
+		}
+		else if((u->CR3 & USART_CR3_DMAR) && (ch->CCR & DMA_CCR_EN) && ch->CNDTR)
+		{
+			uint8_t* mem = (uint8_t*)(uintptr_t)ch->CMAR;
+			mem[port_host.dma_len[1] - ch->CNDTR] = byte;
+			ch->CNDTR--;
+			if(ch->CNDTR == port_host.dma_len[1] / 2) port_host.dma1.ISR |= DMA_ISR_HTIF6 | DMA_ISR_GIF6;
+			if(ch->CNDTR == 0)
+			{
+				port_host.dma1.ISR |= DMA_ISR_TCIF6 | DMA_ISR_GIF6;
+				if(ch->CCR & DMA_CCR_CIRC) ch->CNDTR = port_host.dma_len[1];
+			}
+			port_host.rx_bytes++;
+		}
+		else
+		{
+			if(u->ISR & USART_ISR_RXNE) u->ISR |= USART_ISR_ORE;
+			u->RDR = byte;
+			u->ISR |= USART_ISR_RXNE;
+			port_host.rx_bytes++;
+		}
+
+		port_host.idle_at = port_host.stopped ? PORT_HOST_NEVER : port_host_core() + port_host_byte_cycles();
+		port_host.rx_at = (port_host.rx_head != port_host.rx_tail) ? port_host.rx_at + port_host_byte_cycles() : PORT_HOST_NEVER;
+		port_host_seen(PORT_DMA1);
+		port_host_seen(PORT_DMA1_CH6);
+		port_host_seen(PORT_USART2);
+		break;
+	}
+	case PORT_EV_IDLE:
+		port_host.idle_at = PORT_HOST_NEVER;
+		port_host.usart2.ISR |= USART_ISR_IDLE;
+		port_host_seen(PORT_USART2);
+		break;
+	case PORT_EV_SCRIPT:
+		port_host.script_at = PORT_HOST_NEVER;
+		if(port_host.script)
+		{
+			port_host.script(); // sets the next script_at
+		}
+		break;
+	case PORT_EV_END:
+		longjmp(port_host.done, 1);
+		break;
+	}
+}
+
+// returns the index of the first requested and enabled interrupt + 1, 0 if none
+uint8_t port_host_pending()
+{
+	for(uint8_t i = 0; i < PORT_HOST_IRQS; i++)
+	{
+		port_host_irq* q = &port_host_irqs[i];
+		if(q->handler && (port_host.nvic.ISER[q->irq >> 5] & (1 << (q->irq & 0x1F))) && q->active())
+		{
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+// runs the pending interrupt handlers unless masked or asleep
+void port_host_dispatch()
+{
+	if(port_host.in_isr || port_host.primask || port_host.asleep)
+	{
+		return;
+	}
+
+	uint32_t taken = 0;
+	uint8_t i;
+	while((i = port_host_pending()))
+	{
+		port_host_irq* q = &port_host_irqs[i - 1];
+		if(++taken > PORT_HOST_STORM)
+		{
+			fprintf(stderr, "port_host: %s keeps interrupting, its flag is never cleared\n", q->name);
+			exit(1);
+		}
+
+		uint64_t entry = port_host_core();
+		port_host.in_isr = 1;
+		port_host_advance(port_host.wall + PORT_HOST_IRQ_CYCLES / 2);
+		q->handler();
+		port_host_writes(port_host.touched);
+		port_host.touched = 0;
+		port_host_advance(port_host.wall + PORT_HOST_IRQ_CYCLES / 2);
+		port_host.in_isr = 0;
+		q->count++;
+		q->cycles += port_host_core() - entry;
+
+		// clearing a pending bit that is already the only one set can't be seen, the handler did it
+		if(q->irq >= EXTI0_IRQn && q->irq <= EXTI4_IRQn)
+		{
+			port_host.exti.PR1 &= ~(1 << (q->irq - EXTI0_IRQn));
+			port_host_seen(PORT_EXTI);
+		}
+	}
+}
+
+// a TIM6 trigger, converts the joystick into the DMA buffer
+void port_host_adc_sample()
+{
+	ADC_TypeDef* a = &port_host.adc[0];
+	DMA_Channel_TypeDef* ch = &port_host.dma_ch[0];
+	uint32_t on = ADC_CR_ADEN | ADC_CR_ADSTART;
+
+	if((a->CR & on) != on || !(ch->CCR & DMA_CCR_EN) || !ch->CNDTR)
+	{
+		return;
+	}
+
+	uint32_t* mem = (uint32_t*)(uintptr_t)ch->CMAR;
+	mem[port_host.dma_len[0] - ch->CNDTR] = ((uint32_t)port_host.joy_y << 16) | port_host.joy_x;
+	ch->CNDTR--;
+	if(ch->CNDTR == port_host.dma_len[0] / 2) port_host.dma1.ISR |= DMA_ISR_HTIF1 | DMA_ISR_GIF1;
+	if(ch->CNDTR == 0)
+	{
+		port_host.dma1.ISR |= DMA_ISR_TCIF1 | DMA_ISR_GIF1;
+		if(ch->CCR & DMA_CCR_CIRC) ch->CNDTR = port_host.dma_len[0];
+	}
+	port_host_seen(PORT_DMA1);
+	port_host_seen(PORT_DMA1_CH1);
+}
+
+// returns the cycles of a USART2 frame
+uint32_t port_host_byte_cycles()
+{
+	uint32_t brr = port_host.usart2.BRR;
+	return 10 * (brr ? brr : 1); // start, 8 data, stop
+}
+
+// returns 1 if timer i requests its interrupt
+uint8_t port_host_timer_irq(uint8_t i)
+{
+	TIM_TypeDef* t = &port_host.tim[i];
+	return (t->SR & t->DIER & (TIM_SR_UIF | TIM_SR_CC1IF)) != 0;
+}
+
+// returns 1 if DMA1 channel ch requests its interrupt
+uint8_t port_host_dma_irq(uint8_t ch)
+{
+	DMA_Channel_TypeDef* c = &port_host.dma_ch[ch == 1 ? 0 : ch - 5];
+	uint32_t flags = port_host.dma1.ISR >> ((ch - 1) * 4);
+	return ((flags & DMA_ISR_TCIF1) && (c->CCR & DMA_CCR_TCIE))
+			|| ((flags & DMA_ISR_HTIF1) && (c->CCR & DMA_CCR_HTIE))
+			|| ((flags & DMA_ISR_TEIF1) && (c->CCR & DMA_CCR_TEIE));
+}
+
+// returns 1 if an EXTI line requests its interrupt
+uint8_t port_host_exti_irq(uint8_t line)
+{
+	return (port_host.exti.PR1 & port_host.exti.IMR1 & (1 << line)) != 0;
+}
+
+
+// the HAL calls of the firmware, the clock tree is always ready
+HAL_StatusTypeDef HAL_Init(void)
+{
+	port_host.tick_at = port_host_core() + PORT_HOST_TICK_CYCLES;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PWREx_ControlVoltageScaling(uint32_t VoltageScaling)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef* RCC_OscInitStruct)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef* RCC_ClkInitStruct, uint32_t FLatency)
+{
+	return HAL_OK;
+}
+
+void HAL_SuspendTick(void)
+{
+	port_host.tick_at = PORT_HOST_NEVER;
+}
+
+void HAL_ResumeTick(void)
+{
+	port_host.tick_at = port_host_core() + PORT_HOST_TICK_CYCLES;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return (uint32_t)(port_host_core() / PORT_HOST_TICK_CYCLES);
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* PageError)
+{
+	memset(port_host.flash_page, 0xFF, PORT_HOST_FLASH_LEN); // the only page there is
+	*PageError = 0xFFFFFFFF;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+	memcpy(port_host_flash_at(Address), &Data, sizeof(Data));
+	return HAL_OK;
+}
+
+#endif /* INC_PORT_HOST_H_ */
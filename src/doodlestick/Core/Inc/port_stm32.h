@@ -0,0 +1,26 @@
+/*
+ * port_stm32.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the STM32L476 backend of the port layer
+ *
+ *  	the peripherals and intrinsics come straight from the HAL and CMSIS
+ *  	headers, nothing is wrapped, so the target build is the same code as
+ *  	before the port layer
+ *
+ *  	DEPENDENCIES
+ *  		included by port.h, not directly
+ */
+
+#ifndef INC_PORT_STM32_H_
+#define INC_PORT_STM32_H_
+
+#include "stm32l4xx_hal.h"
+
+
+// defines
+#define PORT_WAIT() 		// the peripheral or the interrupt moves on by itself
+#define PORT_FLASH(addr) 	((const void*)(addr)) // flash is mapped at its address
+
+#endif /* INC_PORT_STM32_H_ */
@@ -0,0 +1,194 @@
+/*
+ * power.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for dimming the matrix and stopping the core while nobody is drawing
+ *
+ *  	STATES
+ *  		POWER_ACTIVE 	full brightness
+ *  		POWER_DIM 		no input for POWER_DIM_MS, the matrix is dimmed
+ *  		POWER_STOP 		no input for POWER_STOP_MS, the matrix is dark
+ *  						and the core is in Stop 2 until something wakes it
+ *  		any input goes back to POWER_ACTIVE, power_update() only gives the
+ *  		state, the caller dims or stops the matrix
+ *
+ *  	STOP 2
+ *  		every clock but the LSI is off, the timers stop (TIM5 too, so the
+ *  		scheduler's clock doesn't see the time spent here) and the RAM and
+ *  		the pins are kept
+ *  		the keypad rows (EXTI0 to EXTI3, armed once the keypad is idle) and
+ *  		the button (EXTI4) wake the core up directly
+ *  		the joystick has no edge to wake on, so LPTIM1 on the LSI wakes the
+ *  		core every POWER_POLL_MS, the ADC gets POWER_SETTLE_US of samples
+ *  		and the caller's wake() looks at the stick
+ *  		wake() is called after every wake up and returns 1 to stay awake,
+ *  		anything else (a poll with the stick at rest, a stray interrupt)
+ *  		goes straight back to Stop 2
+ *  		serial input can't wake the core, a character sent while stopped
+ *  		is lost
+ *
+ *  	DEPENDENCIES
+ *  		joystick.h (SystemClock_Config), profile.h and telemetry.h must be included first,
+ *  		TIM5 must be running (journal_timer_init)
+ */
+
+#ifndef INC_POWER_H_
+#define INC_POWER_H_
+
+
+// defines
+#define POWER_DIM_MS 		30000 	// time without input before the matrix dims
+#define POWER_STOP_MS 		120000 	// time without input before the matrix goes dark and the core stops
+#define POWER_DIM_PERCENT 	15 		// matrix brightness while dimmed
+#define POWER_POLL_MS 		250 	// LPTIM1 wake up period in Stop 2, to look at the joystick
+#define POWER_SETTLE_US 	5000 	// time awake after a poll for the joystick filter to catch up
+
+// typedefs
+typedef enum POWER_STATE {
+		POWER_ACTIVE 	= 0,
+		POWER_DIM 		= 1,
+		POWER_STOP 		= 2
+} POWER_STATE;
+
+typedef struct power_manager
+{
+	uint8_t 			state; 		// POWER_STATE
+	volatile uint8_t 	polled; 	// set by LPTIM1, the last wake up was a poll
+	uint32_t 			last_input; // TIM5 time of the last input
+	uint32_t 			dims; 		// times the matrix dimmed
+	uint32_t 			stops; 		// times the core went into Stop 2
+	uint32_t 			polls; 		// joystick polls while stopped
+	uint32_t 			stop_ms; 	// time spent in Stop 2
+} power_manager;
+
+power_manager power = {0};
+
+// function declarations
+void power_init(uint32_t now); // starts the LSI and sets up LPTIM1 to wake the core from Stop 2
+void power_activity(uint32_t now); // an input happened, back to POWER_ACTIVE on the next update
+uint8_t power_update(uint32_t now); // returns the POWER_STATE for the time since the last input
+void power_stop(uint8_t (*wake)()); // stays in Stop 2 until wake() returns 1 after a wake up
+uint16_t power_poll_count(); // returns the ms LPTIM1 has counted since the last poll
+void LPTIM1_IRQHandler(void); // a poll period in Stop 2 is over
+
+
+// starts the LSI and sets up LPTIM1 to wake the core from Stop 2
+void power_init(uint32_t now)
+{
+	power.last_input = now;
+	power.state = POWER_ACTIVE;
+
+	RCC->APB1ENR1 |= RCC_APB1ENR1_PWREN | RCC_APB1ENR1_LPTIM1EN;
+
+	// the LSI keeps running in Stop 2
+	RCC->CSR |= RCC_CSR_LSION;
+	while(!(RCC->CSR & RCC_CSR_LSIRDY));
+
+	// LPTIM1 counts the LSI / 32, about 1ms, and is only enabled while stopped
+	RCC->CCIPR = (RCC->CCIPR & ~RCC_CCIPR_LPTIM1SEL) | RCC_CCIPR_LPTIM1SEL_0;
+	LPTIM1->CR = 0;
+	LPTIM1->CFGR = LPTIM_CFGR_PRESC_2 | LPTIM_CFGR_PRESC_0; 	// divide by 32
+	LPTIM1->IER = LPTIM_IER_ARRMIE; 	// only written while disabled
+
+	// EXTI line 32 carries the LPTIM1 wake up out of Stop 2, it is in the second mask register
+	EXTI->IMR2 |= EXTI_IMR2_IM32;
+	NVIC->ISER[LPTIM1_IRQn >> 5] = (1 << (LPTIM1_IRQn & 0x1F));
+}
+
+// an input happened, back to POWER_ACTIVE on the next update
+void power_activity(uint32_t now)
+{
+	power.last_input = now;
+}
+
+// returns the POWER_STATE for the time since the last input
+uint8_t power_update(uint32_t now)
+{
+	uint32_t quiet_ms = (now - power.last_input) / 1000;
+	uint8_t state = POWER_ACTIVE;
+
+	if(quiet_ms >= POWER_STOP_MS) 		state = POWER_STOP;
+	else if(quiet_ms >= POWER_DIM_MS) 	state = POWER_DIM;
+
+	if(state == POWER_DIM && power.state == POWER_ACTIVE) power.dims++;
+	power.state = state;
+	return state;
+}
+
+// stays in Stop 2 until wake() returns 1 after a wake up
+void power_stop(uint8_t (*wake)())
+{
+	power.stops++;
+
+	// ARR can only be written once enabled
+	LPTIM1->CR = LPTIM_CR_ENABLE;
+	LPTIM1->ARR = POWER_POLL_MS - 1;
+	while(!(LPTIM1->ISR & LPTIM_ISR_ARROK));
+	LPTIM1->ICR = LPTIM_ICR_ARROKCF;
+	LPTIM1->CR |= LPTIM_CR_CNTSTRT;
+
+	while(1)
+	{
+		power.polled = 0;
+
+		// the SysTick would wake it every ms
+		HAL_SuspendTick();
+		PWR->CR1 = (PWR->CR1 & ~PWR_CR1_LPMS) | PWR_CR1_LPMS_STOP2;
+		SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+		__WFI();
+		SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+		// wakes up on the MSI, set the clocks up as at boot
+		HAL_ResumeTick();
+		SystemClock_Config();
+
+		if(power.polled)
+		{
+			power.polls++;
+			power.stop_ms += POWER_POLL_MS;
+
+			// fresh joystick samples for wake()
+			uint32_t start = TIM5->CNT;
+			while(TIM5->CNT - start < POWER_SETTLE_US);
+		}
+
+		if(wake())
+		{
+			break;
+		}
+	}
+
+	// the part of the poll period before the wake up, disabling clears the count
+	power.stop_ms += power_poll_count();
+	LPTIM1->CR = 0;
+	power_activity(TIM5->CNT);
+	power.state = POWER_ACTIVE;
+}
+
+// returns the ms LPTIM1 has counted since the last poll
+uint16_t power_poll_count()
+{
+	// the counter runs on the LSI, two reads that agree are a good one
+	uint16_t count;
+	do
+	{
+		count = LPTIM1->CNT;
+	} while(count != LPTIM1->CNT);
+	return count;
+}
+
+// a poll period in Stop 2 is over
+void LPTIM1_IRQHandler(void)
+{
+	PROFILE_BEGIN(PROFILE_LPTIM1);
+	telemetry.isr[TELEMETRY_ISR_LPTIM1]++;
+	if(LPTIM1->ISR & LPTIM_ISR_ARRM)
+	{
+		LPTIM1->ICR = LPTIM_ICR_ARRMCF;
+		power.polled = 1;
+	}
+	PROFILE_END(PROFILE_LPTIM1);
+}
+
+#endif /* INC_POWER_H_ */
@@ -0,0 +1,145 @@
+/*
+ * profile.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for timing named zones of the firmware with the DWT cycle counter
+ *
+ *  	ZONES
+ *  		PROFILE_BEGIN(zone) and PROFILE_END(zone) around a piece of code
+ *  		read DWT->CYCCNT and add the cycles in between to the zone, both
+ *  		in the same block, a zone is entered and left once per pass
+ *  		every zone keeps its count, fewest, most and total cycles and a
+ *  		histogram in powers of 2, bucket 0 is 0 cycles, bucket b is
+ *  		2^(b-1) to 2^b - 1 cycles and the last bucket takes everything longer
+ *  		the cycles include the read of CYCCNT, and for the main loop zones
+ *  		the interrupts taken inside them
+ *
+ *  	WRITERS
+ *  		each zone is recorded from one place only, an interrupt handler or
+ *  		the main loop, so the recording needs no locking, the main loop
+ *  		copies and clears a zone with interrupts masked
+ *
+ *  	OFF
+ *  		with PROFILE_ENABLED 0 (-DPROFILE_ENABLED=0) the macros are empty
+ *  		and nothing of this file is compiled, profile_init() included,
+ *  		but cycle_counter_init(), which bench.h starts the counter with
+ *
+ *  	DEPENDENCIES
+ *  		must be included before the drivers whose interrupts it times, the
+ *  		main loop prints the zones ('z')
+ */
+
+#ifndef INC_PROFILE_H_
+#define INC_PROFILE_H_
+
+
+// defines
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 	1 		// 0 compiles the zones out
+#endif
+#define PROFILE_BUCKETS 	20 		// histogram buckets, the last one is 2^18 cycles (8ms) and more
+#define PROFILE_LINE_LEN 	96 		// longest part of a dump line printed at once
+
+#if PROFILE_ENABLED
+#define PROFILE_INIT() 			profile_init()
+#define PROFILE_BEGIN(zone) 	uint32_t profile_start_##zone = DWT->CYCCNT
+#define PROFILE_END(zone) 		profile_record(zone, DWT->CYCCNT - profile_start_##zone)
+#else
+#define PROFILE_INIT()
+#define PROFILE_BEGIN(zone)
+#define PROFILE_END(zone)
+#endif /* PROFILE_ENABLED */
+
+// typedefs
+typedef enum PROFILE_ZONE {
+		PROFILE_UPDATE_DISPLAY 	= 0, // update_display() when it drives the pins
+		PROFILE_MOVE_CURSOR 	= 1, // move_cursor(), one cursor tick
+		PROFILE_TIM2 			= 2, // cursor tick interrupt
+		PROFILE_TIM7 			= 3, // keypad column scan
+		PROFILE_KEYPAD_ROW 		= 4, // EXTI0 to EXTI3, keypad wake up
+		PROFILE_EXTI4 			= 5, // first button edge
+		PROFILE_TIM16 			= 6, // 1ms button tick
+		PROFILE_USART2 			= 7, // receive idle line and overrun
+		PROFILE_DMA_RX 			= 8, // DMA1 channel 6, receive half and full
+		PROFILE_DMA_TX 			= 9, // DMA1 channel 7, transmit done
+		PROFILE_TIM3 			= 10, // matrix section refresh
+		PROFILE_LPTIM1 			= 11, // joystick poll in Stop 2
+		PROFILE_NUM_ZONES 		= 12
+} PROFILE_ZONE;
+
+// function declarations
+void cycle_counter_init(); // starts DWT->CYCCNT, also used by bench.h
+
+
+// starts DWT->CYCCNT, also used by bench.h
+void cycle_counter_init()
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // the DWT needs the trace clock
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+#if PROFILE_ENABLED
+
+typedef struct profile_zone
+{
+	uint32_t 	count; 		// passes recorded
+	uint32_t 	min; 		// cycles of the shortest pass, 0 if none
+	uint32_t 	max; 		// cycles of the longest pass
+	uint64_t 	total; 		// cycles of every pass
+	uint32_t 	buckets[PROFILE_BUCKETS]; // passes per power of 2 of cycles
+} profile_zone;
+
+typedef struct profiler
+{
+	profile_zone zones[PROFILE_NUM_ZONES];
+} profiler;
+
+profiler profile = {0};
+
+// names in the dump, in PROFILE_ZONE order
+const char* const profile_names[PROFILE_NUM_ZONES] = {
+		"update_display", "move_cursor", "TIM2", "TIM7", "KEYPAD_ROW", "EXTI4",
+		"TIM16", "USART2", "DMA_RX", "DMA_TX", "TIM3", "LPTIM1"
+};
+
+// function declarations
+void profile_init(); // starts the cycle counter
+void profile_record(uint8_t zone, uint32_t cycles); // adds a pass of a zone
+void profile_take(uint8_t zone, profile_zone* out); // copies a zone into out and clears it
+
+
+// starts the cycle counter
+void profile_init()
+{
+	cycle_counter_init();
+}
+
+// adds a pass of a zone
+void profile_record(uint8_t zone, uint32_t cycles)
+{
+	profile_zone* z = &profile.zones[zone];
+	uint8_t bucket = 32 - __CLZ(cycles); // 0 for 0 cycles
+
+	if(bucket >= PROFILE_BUCKETS) bucket = PROFILE_BUCKETS - 1;
+	if(!z->count || cycles < z->min) z->min = cycles;
+	if(cycles > z->max) z->max = cycles;
+	z->count++;
+	z->total += cycles;
+	z->buckets[bucket]++;
+}
+
+// copies a zone into out and clears it
+void profile_take(uint8_t zone, profile_zone* out)
+{
+	// an interrupt zone could be written half way through the copy
+	uint32_t mask = __get_PRIMASK();
+	__disable_irq();
+	*out = profile.zones[zone];
+	profile.zones[zone] = (profile_zone){0};
+	__set_PRIMASK(mask);
+}
+
+#endif /* PROFILE_ENABLED */
+
+#endif /* INC_PROFILE_H_ */
@@ -30,6 +30,7 @@ void clear_matrix(); // clears the matrix buffer and updates the display
 void fill_matrix(color c); // fills the matrix with the selected color
 
 void draw_pixel(uint8_t x, uint8_t y, color c); // draws the selected color at the input coordinate then updates display
+void set_pixel(uint8_t x, uint8_t y, color c); // sets the selected color at the input coordinate without updating the display
 void clear_pixel(uint8_t x, uint8_t y); // removes the pixel at the input coordinates from the buffer then updates the display
 
 void make_smiley(color c); // makes a 'relief' smiley face with the background color as the input
@@ -0,0 +1,185 @@
+/*
+ * scheduler.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the cooperative run to completion scheduler of the main loop
+ *
+ *  	TASKS
+ *  		a task is a function that runs to completion, it is runnable when
+ *  		its period has come around or when has_work() says an interrupt
+ *  		left something for it (an event ring that isn't empty), or both
+ *  		the task table is in priority order, every pass runs the first
+ *  		runnable task and starts over from the top, so a higher task never
+ *  		waits for more than the one task that is already running
+ *
+ *  	PERIODS
+ *  		a periodic task is due every period_us on the 1us TIM5 clock
+ *  		if it starts late its next start is still on the grid, if it missed
+ *  		a whole period the missed runs are dropped and counted as overruns
+ *  		instead of being run back to back
+ *
+ *  	IDLE
+ *  		when no task is runnable the core sleeps with WFI until the next
+ *  		interrupt, the check and the WFI are done with interrupts masked,
+ *  		so an event posted in between still wakes it
+ *  		the 1ms SysTick of the HAL wakes it at least every ms, which is the
+ *  		resolution of the periods
+ *
+ *  	ACCOUNTING
+ *  		every run is timed, each task keeps its runs, total and longest run
+ *  		time and its worst start delay, the scheduler keeps the time spent
+ *  		asleep, so the load of every task and the idle time add up
+ *  		idle_total_us is never cleared by the statistics, the duty cycle
+ *  		is one minus its change over the change of the clock
+ *
+ *  	HOST BUILD
+ *  		port_host.h models TIM5, the interrupt mask and WFI, so the
+ *  		scheduler runs unchanged in doodle_sim
+ */
+
+#ifndef INC_SCHEDULER_H_
+#define INC_SCHEDULER_H_
+
+
+// defines
+#define SCHED_NOW() 		(TIM5->CNT)
+#define SCHED_IRQ_OFF() 	__disable_irq()
+#define SCHED_IRQ_ON() 		__enable_irq()
+#define SCHED_SLEEP() 		__WFI() // a pending interrupt wakes it even while masked
+
+// typedefs
+typedef struct task
+{
+	const char* 	name; 		// for the statistics
+	void 			(*run)(); 	// runs to completion
+	uint8_t 		(*has_work)(); // returns 1 if an event is waiting, NULL for a periodic only task
+	uint32_t 		period_us; 	// 0 for a task that only runs on events
+	uint32_t 		next; 		// when the next periodic run is due
+	uint32_t 		runs; 		// times run
+	uint32_t 		busy_us; 	// total run time
+	uint32_t 		max_us; 	// longest run
+	uint32_t 		late_us; 	// worst delay of a periodic start past its due time
+	uint32_t 		overruns; 	// periodic runs dropped because a whole period was missed
+} task;
+
+typedef struct scheduler
+{
+	task* 		tasks; 		// in priority order, highest first
+	uint8_t 	count;
+	uint32_t 	since; 		// start of the statistics
+	uint32_t 	idle_us; 	// time asleep
+	uint32_t 	idle_total_us; // time asleep since sched_init(), never cleared, wraps
+	uint32_t 	sleeps; 	// times nothing was runnable
+} scheduler;
+
+// function declarations
+void sched_init(scheduler* s, task* tasks, uint8_t count); // takes the task table, every periodic task is due right away
+uint8_t sched_due(const task* t, uint32_t now); // returns 1 if the task's period has come around
+task* sched_next(scheduler* s, uint32_t now); // returns the highest priority runnable task, NULL if none
+void sched_run_once(scheduler* s); // runs the highest priority runnable task or sleeps until an interrupt
+void sched_run(task* t, uint32_t now); // runs a task and adds up its time, moves its due time on
+void sched_reset_stats(scheduler* s); // clears the accounting of the scheduler and every task
+
+
+// takes the task table, every periodic task is due right away
+void sched_init(scheduler* s, task* tasks, uint8_t count)
+{
+	uint32_t now = SCHED_NOW();
+
+	s->tasks = tasks;
+	s->count = count;
+	s->idle_total_us = 0;
+	for(uint8_t i = 0; i < count; i++)
+	{
+		tasks[i].next = now;
+	}
+	sched_reset_stats(s);
+}
+
+// returns 1 if the task's period has come around
+uint8_t sched_due(const task* t, uint32_t now)
+{
+	return t->period_us && (int32_t)(now - t->next) >= 0;
+}
+
+// returns the highest priority runnable task, NULL if none
+task* sched_next(scheduler* s, uint32_t now)
+{
+	for(uint8_t i = 0; i < s->count; i++)
+	{
+		task* t = &s->tasks[i];
+		if(sched_due(t, now) || (t->has_work && t->has_work()))
+		{
+			return t;
+		}
+	}
+	return NULL;
+}
+
+// runs the highest priority runnable task or sleeps until an interrupt
+void sched_run_once(scheduler* s)
+{
+	uint32_t now = SCHED_NOW();
+	task* t = sched_next(s, now);
+
+	if(t)
+	{
+		sched_run(t, now);
+		return;
+	}
+
+	// check again with interrupts masked, an event posted after the check above still wakes the WFI
+	SCHED_IRQ_OFF();
+	if(!sched_next(s, SCHED_NOW()))
+	{
+		SCHED_SLEEP();
+		s->sleeps++;
+	}
+	SCHED_IRQ_ON();
+	uint32_t slept = SCHED_NOW() - now;
+	s->idle_us += slept;
+	s->idle_total_us += slept;
+}
+
+// runs a task and adds up its time, moves its due time on
+void sched_run(task* t, uint32_t now)
+{
+	if(sched_due(t, now))
+	{
+		uint32_t late = now - t->next;
+		if(late > t->late_us) t->late_us = late;
+
+		// stay on the grid, drop the whole periods that were missed
+		if(late >= t->period_us)
+		{
+			t->overruns += late / t->period_us;
+		}
+		t->next += (late / t->period_us + 1) * t->period_us;
+	}
+
+	t->run();
+
+	uint32_t took = SCHED_NOW() - now;
+	t->runs++;
+	t->busy_us += took;
+	if(took > t->max_us) t->max_us = took;
+}
+
+// clears the accounting of the scheduler and every task
+void sched_reset_stats(scheduler* s)
+{
+	for(uint8_t i = 0; i < s->count; i++)
+	{
+		s->tasks[i].runs = 0;
+		s->tasks[i].busy_us = 0;
+		s->tasks[i].max_us = 0;
+		s->tasks[i].late_us = 0;
+		s->tasks[i].overruns = 0;
+	}
+	s->since = SCHED_NOW();
+	s->idle_us = 0;
+	s->sleeps = 0;
+}
+
+#endif /* INC_SCHEDULER_H_ */
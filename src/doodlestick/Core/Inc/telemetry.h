@@ -0,0 +1,176 @@
+/*
+ * telemetry.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  header file for the binary telemetry records sent over USART2
+ *
+ *  	COUNTERS
+ *  		every interrupt handler adds one to its own telemetry.isr counter,
+ *  		the main loop counts its loops, the matrix refresh its frames
+ *  		each counter has a single writer and is one 32 bit store, so the
+ *  		main loop reads them without turning interrupts off
+ *
+ *  	RECORDS
+ *  		a record is a protocol frame (frame_protocol.h) with cmd PROTO_TELEMETRY
+ *  		every field is a free running total, low byte first, nothing is
+ *  		formatted or divided on the board, the host takes the difference of
+ *  		two records over the difference of their times to get a rate, so a
+ *  		lost record only costs resolution
+ *  		 0 	PROTO_TELEMETRY
+ *  		 1 	seq, records sent, the host sees a lost one
+ *  		 2 	mode, the KP_MODE
+ *  		 3 	option, -1 if none is picked
+ *  		 4 	time, TIM5 timestamp in us
+ *  		 8 	main loops
+ *  		12 	display refreshes
+ *  		16 	ADC samples filtered
+ *  		20 	keypad events posted (2 bytes)
+ *  		22 	button events posted (2 bytes)
+ *  		24 	events dropped by the tick, keypad, button and serial rings (2 bytes each)
+ *  		32 	transmit bytes dropped (2 bytes)
+ *  		34 	interrupts of every TELEMETRY_ISR source (4 bytes each)
+ *  		then time the scheduler slept, us (4 bytes)
+ *  		and time spent in Stop 2, ms (4 bytes)
+ *
+ *  	RATE
+ *  		a record is sent every TELEMETRY_PERIOD_MS while telemetry is on,
+ *  		only if it fits in the transmit ring, otherwise it is skipped and
+ *  		counted so telemetry never stalls the loop it is measuring
+ *
+ *  	DEPENDENCIES
+ *  		event_ring.h and frame_protocol.h must be included first, this file
+ *  		must be included before the drivers whose interrupts it counts
+ *  		tools/doodle_telemetry.py turns the records into CSV
+ */
+
+#ifndef INC_TELEMETRY_H_
+#define INC_TELEMETRY_H_
+
+
+// defines
+#define PROTO_TELEMETRY 		0x41 	// unsolicited telemetry record, never a reply
+#define TELEMETRY_PERIOD_MS 	1000 	// time between records
+#define TELEMETRY_PAYLOAD 		(42 + 4 * TELEMETRY_NUM_ISR) // without the crc
+#define TELEMETRY_MAX_ENCODED 	(TELEMETRY_PAYLOAD + 2 + 1 + 3) // crc, COBS overhead and both delimiters
+
+// typedefs
+typedef enum TELEMETRY_ISR {
+		TELEMETRY_ISR_TIM2 		= 0, // cursor tick
+		TELEMETRY_ISR_TIM7 		= 1, // keypad column scan
+		TELEMETRY_ISR_KEYPAD_ROW = 2, // EXTI0 to EXTI3, keypad wake up
+		TELEMETRY_ISR_EXTI4 	= 3, // first button edge
+		TELEMETRY_ISR_TIM16 	= 4, // 1ms button tick
+		TELEMETRY_ISR_USART2 	= 5, // receive idle line and overrun
+		TELEMETRY_ISR_DMA_RX 	= 6, // DMA1 channel 6, receive half and full
+		TELEMETRY_ISR_DMA_TX 	= 7, // DMA1 channel 7, transmit done
+		TELEMETRY_ISR_TIM3 		= 8, // matrix section refresh
+		TELEMETRY_ISR_LPTIM1 	= 9, // joystick poll in Stop 2
+		TELEMETRY_NUM_ISR 		= 10
+} TELEMETRY_ISR;
+
+typedef struct telemetry_counters
+{
+	uint8_t 			on; 		// 1 while records are sent
+	uint8_t 			seq; 		// records sent, wraps
+	uint32_t 			last; 		// TIM5 time of the last record
+	uint32_t 			loops; 		// main loops run
+	uint32_t 			refreshes; 	// display refreshes
+	volatile uint32_t 	isr[TELEMETRY_NUM_ISR]; // interrupts taken by each source
+	uint32_t 			records; 	// records sent
+	uint32_t 			skipped; 	// records that didn't fit in the transmit ring
+} telemetry_counters;
+
+typedef struct telemetry_record
+{
+	uint8_t 	mode; 			// KP_MODE
+	int8_t 		option; 		// -1 if none is picked
+	uint32_t 	time; 			// TIM5 timestamp, us
+	uint32_t 	adc_samples; 	// ADC samples filtered
+	uint16_t 	key_events; 	// keypad events posted
+	uint16_t 	button_events; 	// button events posted
+	uint16_t 	dropped[4]; 	// events dropped by the tick, keypad, button and serial rings
+	uint16_t 	tx_dropped; 	// transmit bytes dropped
+	uint32_t 	idle_us; 		// time the scheduler slept, TIM5 doesn't count in Stop 2
+	uint32_t 	stop_ms; 		// time spent in Stop 2
+} telemetry_record;
+
+telemetry_counters telemetry = {0};
+
+// function declarations
+void telemetry_start(uint32_t now); // starts sending records, the first one right away
+void telemetry_stop(); // stops sending records
+uint8_t telemetry_due(uint32_t now); // returns 1 if telemetry is on and a record is due
+uint8_t telemetry_put(uint8_t* out, uint32_t value, uint8_t bytes); // writes the low bytes of a value low byte first, returns the bytes written
+uint16_t telemetry_build(const telemetry_record* rec, uint8_t* out); // encodes a record with the counters, returns the encoded length
+
+
+// starts sending records, the first one right away
+void telemetry_start(uint32_t now)
+{
+	telemetry.last = now - TELEMETRY_PERIOD_MS * 1000;
+	telemetry.on = 1;
+}
+
+// stops sending records
+void telemetry_stop()
+{
+	telemetry.on = 0;
+}
+
+// returns 1 if telemetry is on and a record is due
+uint8_t telemetry_due(uint32_t now)
+{
+	return telemetry.on && (uint32_t)(now - telemetry.last) >= TELEMETRY_PERIOD_MS * 1000;
+}
+
+// writes the low bytes of a value low byte first, returns the bytes written
+uint8_t telemetry_put(uint8_t* out, uint32_t value, uint8_t bytes)
+{
+	for(uint8_t i = 0; i < bytes; i++)
+	{
+		out[i] = (value >> (8 * i)) & 0xFF;
+	}
+	return bytes;
+}
+
+// encodes a record with the counters, returns the encoded length
+uint16_t telemetry_build(const telemetry_record* rec, uint8_t* out)
+{
+	uint8_t payload[TELEMETRY_PAYLOAD + 2];
+	uint16_t n = 0;
+	uint16_t crc = PROTO_CRC_INIT;
+
+	payload[n++] = PROTO_TELEMETRY;
+	payload[n++] = telemetry.seq++;
+	payload[n++] = rec->mode;
+	payload[n++] = (uint8_t)rec->option;
+	n += telemetry_put(&payload[n], rec->time, 4);
+	n += telemetry_put(&payload[n], telemetry.loops, 4);
+	n += telemetry_put(&payload[n], telemetry.refreshes, 4);
+	n += telemetry_put(&payload[n], rec->adc_samples, 4);
+	n += telemetry_put(&payload[n], rec->key_events, 2);
+	n += telemetry_put(&payload[n], rec->button_events, 2);
+	for(uint8_t i = 0; i < 4; i++)
+	{
+		n += telemetry_put(&payload[n], rec->dropped[i], 2);
+	}
+	n += telemetry_put(&payload[n], rec->tx_dropped, 2);
+	for(uint8_t i = 0; i < TELEMETRY_NUM_ISR; i++)
+	{
+		n += telemetry_put(&payload[n], telemetry.isr[i], 4);
+	}
+	n += telemetry_put(&payload[n], rec->idle_us, 4);
+	n += telemetry_put(&payload[n], rec->stop_ms, 4);
+
+	for(uint16_t i = 0; i < n; i++)
+	{
+		crc = proto_crc(crc, payload[i]);
+	}
+	payload[n++] = crc >> 8;
+	payload[n++] = crc & 0xFF;
+
+	return proto_encode(payload, n, out);
+}
+
+#endif /* INC_TELEMETRY_H_ */
@@ -4,6 +4,24 @@
  *  Created on: Dec 5, 2023
  *      Author: jackkrammer
  *      as of 4:54pm 20231207
+ *
+ *  	BAUD
+ *  		USART2 starts at USART_BAUD, USART_set_baud() changes it at run time
+ *  		up to USART_MAX_BAUD, the fastest the USART can go at 16x oversampling
+ *  		from the 32MHz clock, which is also the ST-LINK virtual COM port limit
+ *
+ *  	DMA
+ *  		DMA1 channel 7 sends the transmit ring, one transfer per contiguous
+ *  		part of the ring, the next part starts from the transfer complete
+ *  		interrupt
+ *  		DMA1 channel 6 receives into a circular buffer, the bytes are handed
+ *  		to the protocol at half transfer, transfer complete and when the line
+ *  		goes idle after a burst, so a frame of any length is handled as soon
+ *  		as its last byte arrives
+ *  		the error interrupt (EIE) counts the bytes the USART lost before
+ *  		DMA read them, and clears framing and noise errors
+ *  		the interrupts are counted in telemetry.h and timed in profile.h, which
+ *  		must be included first
  */
 
 #ifndef UART_H_
@@ -12,11 +30,57 @@
 
 //#define F_CLK 4000000 	// bus clock is 4 MHz
 #define F_CLK 32000000 // clock for ADC is 32MHz
+#define USART_BAUD 		115200 			// baud at boot, what a plain terminal expects
+#define USART_MAX_BAUD 	(F_CLK / 16) 	// 2Mbaud, BRR can't go below 16
+#define USART_MIN_BAUD 	1200
+
+// transmitted serial bytes, queued by the prints and sent by DMA
+// the prints never wait, bytes that don't fit in the ring are counted as dropped
+#define USART_TX_LEN 1024 // bytes the ring can hold, must be a power of 2
+
+typedef struct usart_tx_ring
+{
+	uint8_t 			buf[USART_TX_LEN];
+	volatile uint16_t 	head; 		// bytes queued, written by the main loop
+	volatile uint16_t 	tail; 		// bytes sent, written by the DMA interrupt
+	volatile uint16_t 	dma_len; 	// bytes in the running DMA transfer, 0 when idle
+	volatile uint32_t 	dropped; 	// bytes lost because the ring was full
+} usart_tx_ring;
+
+usart_tx_ring usart_tx = {0};
+
+// received serial bytes, written by DMA into a circular buffer
+#define USART_RX_DMA_LEN 256 // bytes in the DMA buffer, must be a power of 2
+
+typedef struct usart_rx_dma
+{
+	uint8_t 			buf[USART_RX_DMA_LEN];
+	uint16_t 			pos; 		// next byte to hand on
+	volatile uint32_t 	overruns; 	// bytes lost in the USART before DMA read them
+} usart_rx_dma;
+
+usart_rx_dma usart_rx = {0};
+uint32_t usart_baud = USART_BAUD; // current baud
+
+// received serial bytes outside of protocol frames, posted by the USART2 interrupt as EVENT_RX
+// (event_ring.h and frame_protocol.h must be included first)
+#define USART_RX_LEN 16 // bytes the ring can hold, must be a power of 2
+event 		usart_rx_queue[USART_RX_LEN]; 	// storage for the event ring
+event_ring 	usart_rx_events; 				// EVENT_RX events, value is the byte
 
 /* Private function prototypes -----------------------------------------------*/
-void USART_Print(const char* message);
-void USART_Escape_Code(const char* msg);
+uint16_t USART_Print(const char* message); // queues a string without waiting, returns the number of bytes dropped
+uint16_t USART_Write(const uint8_t* data, uint16_t len); // queues bytes without waiting, returns the number of bytes dropped
+uint16_t USART_Escape_Code(const char* msg); // queues ESC and the escape code, returns the number of bytes dropped
+uint16_t USART_Tx_Free(); // returns the number of bytes that fit in the transmit ring
+void USART_Wait_Room(uint16_t len); // waits until len bytes fit, for dumps that must not drop anything
+void USART_Flush(); // waits until every queued byte has left the shift register
 void USART_init();
+uint8_t USART_set_baud(uint32_t baud); // sends what is queued then changes the baud, returns 0 if the baud is out of range
+void USART_Tx_Start(); // starts a DMA transfer of the queued bytes up to the end of the ring, call with interrupts off
+void USART_Rx_Process(); // hands the bytes DMA received since the last call to the protocol or the main loop
+void DMA1_Channel6_IRQHandler(void); // receive buffer half or fully written
+void DMA1_Channel7_IRQHandler(void); // transmit transfer done, starts the next one
 
 
 void USART_init()
@@ -36,15 +100,36 @@ void USART_init()
 	RCC->APB1ENR1 |= RCC_APB1ENR1_USART2EN;	// enable USART by turning on system clock
 
 	USART2->CR1 &= ~(USART_CR1_M1 | USART_CR1_M0);	// set data to 8 bits
-	USART2->BRR = F_CLK / 115200;
+	USART2->BRR = F_CLK / usart_baud;
 	USART2->CR1 |= (USART_CR1_TE | USART_CR1_RE);		// enable transmit and receive for USART
+	USART2->CR3 |= (USART_CR3_DMAR | USART_CR3_DMAT); 	// receive and transmit through DMA
+
+	// DMA1 channel 6 = USART2_RX, channel 7 = USART2_TX, both request 2
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+	DMA1_CSELR->CSELR &= ~(DMA_CSELR_C6S | DMA_CSELR_C7S);
+	DMA1_CSELR->CSELR |= (2 << DMA_CSELR_C6S_Pos) | (2 << DMA_CSELR_C7S_Pos);
 
-	// enable interrupts for USART2 receive
-	USART2->CR1 |= USART_CR1_RXNEIE;			// enable RXNE interrupt on USART2
+	// receive, circular, interrupts at half and full so no byte waits long
+	DMA1_Channel6->CCR &= ~DMA_CCR_EN;
+	DMA1_Channel6->CPAR = (uint32_t)&USART2->RDR;
+	DMA1_Channel6->CMAR = (uint32_t)usart_rx.buf;
+	DMA1_Channel6->CNDTR = USART_RX_DMA_LEN;
+	DMA1_Channel6->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_PL_1;
+	DMA1_Channel6->CCR |= DMA_CCR_EN;
 
-	USART2->ISR &= ~(USART_ISR_RXNE);			// clear interrupt flag while (message[i] != 0)
+	// transmit, memory to peripheral, started by USART_Tx_Start
+	DMA1_Channel7->CCR &= ~DMA_CCR_EN;
+	DMA1_Channel7->CPAR = (uint32_t)&USART2->TDR;
+	DMA1_Channel7->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_PL_0;
+
+	// idle line interrupt ends a burst of received bytes
+	ring_init(&usart_rx_events, usart_rx_queue, USART_RX_LEN);
+	USART2->ICR = USART_ICR_IDLECF;
+	USART2->CR1 |= USART_CR1_IDLEIE;
+	USART2->CR3 |= USART_CR3_EIE; 	// with DMAR set an overrun only interrupts through EIE
 
 	NVIC->ISER[1] = (1 << (USART2_IRQn & 0x1F));		// enable USART2 ISR
+	NVIC->ISER[0] = (1 << (DMA1_Channel6_IRQn & 0x1F)) | (1 << (DMA1_Channel7_IRQn & 0x1F));
 
 	__enable_irq();
 
@@ -57,37 +142,173 @@ void USART_init()
 	USART_Escape_Code("[H");
 }
 
-// use a for loop to output one byte at a time to TDR
-void USART_Print(const char* message)
+// queues a string without waiting, returns the number of bytes dropped
+uint16_t USART_Print(const char* message)
+{
+	uint16_t len = 0;
+	while(message[len] != 0 && len < 0xFFFF) len++; // check for terminating NULL character
+	return USART_Write((const uint8_t*)message, len);
+}
+
+// queues bytes without waiting, returns the number of bytes dropped
+uint16_t USART_Write(const uint8_t* data, uint16_t len)
+{
+	uint16_t head = usart_tx.head;
+	uint16_t room = USART_Tx_Free();
+	uint16_t count = len < room ? len : room;
+
+	for(uint16_t i = 0; i < count; i++)
+	{
+		usart_tx.buf[(head + i) & (USART_TX_LEN - 1)] = data[i];
+	}
+
+	EVENT_RING_BARRIER(); // the bytes are written before they are published
+	usart_tx.head = head + count;
+	usart_tx.dropped += len - count;
+
+	// start DMA unless a transfer is running, its interrupt starts the next one
+	if(count)
+	{
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		if(!usart_tx.dma_len)
+		{
+			USART_Tx_Start();
+		}
+		__set_PRIMASK(primask);
+	}
+	return len - count;
+}
+
+// queues ESC and the escape code, returns the number of bytes dropped
+uint16_t USART_Escape_Code(const char* msg)
+{
+	const uint8_t esc = 0x1B;
+	return USART_Write(&esc, 1) + USART_Print(msg);
+}
+
+// returns the number of bytes that fit in the transmit ring
+uint16_t USART_Tx_Free()
+{
+	return USART_TX_LEN - (uint16_t)(usart_tx.head - usart_tx.tail);
+}
+
+// waits until len bytes fit, for dumps that must not drop anything
+void USART_Wait_Room(uint16_t len)
 {
-	uint8_t i;
-	for(i=0; message[i] != 0; i++){				// check for terminating NULL character
-		while(!(USART2->ISR & USART_ISR_TXE));	// wait for transmit buffer to be empty
-		USART2->TDR = message[i];				// transmit character to USART
+	if(len > USART_TX_LEN) len = USART_TX_LEN;
+	while(USART_Tx_Free() < len) PORT_WAIT();
+}
+
+// waits until every queued byte has left the shift register
+void USART_Flush()
+{
+	while(usart_tx.head != usart_tx.tail || usart_tx.dma_len) PORT_WAIT();
+	while(!(USART2->ISR & USART_ISR_TC)); // last byte done
+}
+
+// sends what is queued then changes the baud, returns 0 if the baud is out of range
+uint8_t USART_set_baud(uint32_t baud)
+{
+	if(baud < USART_MIN_BAUD || baud > USART_MAX_BAUD)
+	{
+		return 0;
+	}
+
+	USART_Flush();
+	USART2->CR1 &= ~USART_CR1_UE; // BRR can only be written while disabled
+	USART2->BRR = F_CLK / baud;
+	USART2->CR1 |= USART_CR1_UE;
+	usart_baud = baud;
+	return 1;
+}
+
+// starts a DMA transfer of the queued bytes up to the end of the ring, call with interrupts off
+void USART_Tx_Start()
+{
+	uint16_t tail = usart_tx.tail;
+	uint16_t at = tail & (USART_TX_LEN - 1);
+	uint16_t count = usart_tx.head - tail;
+
+	if(count == 0)
+	{
+		usart_tx.dma_len = 0;
+		return;
+	}
+	if(count > USART_TX_LEN - at)
+	{
+		count = USART_TX_LEN - at; // the rest after the wrap is the next transfer
 	}
+
+	usart_tx.dma_len = count;
+	DMA1_Channel7->CCR &= ~DMA_CCR_EN;
+	DMA1_Channel7->CMAR = (uint32_t)&usart_tx.buf[at];
+	DMA1_Channel7->CNDTR = count;
+	DMA1_Channel7->CCR |= DMA_CCR_EN;
+}
+
+// hands the bytes DMA received since the last call to the protocol or the main loop
+void USART_Rx_Process()
+{
+	uint16_t end = (USART_RX_DMA_LEN - DMA1_Channel6->CNDTR) & (USART_RX_DMA_LEN - 1);
+
+	while(usart_rx.pos != end)
+	{
+		// frame bytes go to the protocol, plain characters to the main loop
+		uint8_t byte = usart_rx.buf[usart_rx.pos];
+		if(!proto_rx_byte(byte))
+		{
+			ring_post(&usart_rx_events, EVENT_RX, byte, TIM5->CNT);
+		}
+		usart_rx.pos = (usart_rx.pos + 1) & (USART_RX_DMA_LEN - 1);
+	}
+}
+
+// receive buffer half or fully written
+void DMA1_Channel6_IRQHandler(void)
+{
+	PROFILE_BEGIN(PROFILE_DMA_RX);
+	telemetry.isr[TELEMETRY_ISR_DMA_RX]++;
+	DMA1->IFCR = DMA_IFCR_CHTIF6 | DMA_IFCR_CTCIF6 | DMA_IFCR_CGIF6;
+	USART_Rx_Process();
+	PROFILE_END(PROFILE_DMA_RX);
 }
 
-// add /ESC to TDR before the actual escape code
-void USART_Escape_Code(const char* msg)
+// transmit transfer done, starts the next one
+void DMA1_Channel7_IRQHandler(void)
 {
-	while(!(USART2->ISR & USART_ISR_TXE));	// wait for transmit buffer to be empty
-	USART2->TDR = 0x1B;
-	USART_Print(msg);
+	PROFILE_BEGIN(PROFILE_DMA_TX);
+	telemetry.isr[TELEMETRY_ISR_DMA_TX]++;
+	if(DMA1->ISR & DMA_ISR_TCIF7)
+	{
+		DMA1->IFCR = DMA_IFCR_CTCIF7 | DMA_IFCR_CGIF7;
+		usart_tx.tail += usart_tx.dma_len;
+		USART_Tx_Start();
+	}
+	PROFILE_END(PROFILE_DMA_TX);
 }
 
-// uses the corresponding color escape code or just prints out character
-// enter adds \n after the \r it defaults to
+// the line went idle after a burst, hands on what DMA has received so far, or a receive error
 void USART2_IRQHandler(void)
 {
-	if (USART2->ISR & USART_ISR_RXNE)
+	PROFILE_BEGIN(PROFILE_USART2);
+	telemetry.isr[TELEMETRY_ISR_USART2]++;
+	if (USART2->ISR & USART_ISR_ORE)
 	{
-//		// writes keyboard input to the serial display
-//		while(!(USART2->ISR & USART_ISR_TXE));
-//			USART2->TDR = USART2->RDR;
+		USART2->ICR = USART_ICR_ORECF; // a byte arrived before DMA read the last one
+		usart_rx.overruns++;
+	}
+	if (USART2->ISR & (USART_ISR_FE | USART_ISR_NE))
+	{
+		USART2->ICR = USART_ICR_FECF | USART_ICR_NECF; // the byte was still received, the frame crc catches it
+	}
 
-		// clears the flag
-		USART2->ISR &= ~(USART_ISR_RXNE);
+	if (USART2->ISR & USART_ISR_IDLE)
+	{
+		USART2->ICR = USART_ICR_IDLECF;
+		USART_Rx_Process();
 	}
+	PROFILE_END(PROFILE_USART2);
 }
 
 
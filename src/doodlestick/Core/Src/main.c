@@ -17,19 +17,38 @@
 
 // includes
 #include "main.h"
-#include <stdio.h>
+#include "event_ring.h"
+#include "format.h"
+#include "frame_protocol.h"
+#include "profile.h"
+#include "telemetry.h"
 #include "joystick.h"
+#include "joystick_cal.h"
+#include "frame_mirror.h"
+#include "ansi_canvas.h"
+#include "scheduler.h"
 #include "uart.h"
 #include "keypad_12.h"
 #include "rgb_matrix.h"
+#include "matrix_refresh.h"
 #include "timer2.h"
+#include "input_journal.h"
+#include "joystick_button.h"
+#include "power.h"
+#include "bench.h"
 
 // defines
-#define X_NEUTRAL 2050
-#define Y_NEUTRAL 1950
-#define THRESHOLD  900
-#define BLINK_THRESHOLD 5
-#define BUFF_SIZE 16
+#define BLINK_THRESHOLD 25 			// cursor ticks per blink, 0.5s
+#define CURSOR_TICK_HZ 	50 				// TIM2 rate, the cursor position is integrated at this rate
+#define CURSOR_VMIN 	4 				// speed just past the dead zone, pixels per tick with 8 fractional bits (0.8 px/s)
+#define CURSOR_VMAX 	154 			// speed at full deflection, pixels per tick with 8 fractional bits (30 px/s)
+#define CURSOR_GAIN_ONE 256 			// cursor_gain of 1.0
+#define BUFF_SIZE 16 			// at least FMT_INT_LEN
+#define TICK_QUEUE_LEN 	8 				// cursor ticks that can wait for the main loop, must be a power of 2
+#define INPUT_PERIOD_US 	1000 		// joystick and journal update, also runs on keypad and button events
+#define POWER_PERIOD_US 	100000 		// dims the matrix or stops the core after a while without input
+#define BENCH_CALLS 		16 			// calls timed per benchmark
+#define CHORD_US 			150000 		// time a pressed key waits for the other key of a chord
 
 // typedefs
 typedef enum KP_MODE {
@@ -43,6 +62,28 @@ typedef struct point{
 	int8_t x, y;
 } point;
 
+typedef enum SYMMETRY {
+		SYMMETRY_NONE 		= 0, // only the cursor position is drawn
+		SYMMETRY_HORIZONTAL = 1, // mirrored left to right around the center column
+		SYMMETRY_VERTICAL 	= 2, // mirrored top to bottom around the center row
+		SYMMETRY_QUAD 		= 3  // mirrored both ways, 4 pixels per step
+} SYMMETRY;
+
+typedef struct command
+{
+	uint8_t mode; 					// KP_MODE
+	uint8_t option; 				// option key, 1 to 8
+	void (*on_enter)(uint8_t option); // runs once each time the option is picked
+	void (*on_tick)(); 				// runs every cursor tick while the option is active, NULL if none
+} command;
+
+typedef struct bench_case
+{
+	const char* name; 				// name in the result line
+	void (*run)(); 					// one call of what is timed
+	uint8_t pins; 					// 1 if it drives the matrix pins, run with the refresh stopped
+} bench_case;
+
 
 // function declarations
 void TIM2_IRQHandler(void); // interrupt handler for TIM2
@@ -64,6 +105,72 @@ void draw_rect(point p1, point p2); // draws a rectangle with the two points as
 void draw_shape(point* shape, int size); // draws the given shape
 uint8_t same_point(point p1, point p2); // returns 1 if the points have the same coordinates and 0 if they don't
 uint8_t pt_inbounds(point pt); // returns 1 if the point is within the bounds of the matrix and 0 if not
+void set_stroke_pixel(point pt, color c); // sets the pixel and its mirrored copies in the buffer without updating the display
+uint8_t keypad_is_mode(uint8_t index); // returns 1 if the key at a keypad index is a mode key
+void run_key(uint8_t index); // runs a key on its own, a mode key switches the mode and an option key picks its option
+void run_chord(uint8_t mode_index, uint8_t option_index); // runs the chord of a mode key and an option key, the current mode and option stay
+void reset_session(); // puts the cursor, drawing tool and matrix back to their defaults so a journal starts from a known state
+void USART_print_journal(); // prints the recorded journal entries to USART as "time type value" lines
+void USART_print_joystick_stats(); // prints the joystick filter delay and the noise before and after the filter
+void USART_print_event_stats(); // prints the dropped events and the most events waiting of every event ring
+void USART_print_ring(const char* name, const event_ring* r); // prints the dropped events and high water mark of one ring
+int32_t cursor_velocity(int16_t deflection); // maps a deflection through the acceleration curve to a speed in pixels per tick (Q8)
+int32_t integrate_axis(int32_t pos, int32_t velocity, uint8_t size); // adds the velocity to the position and keeps it on the matrix (Q8)
+void proto_execute(const proto_frame* f); // runs a protocol command and sends its reply
+uint8_t proto_run(const proto_frame* f, uint8_t* reply, uint16_t* reply_len); // runs a protocol command, returns its PROTO_STATUS
+uint8_t proto_covers_cursor(const proto_frame* f); // returns 1 if the command writes the pixel under the cursor
+void proto_fill_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, color c); // fills a rectangle with two corners given, in the buffer only
+color proto_color(uint8_t bits); // returns the color of the 3 protocol color bits
+void mirror_send(); // sends the changed rows of the matrix buffer as a delta frame
+void ansi_send(); // draws the changed pixels of the matrix buffer in the serial terminal
+void telemetry_send(uint32_t now); // sends a telemetry record if it fits in the transmit ring
+void input_task(); // gathers the inputs for the journal, runs new key presses and button events
+void cursor_task(); // runs the cursor ticks posted by TIM2
+void serial_task(); // runs a serial character command and a protocol frame
+void power_task(); // dims the matrix after a while without input, then stops the core until an input
+void stream_task(); // hands the changed rows to the canvas streams and sends what the link has room for
+void telemetry_task(); // sends a telemetry record
+uint8_t input_has_work(); // returns 1 if a keypad or button event is waiting
+uint8_t cursor_has_work(); // returns 1 if a cursor tick is waiting
+uint8_t serial_has_work(); // returns 1 if a serial character or protocol frame is waiting
+uint8_t stream_has_work(); // returns 1 if a canvas stream has rows to send and the transmit ring is empty
+uint8_t telemetry_has_work(); // returns 1 if a telemetry record is due
+uint8_t power_wake(); // returns 1 if a key, the button or the joystick woke the core from Stop 2
+uint8_t joystick_moved(uint16_t x, uint16_t y); // returns 1 if the joystick is out of the dead zone
+void USART_print_tasks(); // prints the run time of every task and the idle time, then restarts the accounting
+void USART_print_power(); // prints the dims, stops and time in Stop 2
+void USART_print_profile(); // prints the cycles and histogram of every profiling zone, then clears them
+void USART_print_duty(uint32_t total, uint32_t idle); // prints the part of total that wasn't idle as a percentage with one decimal
+void select_mode(uint8_t mode); // switches to a mode with no option picked
+void select_option(uint8_t option); // picks an option in the current mode and runs its on_enter action
+const command* find_command(const command* table, uint8_t count, uint8_t mode, uint8_t option); // returns the table entry of a (mode, option) pair, NULL if there is none
+void cmd_color(uint8_t option); // COLOR mode, sets the stroke color
+void cmd_fill(uint8_t option); // FILL mode, fills the matrix with a color
+void cmd_cursor(uint8_t option); // DRAW 1, moves without drawing
+void cmd_trace(uint8_t option); // DRAW 2, draws where the cursor moves
+void cmd_shape(uint8_t option); // DRAW 3 to 5, moves without drawing until the shape points are clicked
+void cmd_symmetry(uint8_t option); // DRAW 6, traces mirrored and steps to the next symmetry
+void cmd_preset(uint8_t option); // DRAW 7, shows the hi or smiley preset
+void cmd_clear(uint8_t option); // DRAW 8, clears the matrix
+void cmd_speed(uint8_t option); // SPEED mode, sets the cursor speed scale
+void tick_line(); // DRAW 3, a click adds a line point
+void tick_square(); // DRAW 4, a click adds a square corner
+void tick_triangle(); // DRAW 5, a click adds a triangle vertex
+void run_benchmarks(); // times the drawing primitives and a refresh frame, prints them and the memory footprint, then puts the canvas back
+void bench_fill(); // fill_matrix() in a color
+void bench_clear(); // clear_matrix()
+void bench_rect(); // draw_rect() around the whole matrix
+void bench_logo(); // make_logo()
+void bench_hi(); // make_hi()
+void bench_smiley(); // make_smiley()
+void bench_shift_frame(); // matrix_shift_section() of every section, the refresh's work for one frame
+void bench_update_display(); // update_display() with the pins not owned by the refresh
+void bench_fmt_int(); // fmt_int() of the longest int32_t
+void bench_fmt_format(); // fmt_format() of a bench result line
+#if BENCH_SNPRINTF
+void bench_snprintf_int(); // snprintf() of the longest int32_t, as bench_fmt_int()
+void bench_snprintf_format(); // snprintf() of a bench result line, as bench_fmt_format()
+#endif /* BENCH_SNPRINTF */
 
 
 // colors
@@ -86,6 +193,7 @@ const color CYAN	= {.r = 0, .g = 1, .b = 1};
  *
  */
 color matrix_buffer[NUM_COLS][NUM_ROWS];
+uint16_t dirty_rows = 0; // bit per row of the matrix buffer changed since the canvas streams last took them
 
 
 
@@ -94,19 +202,157 @@ color matrix_buffer[NUM_COLS][NUM_ROWS];
 point 	cursor_pos 			= {.x = 0, .y = 0}; // cursor starts at top lef corner
 point 	prev_pos			= {.x = 0, .y = 0};		// holds the previous position of the cursor
 color 	prev_color			= RED;			// holds the previous color when blinking
+uint8_t cursor_lit			= 0;				// 1 while the blink shows over prev_color
 uint8_t cursor_thickness 	= 1;				// default cursor thickness is radius of 1
 color 	draw_color 			= RED;				// need to check whether the color is NONE or not before drawing anything
 uint8_t drawing				= 0; 				// 1 = trace mode, 0 = don't trace joystick movement
+uint8_t symmetry			= SYMMETRY_NONE;	// how the trace is mirrored around the center of the matrix
+int32_t cursor_x_q8			= 0x80;				// sub-pixel cursor position, 8 fractional bits, starts in the pixel center
+int32_t cursor_y_q8			= 0x80;
+uint16_t cursor_gain		= CURSOR_GAIN_ONE;	// SPEED mode scale of the cursor speed (Q8)
+
+// SPEED mode option 1 (slowest) to 8 (fastest), Q8 scale of the cursor speed
+const uint16_t speed_gains[8] = { 32, 64, 128, 192, 256, 384, 512, 768 };
+
+// colors picked by the option keys
+const color colors[8] = { 	RED,   	GREEN, 	BLUE,
+							YELLOW, CYAN, 	PURPLE,
+							WHITE, 	BLACK 	};
+
+// shape variables
+point line[2] 		= { {.x = -1, .y = -1}, {.x = -1, .y = -1} };
+point square[2] 	= { {.x = -1, .y = -1}, {.x = -1, .y = -1} };
+point triangle[3]	= { {.x = -1, .y = -1}, {.x = -1, .y = -1} , {.x = -1, .y = -1} };
+
+// keypad selection, the option is -1 until one is picked in the mode
+uint8_t 		kp_mode 		= DRAW;
+int8_t 			kp_select 		= -1;
+const command* 	active_command 	= NULL; // option being run, NULL if none
+
+// a new key waits for CHORD_US or its release before it runs alone, a key of the other kind pressed in that time makes a chord
+int8_t 			kp_pending 		= -1; // keypad index of the key waiting, -1 if none
+uint32_t 		kp_pending_at 	= 0; // TIM5 time of its press
+uint16_t 		kp_chord_keys 	= 0; // held keys that can still join a chord, the waiting key and the keys of chords made
+
+// every (mode, option) pair, picked only on key events
+const command commands[] = {
+	// mode 	option 	on_enter 		on_tick
+	{ COLOR, 	1, 		cmd_color, 		NULL },
+	{ COLOR, 	2, 		cmd_color, 		NULL },
+	{ COLOR, 	3, 		cmd_color, 		NULL },
+	{ COLOR, 	4, 		cmd_color, 		NULL },
+	{ COLOR, 	5, 		cmd_color, 		NULL },
+	{ COLOR, 	6, 		cmd_color, 		NULL },
+	{ COLOR, 	7, 		cmd_color, 		NULL },
+	{ COLOR, 	8, 		cmd_color, 		NULL },
+	{ FILL, 	1, 		cmd_fill, 		NULL },
+	{ FILL, 	2, 		cmd_fill, 		NULL },
+	{ FILL, 	3, 		cmd_fill, 		NULL },
+	{ FILL, 	4, 		cmd_fill, 		NULL },
+	{ FILL, 	5, 		cmd_fill, 		NULL },
+	{ FILL, 	6, 		cmd_fill, 		NULL },
+	{ FILL, 	7, 		cmd_fill, 		NULL },
+	{ FILL, 	8, 		cmd_fill, 		NULL },
+	{ DRAW, 	1, 		cmd_cursor, 	NULL },
+	{ DRAW, 	2, 		cmd_trace, 		NULL },
+	{ DRAW, 	3, 		cmd_shape, 		tick_line },
+	{ DRAW, 	4, 		cmd_shape, 		tick_square },
+	{ DRAW, 	5, 		cmd_shape, 		tick_triangle },
+	{ DRAW, 	6, 		cmd_symmetry, 	NULL },
+	{ DRAW, 	7, 		cmd_preset, 	NULL },
+	{ DRAW, 	8, 		cmd_clear, 		NULL },
+	{ SPEED, 	1, 		cmd_speed, 		NULL },
+	{ SPEED, 	2, 		cmd_speed, 		NULL },
+	{ SPEED, 	3, 		cmd_speed, 		NULL },
+	{ SPEED, 	4, 		cmd_speed, 		NULL },
+	{ SPEED, 	5, 		cmd_speed, 		NULL },
+	{ SPEED, 	6, 		cmd_speed, 		NULL },
+	{ SPEED, 	7, 		cmd_speed, 		NULL },
+	{ SPEED, 	8, 		cmd_speed, 		NULL }
+};
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+// mode key + option key held together, runs once without leaving the current mode and option
+const command chords[] = {
+	// mode 	option 	on_enter 		on_tick
+	{ COLOR, 	1, 		cmd_color, 		NULL }, // changes the stroke color while a tool stays active
+	{ COLOR, 	2, 		cmd_color, 		NULL },
+	{ COLOR, 	3, 		cmd_color, 		NULL },
+	{ COLOR, 	4, 		cmd_color, 		NULL },
+	{ COLOR, 	5, 		cmd_color, 		NULL },
+	{ COLOR, 	6, 		cmd_color, 		NULL },
+	{ COLOR, 	7, 		cmd_color, 		NULL },
+	{ COLOR, 	8, 		cmd_color, 		NULL },
+	{ FILL, 	1, 		cmd_fill, 		NULL }, // fills the background without leaving the tool
+	{ FILL, 	2, 		cmd_fill, 		NULL },
+	{ FILL, 	3, 		cmd_fill, 		NULL },
+	{ FILL, 	4, 		cmd_fill, 		NULL },
+	{ FILL, 	5, 		cmd_fill, 		NULL },
+	{ FILL, 	6, 		cmd_fill, 		NULL },
+	{ FILL, 	7, 		cmd_fill, 		NULL },
+	{ FILL, 	8, 		cmd_fill, 		NULL },
+	{ DRAW, 	7, 		cmd_preset, 	NULL },
+	{ DRAW, 	8, 		cmd_clear, 		NULL },
+	{ SPEED, 	1, 		cmd_speed, 		NULL }, // changes the cursor speed in the middle of a stroke
+	{ SPEED, 	2, 		cmd_speed, 		NULL },
+	{ SPEED, 	3, 		cmd_speed, 		NULL },
+	{ SPEED, 	4, 		cmd_speed, 		NULL },
+	{ SPEED, 	5, 		cmd_speed, 		NULL },
+	{ SPEED, 	6, 		cmd_speed, 		NULL },
+	{ SPEED, 	7, 		cmd_speed, 		NULL },
+	{ SPEED, 	8, 		cmd_speed, 		NULL }
+};
+#define NUM_CHORDS (sizeof(chords) / sizeof(chords[0]))
+
+// benchmarks of the 'b' command, in the order they run
+const bench_case bench_cases[] = {
+	// name 			run 					pins
+	{ "fill_matrix", 	bench_fill, 			0 },
+	{ "clear_matrix", 	bench_clear, 			0 },
+	{ "draw_rect", 		bench_rect, 			0 },
+	{ "make_logo", 		bench_logo, 			0 },
+	{ "make_hi", 		bench_hi, 				0 },
+	{ "make_smiley", 	bench_smiley, 			0 },
+	{ "fmt_int", 		bench_fmt_int, 			0 },
+	{ "fmt_format", 	bench_fmt_format, 		0 },
+#if BENCH_SNPRINTF
+	{ "snprintf_int", 	bench_snprintf_int, 	0 },
+	{ "snprintf_format", bench_snprintf_format, 0 },
+#endif /* BENCH_SNPRINTF */
+	{ "shift_frame", 	bench_shift_frame, 		1 },
+	{ "update_display", bench_update_display, 	1 }
+};
+#define NUM_BENCH_CASES (sizeof(bench_cases) / sizeof(bench_cases[0]))
 
 // more variables
-volatile uint16_t 	xcoord_data 		= X_NEUTRAL;
-volatile uint16_t 	ycoord_data 		= Y_NEUTRAL;
-volatile uint8_t 	xcoord_adc_flag 	= 1;
-volatile uint8_t 	ycoord_adc_flag 	= 1;
 //uint8_t enable_serial = 0; 		// if 1 then send updates over UART, essentially is debugging
-volatile uint8_t 	timer_flag 			= 1;
+event 			tick_queue[TICK_QUEUE_LEN]; 	// storage for the tick ring
+event_ring 		tick_events; 					// EVENT_TICK events, posted by TIM2
 		 uint8_t	button_flag		 	= 0;
 
+// baud asked for by PROTO_SET_BAUD, changed once the reply is sent, 0 if none
+uint32_t proto_new_baud = 0;
+
+// input journal variables
+uint16_t 		stick_x 	= JOYSTICK_DEFAULT_X_NEUTRAL; // newest filtered joystick sample, before axis_quantize()
+uint16_t 		stick_y 	= JOYSTICK_DEFAULT_Y_NEUTRAL;
+input_state 	inputs 		= {.xcoord = JOYSTICK_DEFAULT_X_NEUTRAL, .ycoord = JOYSTICK_DEFAULT_Y_NEUTRAL, .keys = 0, .button = 0}; // inputs used by this loop
+input_journal 	journal;	// recorded inputs, starts in live mode
+uint32_t 		replay_frames 	= 0; // number of input updates run during a replay
+
+// main loop tasks in priority order
+task tasks[] = {
+	// name 		run 			has_work 			period_us
+	{ "input", 		input_task, 	input_has_work, 	INPUT_PERIOD_US },
+	{ "cursor", 	cursor_task, 	cursor_has_work, 	0 },
+	{ "serial", 	serial_task, 	serial_has_work, 	0 },
+	{ "stream", 	stream_task, 	stream_has_work, 	0 },
+	{ "telemetry", 	telemetry_task, telemetry_has_work, 0 },
+	{ "power", 		power_task, 	NULL, 				POWER_PERIOD_US }
+};
+#define NUM_TASKS (sizeof(tasks) / sizeof(tasks[0]))
+scheduler sched;
+
 int main()
 {
 	/* Reset of all peripherals, Initializes the Flash interface and the Systick. */
@@ -114,12 +360,15 @@ int main()
 
 	// initialize the joystick
 	SystemClock_Config(); 	// sets system clock to 32MHz
-	xcoord_adc_init();		// initializes the ADC for the joystick x data
-	ycoord_adc_init();		// initializes the ADC for the joystick y data
-	joystick_button_init();	// initializes the button on the joystick
+	PROFILE_INIT(); 		// DWT cycle counter for the profiling zones
+	journal_timer_init(); 	// TIM5 1us timestamps for the journal and every event
+	joystick_adc_init(JOYSTICK_SAMPLE_HZ); // samples the joystick x and y data into DMA on a timer
+	joystick_cal_init();	// measures the neutral point, the stick must be at rest during boot
+	button_events_init();	// button on the joystick, classified into click events from EXTI4 and TIM16
 
 	// initializes the keypad
 	keypad_init();
+	keypad_scan_init(KEYPAD_SCAN_HZ, KEYPAD_DEBOUNCE_MS); // scans and debounces the keypad from TIM7
 
 	// initializes the matrix
 	matrix_init();			// initializes the matrix pins
@@ -127,6 +376,7 @@ int main()
 
 	// sets the initial display
 	make_smiley(CYAN); // make_hi(PURPLE);
+	matrix_refresh_init(matrix_buffer, MATRIX_FRAME_HZ); // TIM3 shows the buffer from here on
 
 	// initializes the USART serial output
 	USART_init();
@@ -136,218 +386,370 @@ int main()
 	USART_Print("	by Jack and Srini\n\n\r");
 
 	// initialize the speed timer
-	TIM2_init(320000, 9, 0xFFFFFFFF); // initializes timer with values (arr, psc, ccr1)
+	ring_init(&tick_events, tick_queue, TICK_QUEUE_LEN);
+	TIM2_init((1000000 / CURSOR_TICK_HZ) - 1, 31, 0xFFFFFFFF); // 1MHz count, constant cursor tick (arr, psc, ccr1)
 
-	// variables
-	KP_MODE kp_mode = DRAW;
-	int8_t kp_select = 2;
-	int8_t kp_ret = -1;
-	uint8_t button_ret = 0;
-	color colors[8] = { RED,   	GREEN, 	BLUE,
-						YELLOW, CYAN, 	PURPLE,
-						WHITE, 	BLACK 	};
-
-	// shape variables
-	point line[2] 		= { {.x = -1, .y = -1}, {.x = -1, .y = -1} };
-	point square[2] 	= { {.x = -1, .y = -1}, {.x = -1, .y = -1} };
-	point triangle[3]	= { {.x = -1, .y = -1}, {.x = -1, .y = -1} , {.x = -1, .y = -1} };
+	// starts in trace
+	select_mode(DRAW);
+	select_option(2);
 
+	// run the tasks from here on, the core sleeps when none is runnable
+	power_init(TIM5->CNT);
+	sched_init(&sched, tasks, NUM_TASKS);
 	while(1)
 	{
-		// update joystick values, this could be more efficient if does this via a timer
-		// update x coordinate joystick value
-		if(xcoord_adc_flag)
-		{
-			// reset flag
-			xcoord_adc_flag = 0;
+		telemetry.loops++;
+		sched_run_once(&sched);
+	}
 
-			// start another conversion
-			xcoord_start_conversion();
-		}
-		// update y coordinate joystick value
-		if(ycoord_adc_flag)
-		{
-			// reset flag
-			ycoord_adc_flag = 0;
 
-			// start another conversion
-			ycoord_start_conversion();
+	return 0;
+}
+
+
+
+
+/* ------------------- INTERRUPT FUNCTIONS ------------------- */
+
+// interrupt handler for TIM2
+void TIM2_IRQHandler(void)
+{
+	// if from TIM2 update event
+	PROFILE_BEGIN(PROFILE_TIM2);
+	if(TIM2->SR & TIM_SR_UIF) // from ARR
+	{
+		TIM2->SR &= ~TIM_SR_UIF; 	// reset interrupt flag
+		telemetry.isr[TELEMETRY_ISR_TIM2]++;
+		ring_post(&tick_events, EVENT_TICK, 0, TIM5->CNT); // one cursor tick for the main loop
+	}
+	PROFILE_END(PROFILE_TIM2);
+}
+
+
+/* --------------------- TASK FUNCTIONS --------------------- */
+
+// gathers the inputs for the journal, runs new key presses and button events
+void input_task()
+{
+	static uint16_t kp_last = 0; // keys held in the previous update, to catch new presses
+	int8_t kp_other = -1; // held key of the other kind that a new press makes a chord with
+	event kp_event;
+	event bt_event;
+
+	// gather the inputs, the journal records them or replaces them
+	joystick_read(&stick_x, &stick_y); // newest sample from the DMA buffer
+	inputs.xcoord = axis_quantize(&joystick_cal.x, stick_x, inputs.xcoord); // only real moves become journal entries
+	inputs.ycoord = axis_quantize(&joystick_cal.y, stick_y, inputs.ycoord);
+	if(keypad_get_event(&kp_event)) // one keypad event per update so the journal sees each one
+	{
+		if(kp_event.type == EVENT_KEY_PRESS) inputs.keys |= (1 << kp_event.value);
+		else inputs.keys &= ~(1 << kp_event.value);
+	}
+	inputs.button = button_get_event(&bt_event) ? bt_event.value : BUTTON_NONE; // one button event per update
+	journal_update(&journal, &inputs);
+
+	// anything that draws keeps the matrix bright
+	if(inputs.keys || inputs.button || journal.mode == JOURNAL_REPLAY || joystick_moved(inputs.xcoord, inputs.ycoord))
+	{
+		power_activity(TIM5->CNT);
+	}
+
+	// report the cost of the replayed workload once it is done
+	if(journal.mode == JOURNAL_REPLAY)
+	{
+		replay_frames++;
+		if(journal_replay_done(&journal))
+		{
+			uint32_t elapsed = journal_now() - journal.start;
+			journal_stop(&journal);
+			USART_Print("replay done, frames = ");
+			USART_print_int(replay_frames);
+			USART_Print("	us = ");
+			USART_print_int(elapsed);
+			USART_Print("	us/frame = ");
+			USART_print_int(elapsed / replay_frames);
+			USART_Print("\n\r");
 		}
+	}
+
+	// the waiting key runs alone once it is released or the chord window is over
+	kp_chord_keys &= inputs.keys;
+	if(kp_pending >= 0 && (!(inputs.keys & (1 << kp_pending)) || TIM5->CNT - kp_pending_at >= CHORD_US))
+	{
+		kp_chord_keys &= ~(1 << kp_pending);
+		run_key(kp_pending);
+		kp_pending = -1;
+	}
 
-		// poll keypad, store as value
-		kp_ret = loop_keypad_once(); // gets index of keypad
-		if(kp_ret >= 0) // valid command
+	// only a new press is a command, holding a key doesn't repeat it
+	for(uint8_t kp_index = 0; kp_index < NUM_KEYS; kp_index++)
+	{
+		if(!(inputs.keys & ~kp_last & (1 << kp_index))) // not a new press
 		{
-			// get the value on the button instead of the index
-			kp_ret = keypad_vals[kp_ret];
+			continue;
+		}
 
-			// check if keypad press was a MODE configuration
-			if(kp_ret > 8 || kp_ret == 0)
-			{
-				switch(kp_ret)
-				{
-				case 0xA: 	// * = COLOR SELECT MODE
-					kp_mode = COLOR;
-					kp_select = -1; // default is no selection
-					break;
-				case 0x0: 	// 0 = FILL SELECT MODE
-					kp_mode = FILL;
-					kp_select = -1; // default is no selection
-					break;
-				case 0xB: 	// # = DRAW SELECT MODE
-					kp_mode = DRAW;
-					reset_shapes(line, square, triangle);
-					kp_select = -1; // default is no selection
-					break;
-				case 0x9: 	// 9 = SPEED SELECT MODE
-					kp_mode = SPEED;
-					kp_select = -1; // default is no selection
-					break;
-				default: 	// else error, don't change anything
-					break;
-				}
-			}
-			else // keypad press changes the kp_select option
+		// a mode key with a waiting or chorded option key, or the other way around
+		kp_other = -1;
+		for(uint8_t i = 0; i < NUM_KEYS; i++)
+		{
+			if((kp_chord_keys & (1 << i)) && keypad_is_mode(i) != keypad_is_mode(kp_index))
 			{
-				kp_select = kp_ret;
+				kp_other = i;
+				break;
 			}
 		}
 
-		// execute command chosen
-		switch(kp_mode)
+		if(kp_other >= 0)
+		{
+			if(kp_pending == kp_other) kp_pending = -1; // part of the chord, it won't run alone
+			if(keypad_is_mode(kp_index)) run_chord(kp_index, kp_other);
+			else run_chord(kp_other, kp_index);
+			kp_chord_keys |= 1 << kp_index; // held, it can make another chord with the next key
+		}
+		else
 		{
-		case COLOR:		// COLOR mode 	= changes color of draw tool
-			if(kp_select >= 0 && kp_select < 9)
+			// a second key of the same kind, the first one runs alone now
+			if(kp_pending >= 0)
 			{
-				draw_color = colors[kp_select - 1];
+				kp_chord_keys &= ~(1 << kp_pending);
+				run_key(kp_pending);
 			}
-			break;
+			kp_pending = kp_index;
+			kp_pending_at = TIM5->CNT;
+			kp_chord_keys |= 1 << kp_index;
+		}
+	}
+	kp_last = inputs.keys;
 
-		case FILL:		// FILL mode  	= allows a decision on what color to fill the board with
-			if(kp_select >= 0 && kp_select < 9)
+	// joystick button events
+	switch(inputs.button)
+	{
+	case BUTTON_CLICK: 			// adds a point to the shape being drawn on the next tick
+		button_flag = 1;
+		break;
+	case BUTTON_DOUBLE_CLICK: 	// in DRAW mode lifts or puts down the pen, cursor <-> trace
+		if(kp_mode == DRAW && (kp_select == 1 || kp_select == 2))
+		{
+			select_option((kp_select == 1) ? 2 : 1);
+		}
+		break;
+	case BUTTON_LONG_PRESS: 	// cancels the shape being drawn
+		reset_shapes(line, square, triangle);
+		button_flag = 0;
+		break;
+	default: // no event
+		break;
+	}
+}
+
+// runs the cursor ticks posted by TIM2
+void cursor_task()
+{
+	event tick_event;
+
+	// once per tick so a late task still moves the full distance
+	while(ring_get(&tick_events, &tick_event))
+	{
+		// follows drift while the stick is idle, not the recorded stick of a replay, which would also write the flash
+		if(journal.mode != JOURNAL_REPLAY)
+		{
+			joystick_cal_track(stick_x, stick_y); // the samples, the quantized stick would hide the drift
+		}
+		if(active_command && active_command->on_tick)
+		{
+			active_command->on_tick();
+		}
+		move_cursor();
+	}
+}
+
+// runs a serial character command and a protocol frame
+void serial_task()
+{
+	event rx_event;
+
+	// serial commands control the input journal
+	if(ring_get(&usart_rx_events, &rx_event))
+	{
+		power_activity(TIM5->CNT);
+		switch(rx_event.value)
+		{
+		case 'r': 	// record from a known state
+		case 'p': 	// replay from the same known state
+			reset_session();
+			select_mode(DRAW);
+			select_option(2);
+			if(rx_event.value == 'r')
 			{
-				fill_matrix(colors[kp_select - 1]);
+				journal_record_start(&journal, &inputs);
+				USART_Print("recording\n\r");
 			}
-			kp_select = -1;
-			break;
-
-		case DRAW:		// DRAW mode  	= changes type of draw tool
-			switch(kp_select)
+			else
 			{
-			case 1:	// free 	= don't change matrix
-				drawing = 0;
-				break;
-			case 2: // trace 	= draw where moving
-				drawing = 1;
-				break;
-			case 3: // line		= can click twice and draw a line between the two spots clicked
-				drawing = 0;
-				if(button_flag)
-				{
-					add_pt_to_shape(line, 2);
-					// reset button flag
-					button_flag = 0;
-				}
-				break;
-			case 4: // square	= can click twice and draw a square with two spots clicked as opposite corners
-				drawing = 0;
-				if(button_flag)
-				{
-					add_pt_to_shape(line, 4);
-					// reset button flag
-					button_flag = 0;
-				}
-				break;
-			case 5: // triangle = can click three times and draw triangle with 3 spots clicked as vertices
-				drawing = 0;
-				if(button_flag)
-				{
-					add_pt_to_shape(line, 3);
-					// reset button flag
-					button_flag = 0;
-				}
-				break;
-			case 6: // thick 	= cursor now 1 dot // now is going to be the cyan w smiley relief
-				make_smiley(CYAN); // turn into logo
-				break;
-			case 7: // thiick	= cursor now 2 dots radius thickness // now is purple hi or cyan smiley
-				if(xcoord_data % 2) make_hi(PURPLE);
-				else make_smiley(CYAN);
-				kp_select = -1;
-				break;
-			case 8: // thiiick	= cursor now 3 dots radius thickness // now is going to be a continous fill of blank
-				fill_matrix(colors[kp_select - 1]);
-				break;
-			default:	// error in option selected, do nothing
-				break;
+				replay_frames = 0;
+				journal_replay_start(&journal, &inputs);
+				USART_Print("replaying\n\r");
 			}
 			break;
-
-		case SPEED:		// SPEED mode 	= changes speed of cursor movement
-			TIM2->PSC = kp_select + 1; // larger number = slower speed
+		case 'm': 	// stream the canvas as delta frames
+			ansi_stop(); // one canvas stream on the port at a time
+			mirror_start();
 			break;
-
-		default:		// invalid mode, do nothing
+		case 'M': 	// stop streaming the canvas
+			mirror_stop();
+			break;
+		case 'a': 	// draw the canvas in the terminal, again to redraw it
+			mirror_stop();
+			ansi_start();
+			break;
+		case 'A': 	// stop drawing the canvas in the terminal
+			ansi_stop();
+			break;
+		case 't': 	// send telemetry records
+			telemetry_start(TIM5->CNT);
+			break;
+		case 'T': 	// stop the telemetry records
+			telemetry_stop();
+			break;
+		case 'l': 	// back to live inputs
+			journal_stop(&journal);
+			USART_Print("live\n\r");
+			break;
+		case 'd': 	// dump the recording
+			USART_print_journal();
+			break;
+		case 'b': 	// benchmark the drawing primitives, the canvas is reset after
+			run_benchmarks();
+			break;
+		case 'z': 	// profiling zones since the last 'z'
+			USART_print_profile();
+			break;
+		case 's': 	// joystick filter statistics since the last 's', then the event rings and the tasks
+			USART_print_joystick_stats();
+			joystick_stats_reset();
+			USART_print_event_stats();
+			USART_print_power();
+			USART_print_tasks();
+			break;
+		default:
 			break;
 		}
+	}
 
-		// move cursor
-		if(timer_flag)
-		{
-			move_cursor();
-			timer_flag = 0;
-
-//			// print status
-//			char buff[BUFF_SIZE];
-//			USART_Print("    mode = ");
-//			USART_print_int(kp_mode);
-//			USART_Print("	 select = ");
-//			USART_print_int(kp_select);
-//			USART_Print("\n\r");
-		}
+	// binary protocol commands, decoded by the USART2 interrupt
+	proto_frame* frame = proto_peek();
+	if(frame)
+	{
+		power_activity(TIM5->CNT);
+		proto_execute(frame);
+		proto_release();
+	}
+}
 
-		// update the display
-		update_display();
+// hands the changed rows to the canvas streams and sends what the link has room for
+void stream_task()
+{
+	mirror.pending |= dirty_rows;
+	ansi_term.pending |= dirty_rows;
+	dirty_rows = 0;
+
+	// each waits for the last update to leave, so the rate follows the link
+	if(ansi_term.on && ansi_term.pending)
+	{
+		ansi_send();
 	}
+	if(mirror.on && mirror.pending)
+	{
+		mirror_send();
+	}
+}
+
+// sends a telemetry record
+void telemetry_task()
+{
+	telemetry_send(TIM5->CNT);
+}
 
+// dims the matrix after a while without input, then stops the core until an input
+void power_task()
+{
+	// the host is watching a stream or driving a journal, stay awake for it
+	if(mirror.on || ansi_term.on || telemetry.on || journal.mode != JOURNAL_LIVE)
+	{
+		power_activity(TIM5->CNT);
+	}
 
-	return 0;
+	switch(power_update(TIM5->CNT))
+	{
+	case POWER_ACTIVE:
+		matrix_set_brightness(100);
+		break;
+	case POWER_DIM:
+		matrix_set_brightness(POWER_DIM_PERCENT);
+		break;
+	case POWER_STOP:
+		USART_Flush(); 			// the DMA stops with the clocks
+		matrix_refresh_stop(); 	// a lit section would stay lit
+		power_stop(power_wake);
+		matrix_set_brightness(100);
+		matrix_refresh_start();
+		break;
+	default:
+		break;
+	}
 }
 
+// returns 1 if a keypad or button event is waiting
+uint8_t input_has_work()
+{
+	return ring_count(&keypad_scan.events) || ring_count(&button.events);
+}
 
+// returns 1 if a cursor tick is waiting
+uint8_t cursor_has_work()
+{
+	return ring_count(&tick_events) > 0;
+}
 
+// returns 1 if a serial character or protocol frame is waiting
+uint8_t serial_has_work()
+{
+	return ring_count(&usart_rx_events) || proto_peek();
+}
 
-/* ------------------- INTERRUPT FUNCTIONS ------------------- */
+// returns 1 if a canvas stream has rows to send and the transmit ring is empty
+uint8_t stream_has_work()
+{
+	uint8_t rows = dirty_rows || (mirror.on && mirror.pending) || (ansi_term.on && ansi_term.pending);
+	return (mirror.on || ansi_term.on) && rows && usart_tx.head == usart_tx.tail;
+}
 
-// interrupt handler for TIM2
-void TIM2_IRQHandler(void)
+// returns 1 if a telemetry record is due
+uint8_t telemetry_has_work()
 {
-	// if from TIM2 update event
-	if(TIM2->SR & TIM_SR_UIF) // from ARR
-	{
-		TIM2->SR &= ~TIM_SR_UIF; 	// reset interrupt flag
-		timer_flag = 1;				// set global timer flag
-	}
+	return telemetry_due(TIM5->CNT);
 }
 
-// clear flag and set globals
-void ADC1_2_IRQHandler()
+// returns 1 if a key, the button or the joystick woke the core from Stop 2
+uint8_t power_wake()
 {
-	// Vref for X is the input to ADC1
-	if (ADC1->ISR & ADC_ISR_EOC)
-	{
-		xcoord_data = ADC1->DR;
-		xcoord_adc_flag = 1;
-	}
+	uint16_t x, y;
 
-	// Vref for Y is the input to ADC2
-	if(ADC2->ISR & ADC_ISR_EOC)
+	// a row or button edge starts the keypad scan or the button tick
+	if(!keypad_scan.idle || (TIM16->CR1 & TIM_CR1_CEN))
 	{
-		ycoord_data = ADC2->DR;
-		ycoord_adc_flag = 1;
+		return 1;
 	}
+	joystick_read(&x, &y);
+	return joystick_moved(x, y);
 }
 
+// returns 1 if the joystick is out of the dead zone
+uint8_t joystick_moved(uint16_t x, uint16_t y)
+{
+	return axis_deflection(&joystick_cal.x, x) || axis_deflection(&joystick_cal.y, y);
+}
 
 /* -------------------- SERIAL FUNCTIONS -------------------- */
 
@@ -358,82 +760,476 @@ void USART_print_int(int num)
 	int_to_str(num, buff);
 	USART_Print(buff);
 }
+// prints the recorded journal entries to USART as "time type value" lines
+void USART_print_journal()
+{
+	USART_Print("journal ");
+	USART_print_int(journal.count);
+	if(journal.overflow) USART_Print(" overflow");
+	USART_Print("\n\r");
+
+	for(uint16_t i = 0; i < journal.count; i++)
+	{
+		USART_Wait_Room(3 * BUFF_SIZE); // the dump is asked for, so wait instead of dropping lines
+		USART_print_int(journal.entries[i].time);
+		USART_Print(" ");
+		USART_print_int(journal.entries[i].type);
+		USART_Print(" ");
+		USART_print_int(journal.entries[i].value);
+		USART_Print("\n\r");
+	}
+}
+
+// prints the joystick filter delay and the noise before and after the filter
+void USART_print_joystick_stats()
+{
+	joystick_noise* axis[2] = {&joystick_stats.x, &joystick_stats.y};
+
+	USART_Print("filter latency us = ");
+	USART_print_int(joystick_latency_us());
+	USART_Print("	buffer laps = ");
+	USART_print_int(joystick_iir.laps);
+	USART_Print("\n\r");
+
+	// average change per sample in 1/16 lsb
+	for(uint8_t i = 0; i < 2; i++)
+	{
+		USART_Print(i ? "y" : "x");
+		USART_Print(" noise raw = ");
+		USART_print_int(axis[i]->count ? axis[i]->raw_delta / axis[i]->count : 0);
+		USART_Print("	filtered = ");
+		USART_print_int(axis[i]->count ? axis[i]->filt_delta / axis[i]->count : 0);
+		USART_Print("	(1/16 lsb per sample, ");
+		USART_print_int(axis[i]->count);
+		USART_Print(" samples)\n\r");
+	}
+}
+
+// prints the dropped events and the most events waiting of every event ring
+void USART_print_event_stats()
+{
+	USART_print_ring("tick", &tick_events);
+	USART_print_ring("keypad", &keypad_scan.events);
+	USART_print_ring("button", &button.events);
+	USART_print_ring("serial", &usart_rx_events);
+	USART_Print("serial baud = ");
+	USART_print_int(usart_baud);
+	USART_Print("	bytes dropped = ");
+	USART_print_int(usart_tx.dropped);
+	USART_Print("	receive overruns = ");
+	USART_print_int(usart_rx.overruns);
+	USART_Print("\n\r");
+	USART_Print("protocol frames = ");
+	USART_print_int(proto.frames);
+	USART_Print("	errors = ");
+	USART_print_int(proto.errors);
+	USART_Print("	dropped = ");
+	USART_print_int(proto.dropped);
+	USART_Print("\n\r");
+	USART_Print("mirror frames = ");
+	USART_print_int(mirror.frames);
+	USART_Print("	bytes = ");
+	USART_print_int(mirror.bytes);
+	USART_Print("\n\r");
+	USART_Print("terminal updates = ");
+	USART_print_int(ansi_term.updates);
+	USART_Print("	bytes = ");
+	USART_print_int(ansi_term.bytes);
+	USART_Print("	full redraws = ");
+	USART_print_int(ansi_term.full_bytes);
+	USART_Print("\n\r");
+	USART_Print("telemetry records = ");
+	USART_print_int(telemetry.records);
+	USART_Print("	skipped = ");
+	USART_print_int(telemetry.skipped);
+	USART_Print("\n\r");
+}
+
+// prints the run time of every task and the idle time, then restarts the accounting
+void USART_print_tasks()
+{
+	for(uint8_t i = 0; i < NUM_TASKS; i++)
+	{
+		task* t = &tasks[i];
+		USART_Print(t->name);
+		USART_Print(" runs = ");
+		USART_print_int(t->runs);
+		USART_Print("	busy us = ");
+		USART_print_int(t->busy_us);
+		USART_Print("	max us = ");
+		USART_print_int(t->max_us);
+		USART_Print("	late us = ");
+		USART_print_int(t->late_us);
+		USART_Print("	overruns = ");
+		USART_print_int(t->overruns);
+		USART_Print("\n\r");
+	}
+	USART_Print("idle us = ");
+	USART_print_int(sched.idle_us);
+	USART_Print(" of ");
+	USART_print_int(TIM5->CNT - sched.since);
+	USART_Print("	sleeps = ");
+	USART_print_int(sched.sleeps);
+	USART_Print("	busy % = ");
+	USART_print_duty(TIM5->CNT - sched.since, sched.idle_us);
+	USART_Print("\n\r");
+	sched_reset_stats(&sched);
+}
+
+// prints the cycles and histogram of every profiling zone, then clears them
+void USART_print_profile()
+{
+#if PROFILE_ENABLED
+	char line[PROFILE_LINE_LEN];
+	profile_zone z;
+
+	// bucket b counts the passes under 2^b cycles, the last one the rest
+	USART_Wait_Room(PROFILE_LINE_LEN);
+	USART_Print("zone,name,count,min_cycles,mean_cycles,max_cycles");
+	for(uint8_t b = 0; b < PROFILE_BUCKETS; b++)
+	{
+		fmt_format(line, sizeof(line), (b < PROFILE_BUCKETS - 1) ? ",lt%u" : ",ge%u",
+				(b < PROFILE_BUCKETS - 1) ? (1u << b) : (1u << (b - 1)));
+		USART_Wait_Room(PROFILE_LINE_LEN);
+		USART_Print(line);
+	}
+	USART_Print("\n\r");
+
+	for(uint8_t i = 0; i < PROFILE_NUM_ZONES; i++)
+	{
+		profile_take(i, &z);
+		fmt_format(line, sizeof(line), "zone,%s,%u,%u,%u,%u", profile_names[i], z.count, z.min,
+				z.count ? (uint32_t)(z.total / z.count) : 0, z.max);
+		USART_Wait_Room(PROFILE_LINE_LEN); // asked for, so wait instead of dropping lines
+		USART_Print(line);
+		for(uint8_t b = 0; b < PROFILE_BUCKETS; b++)
+		{
+			fmt_format(line, sizeof(line), ",%u", z.buckets[b]);
+			USART_Wait_Room(PROFILE_LINE_LEN);
+			USART_Print(line);
+		}
+		USART_Print("\n\r");
+	}
+#else
+	USART_Print("profiling is compiled out (PROFILE_ENABLED 0)\n\r");
+#endif /* PROFILE_ENABLED */
+}
+
+// prints the dims, stops and time in Stop 2
+void USART_print_power()
+{
+	USART_Print("power dims = ");
+	USART_print_int(power.dims);
+	USART_Print("	stops = ");
+	USART_print_int(power.stops);
+	USART_Print("	polls = ");
+	USART_print_int(power.polls);
+	USART_Print("	stop ms = ");
+	USART_print_int(power.stop_ms);
+	USART_Print("	matrix frames = ");
+	USART_print_int(refresh.frames);
+	USART_Print("\n\r");
+}
+
+// prints the part of total that wasn't idle as a percentage with one decimal
+void USART_print_duty(uint32_t total, uint32_t idle)
+{
+	char buff[BUFF_SIZE];
+	uint32_t q8 = total ? (uint32_t)((uint64_t)(total - idle) * (100 << 8) / total) : 0;
+	fmt_fixed(buff, BUFF_SIZE, q8, 8, 1);
+	USART_Print(buff);
+}
+
+// prints the dropped events and high water mark of one ring
+void USART_print_ring(const char* name, const event_ring* r)
+{
+	USART_Print(name);
+	USART_Print(" events dropped = ");
+	USART_print_int(r->dropped);
+	USART_Print("	most waiting = ");
+	USART_print_int(r->high_water);
+	USART_Print(" of ");
+	USART_print_int(r->mask + 1);
+	USART_Print("\n\r");
+}
+
 // converts and int and returns a string of length BUFF_SIZE
 void int_to_str(int num, char* buff)
 {
-	snprintf(buff, /*sizeof(buff)*/BUFF_SIZE, "%d", num);
+	fmt_int(buff, BUFF_SIZE, num, 0, ' '); // snprintf() would link newlib's printf and heap for this
 }
 
-/* ------------------ JOYSTICK FUNCTIONS ------------------ */
+/* -------------------- PROTOCOL FUNCTIONS -------------------- */
 
-// moves the cursor in the direction indicated by the joystick
-void move_cursor()
+// runs a protocol command and sends its reply
+void proto_execute(const proto_frame* f)
 {
-	// update the previous cursor position
-	prev_pos = cursor_pos;
+	static uint8_t reply[PROTO_FRAME_BYTES];
+	static uint8_t encoded[PROTO_MAX_ENCODED];
+	uint16_t reply_len = 0;
+
+	uint8_t status = proto_run(f, reply, &reply_len);
+
+	// the cursor puts back what it covers, so a new pixel under it is what it covers now,
+	// and the blink starts over so it doesn't overwrite it
+	if(status == PROTO_OK && proto_covers_cursor(f))
+	{
+		prev_color = matrix_buffer[cursor_pos.x][cursor_pos.y];
+		cursor_lit = 0;
+	}
+	uint16_t len = proto_reply(f->data[0], f->data[1], status, reply, reply_len, encoded);
 
-	// check x+ (right) direction
-	if(xcoord_data > X_NEUTRAL + THRESHOLD) // joystick wants to move right
+	// a reply is sent whole or not at all, the host is waiting for it
+	USART_Wait_Room(len);
+	USART_Write(encoded, len);
+
+	// the host switches after it has the reply
+	if(proto_new_baud)
 	{
-		if(cursor_pos.x < NUM_COLS - 1) 	// room to move right
+		USART_set_baud(proto_new_baud);
+		proto_new_baud = 0;
+	}
+}
+
+// runs a protocol command, returns its PROTO_STATUS
+uint8_t proto_run(const proto_frame* f, uint8_t* reply, uint16_t* reply_len)
+{
+	const uint8_t* arg = &f->data[2];
+	uint16_t arg_len = f->len - 2;
+
+	switch(f->data[0])
+	{
+	case PROTO_SET_PIXEL: 		// x, y, color
+		if(arg_len != 3) return PROTO_BAD_LENGTH;
+		if(arg[0] >= NUM_COLS || arg[1] >= NUM_ROWS || arg[2] > 7) return PROTO_BAD_ARGUMENT;
+		set_pixel(arg[0], arg[1], proto_color(arg[2]));
+		return PROTO_OK;
+
+	case PROTO_SET_RECT: 		// x0, y0, x1, y1, color
+		if(arg_len != 5) return PROTO_BAD_LENGTH;
+		if(arg[0] >= NUM_COLS || arg[1] >= NUM_ROWS || arg[2] >= NUM_COLS || arg[3] >= NUM_ROWS || arg[4] > 7) return PROTO_BAD_ARGUMENT;
+		proto_fill_rect(arg[0], arg[1], arg[2], arg[3], proto_color(arg[4]));
+		return PROTO_OK;
+
+	case PROTO_UPLOAD_FRAME: 	// every pixel, packed
+		if(arg_len != PROTO_FRAME_BYTES) return PROTO_BAD_LENGTH;
+		for(uint8_t y = 0; y < NUM_ROWS; y++)
 		{
-			cursor_pos.x++;
+			for(uint8_t x = 0; x < NUM_COLS; x++)
+			{
+				set_pixel(x, y, proto_color(proto_get_pixel(arg, x, y)));
+			}
 		}
+		return PROTO_OK;
+
+	case PROTO_READ_FRAME: 		// no arguments
+		if(arg_len != 0) return PROTO_BAD_LENGTH;
+		for(uint8_t y = 0; y < NUM_ROWS; y++)
+		{
+			for(uint8_t x = 0; x < NUM_COLS; x++)
+			{
+				// the canvas under the cursor, not the blink
+				color c = (x == cursor_pos.x && y == cursor_pos.y) ? prev_color : matrix_buffer[x][y];
+				proto_set_pixel(reply, x, y, proto_color_bits(c.r, c.g, c.b));
+			}
+		}
+		*reply_len = PROTO_FRAME_BYTES;
+		return PROTO_OK;
+
+	case PROTO_SET_MODE: 		// mode, option (0 = none)
+		if(arg_len != 2) return PROTO_BAD_LENGTH;
+		if((arg[0] != COLOR && arg[0] != FILL && arg[0] != DRAW && arg[0] != SPEED) || arg[1] > 8) return PROTO_BAD_ARGUMENT;
+		select_mode(arg[0]);
+		if(arg[1] > 0)
+		{
+			select_option(arg[1]);
+		}
+		return PROTO_OK;
+
+	case PROTO_SET_BAUD: 		// baud, low byte first
+	{
+		if(arg_len != 4) return PROTO_BAD_LENGTH;
+		uint32_t baud = arg[0] | (arg[1] << 8) | (arg[2] << 16) | ((uint32_t)arg[3] << 24);
+		if(baud < USART_MIN_BAUD || baud > USART_MAX_BAUD) return PROTO_BAD_ARGUMENT;
+		proto_new_baud = baud;
+		return PROTO_OK;
 	}
 
-	// check x- (left) direction
-	if(xcoord_data < X_NEUTRAL - THRESHOLD) // joystick wants to move left
+	default:
+		return PROTO_UNKNOWN;
+	}
+}
+
+// returns 1 if the command writes the pixel under the cursor
+uint8_t proto_covers_cursor(const proto_frame* f)
+{
+	const uint8_t* arg = &f->data[2];
+
+	switch(f->data[0])
+	{
+	case PROTO_SET_PIXEL:
+		return arg[0] == cursor_pos.x && arg[1] == cursor_pos.y;
+
+	case PROTO_SET_RECT:
+		return cursor_pos.x >= get_min(arg[0], arg[2]) && cursor_pos.x <= get_max(arg[0], arg[2])
+				&& cursor_pos.y >= get_min(arg[1], arg[3]) && cursor_pos.y <= get_max(arg[1], arg[3]);
+
+	case PROTO_UPLOAD_FRAME:
+		return 1;
+
+	default:
+		return 0;
+	}
+}
+
+// fills a rectangle with two corners given, in the buffer only
+void proto_fill_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, color c)
+{
+	for(uint8_t x = get_min(x0, x1); x <= get_max(x0, x1); x++)
 	{
-		if(cursor_pos.x > 0) 				// room to move left
+		for(uint8_t y = get_min(y0, y1); y <= get_max(y0, y1); y++)
 		{
-			cursor_pos.x--;
+			set_pixel(x, y, c);
 		}
 	}
+}
+
+// returns the color of the 3 protocol color bits
+color proto_color(uint8_t bits)
+{
+	color c = {.r = bits & 1, .g = (bits >> 1) & 1, .b = (bits >> 2) & 1};
+	return c;
+}
+
+// sends the changed rows of the matrix buffer as a delta frame
+void mirror_send()
+{
+	static uint8_t pixels[NUM_ROWS][NUM_COLS];
+	static uint8_t encoded[MIRROR_MAX_ENCODED];
 
-	// check y+ (down) direction
-	if(ycoord_data > Y_NEUTRAL + THRESHOLD) // joystick wants to move down
+	for(uint8_t y = 0; y < NUM_ROWS; y++)
 	{
-		if(cursor_pos.y < NUM_ROWS - 1) 	// room to move down
+		if(mirror.pending & (1 << y))
 		{
-			cursor_pos.y++;
+			for(uint8_t x = 0; x < NUM_COLS; x++)
+			{
+				color c = matrix_buffer[x][y];
+				pixels[y][x] = proto_color_bits(c.r, c.g, c.b);
+			}
 		}
 	}
 
-	// check y- (up) direction
-	if(ycoord_data < Y_NEUTRAL - THRESHOLD) // joystick wants to move up
+	uint16_t len = mirror_build(pixels, mirror.pending, TIM5->CNT, encoded);
+	mirror.pending = 0;
+	if(len)
+	{
+		USART_Write(encoded, len);
+	}
+}
+
+// draws the changed pixels of the matrix buffer in the serial terminal
+void ansi_send()
+{
+	static uint8_t pixels[NUM_ROWS][NUM_COLS];
+	static char out[ANSI_OUT_LEN];
+
+	for(uint8_t y = 0; y < NUM_ROWS; y++)
 	{
-		if(cursor_pos.y > 0)
+		if(ansi_term.pending & (1 << y))
 		{
-			cursor_pos.y--;
+			for(uint8_t x = 0; x < NUM_COLS; x++)
+			{
+				color c = matrix_buffer[x][y];
+				pixels[y][x] = proto_color_bits(c.r, c.g, c.b);
+			}
 		}
 	}
 
-	// create color at the location if drawing
+	uint16_t len = ansi_build(pixels, out, ANSI_OUT_LEN);
+	if(len)
+	{
+		USART_Write((const uint8_t*)out, len);
+	}
+}
+
+// sends a telemetry record if it fits in the transmit ring
+void telemetry_send(uint32_t now)
+{
+	static uint8_t encoded[TELEMETRY_MAX_ENCODED];
+	telemetry_record rec;
+
+	telemetry.last = now;
+
+	rec.mode = kp_mode;
+	rec.option = kp_select;
+	rec.time = now;
+	rec.adc_samples = joystick_iir.samples;
+	rec.key_events = keypad_scan.events.head;
+	rec.button_events = button.events.head;
+	rec.dropped[0] = tick_events.dropped;
+	rec.dropped[1] = keypad_scan.events.dropped;
+	rec.dropped[2] = button.events.dropped;
+	rec.dropped[3] = usart_rx_events.dropped;
+	rec.tx_dropped = usart_tx.dropped;
+	rec.idle_us = sched.idle_total_us;
+	rec.stop_ms = power.stop_ms;
+
+	// a record is not worth waiting for, the next one has the same totals
+	if(USART_Tx_Free() < TELEMETRY_MAX_ENCODED)
+	{
+		telemetry.skipped++;
+		return;
+	}
+	USART_Write(encoded, telemetry_build(&rec, encoded));
+	telemetry.records++;
+}
+
+/* ------------------ JOYSTICK FUNCTIONS ------------------ */
+
+// moves the cursor in the direction indicated by the joystick
+void move_cursor()
+{
+	PROFILE_BEGIN(PROFILE_MOVE_CURSOR);
+
+	// update the previous cursor position
+	prev_pos = cursor_pos;
+
+	// speed from the deflection, then integrate the sub-pixel position
+	int32_t vx = cursor_velocity(axis_deflection(&joystick_cal.x, inputs.xcoord));
+	int32_t vy = cursor_velocity(axis_deflection(&joystick_cal.y, inputs.ycoord));
+	cursor_x_q8 = integrate_axis(cursor_x_q8, vx, NUM_COLS);
+	cursor_y_q8 = integrate_axis(cursor_y_q8, vy, NUM_ROWS);
+	cursor_pos.x = cursor_x_q8 >> 8;
+	cursor_pos.y = cursor_y_q8 >> 8;
+
+	// every pixel of this step goes to the buffer first, then one update for all of them
+	uint8_t changed = 0;
+
+	// create color at the location (and its mirrored copies) if drawing
 	if(drawing)
 	{
-		draw_pixel(cursor_pos.x, cursor_pos.y, draw_color);
+		set_stroke_pixel(cursor_pos, draw_color);
+		changed = 1;
 	}
-	static uint8_t state = 0;
 	// check if the cursor is in the previous position
 	if(cursor_pos.x == prev_pos.x && cursor_pos.y == prev_pos.y) // cursor is at the previous position, blink cursor
 	{
 		static uint8_t blink_count = 0;
 		if(blink_count == BLINK_THRESHOLD)
 		{
-			if(state) //check_color(cursor_pos, WHITE)) // matrix color at cursor is WHITE
+			if(cursor_lit) //check_color(cursor_pos, WHITE)) // matrix color at cursor is WHITE
 			{
-				draw_pixel(cursor_pos.x, cursor_pos.y, prev_color); // BLACK ? // prev_color
-				state = 0;
+				set_pixel(cursor_pos.x, cursor_pos.y, prev_color); // BLACK ? // prev_color
+				cursor_lit = 0;
 			}
 			else
 			{
-				draw_pixel(cursor_pos.x, cursor_pos.y, check_color(cursor_pos, BLACK) ? WHITE : BLACK); // WHITE
-				state = 1;
+				set_pixel(cursor_pos.x, cursor_pos.y, check_color(cursor_pos, BLACK) ? WHITE : BLACK); // WHITE
+				cursor_lit = 1;
 			}
+			changed = 1;
 			// reset blink count
 			blink_count = 0;
-			// check the button status
-			button_flag = get_joystick_button();
 		}
 		else
 		{
@@ -443,14 +1239,376 @@ void move_cursor()
 	}
 	else // need to replace the color at the previous position, and update prev_color for next time
 	{
-		draw_pixel(prev_pos.x, prev_pos.y, prev_color);
+		set_pixel(prev_pos.x, prev_pos.y, prev_color);
 		prev_color = matrix_buffer[cursor_pos.x][cursor_pos.y];
-		state = 0;
+		cursor_lit = 0;
+		changed = 1;
+	}
+
+	// single display update for the whole step
+	if(changed)
+	{
+		update_display();
+	}
+
+	PROFILE_END(PROFILE_MOVE_CURSOR);
+}
+
+// maps a deflection through the acceleration curve to a speed in pixels per tick (Q8)
+int32_t cursor_velocity(int16_t deflection)
+{
+	int32_t d = deflection < 0 ? -deflection : deflection; // 0 to 256
+	int32_t speed;
+
+	if(d == 0)
+	{
+		return 0;
+	}
+
+	// quadratic curve, slow and precise near the dead zone, fast at full deflection
+	speed = CURSOR_VMIN + (((CURSOR_VMAX - CURSOR_VMIN) * d * d) >> 16);
+	speed = (speed * cursor_gain) >> 8;
+	if(speed < 1) speed = 1; // the slow speeds would round a small nudge back into a dead zone
+
+	return deflection < 0 ? -speed : speed;
+}
+
+// adds the velocity to the position and keeps it on the matrix (Q8)
+int32_t integrate_axis(int32_t pos, int32_t velocity, uint8_t size)
+{
+	// stick released, settle in the pixel center so the next nudge moves one pixel after half a pixel
+	if(velocity == 0)
+	{
+		return (pos & ~0xFF) | 0x80;
+	}
+
+	pos += velocity;
+	if(pos < 0) pos = 0;
+	if(pos > ((size << 8) - 1)) pos = (size << 8) - 1;
+	return pos;
+}
+
+/* ------------------ BENCHMARK FUNCTIONS ------------------ */
+
+// times the drawing primitives and a refresh frame, prints them and the memory footprint, then puts the canvas back
+void run_benchmarks()
+{
+	bench_result r;
+	uint8_t canvas[PROTO_FRAME_BYTES]; // packed as a PROTO_READ_FRAME reply, only on the stack while 'b' runs
+
+	// the cases draw over the canvas, it is put back afterwards
+	for(uint8_t y = 0; y < NUM_ROWS; y++)
+	{
+		for(uint8_t x = 0; x < NUM_COLS; x++)
+		{
+			color c = matrix_buffer[x][y];
+			proto_set_pixel(canvas, x, y, proto_color_bits(c.r, c.g, c.b));
+		}
+	}
+
+	bench_init();
+	bench_print_header();
+
+	for(uint8_t i = 0; i < NUM_BENCH_CASES; i++)
+	{
+		// the buffer only cases draw while the refresh shows it, as the commands do
+		// the pin cases stop it first, it would latch a half shifted section
+		if(bench_cases[i].pins && refresh.owned)
+		{
+			matrix_refresh_stop();
+			refresh.owned = 0;
+		}
+		bench_run(&r, bench_cases[i].name, bench_cases[i].run, BENCH_CALLS);
+		bench_print(&r);
+	}
+	refresh.owned = 1;
+	matrix_refresh_start();
+
+	bench_print_mem("matrix_buffer", sizeof(matrix_buffer));
+	bench_print_mem("bench_canvas_stack", sizeof(canvas));
+	bench_print_mem("journal", sizeof(journal));
+	bench_print_mem("usart_tx", sizeof(usart_tx));
+	bench_print_mem("usart_rx", sizeof(usart_rx) + sizeof(usart_rx_queue));
+	bench_print_mem("joystick_samples", sizeof(joystick_samples));
+	bench_print_mem("proto", sizeof(proto));
+	bench_print_mem("mirror", sizeof(mirror));
+	bench_print_mem("ansi_term", sizeof(ansi_term));
+	bench_print_mem("tick_queue", sizeof(tick_queue));
+	bench_print_ram();
+
+	for(uint8_t y = 0; y < NUM_ROWS; y++)
+	{
+		for(uint8_t x = 0; x < NUM_COLS; x++)
+		{
+			matrix_buffer[x][y] = proto_color(proto_get_pixel(canvas, x, y));
+		}
+	}
+	dirty_rows = 0xFFFF; // the canvas streams may have taken the benchmark drawings
+}
+
+// fill_matrix() in a color
+void bench_fill()
+{
+	fill_matrix(BLUE);
+}
+
+// clear_matrix()
+void bench_clear()
+{
+	clear_matrix();
+}
+
+// draw_rect() around the whole matrix
+void bench_rect()
+{
+	point p1 = {.x = 0, .y = 0};
+	point p2 = {.x = NUM_COLS - 1, .y = NUM_ROWS - 1};
+	draw_rect(p1, p2);
+}
+
+// make_logo()
+void bench_logo()
+{
+	make_logo(GREEN);
+}
+
+// make_hi()
+void bench_hi()
+{
+	make_hi(PURPLE);
+}
+
+// make_smiley()
+void bench_smiley()
+{
+	make_smiley(CYAN);
+}
+
+// matrix_shift_section() of every section, the refresh's work for one frame
+void bench_shift_frame()
+{
+	for(uint8_t section = 0; section < MATRIX_SECTIONS; section++)
+	{
+		matrix_shift_section(section);
+	}
+}
+
+// update_display() with the pins not owned by the refresh
+void bench_update_display()
+{
+	update_display();
+}
+
+// fmt_int() of the longest int32_t
+void bench_fmt_int()
+{
+	fmt_int(bench.text, sizeof(bench.text), INT32_MIN, 0, ' ');
+}
+
+// fmt_format() of a bench result line
+void bench_fmt_format()
+{
+	fmt_format(bench.text, sizeof(bench.text), "bench,%s,%u,%u,%u,%u,%X\n\r", "fmt_format", 16, 1234, 5678, 91011, 0xBEEF);
+}
+
+#if BENCH_SNPRINTF
+// snprintf() of the longest int32_t, as bench_fmt_int()
+void bench_snprintf_int()
+{
+	snprintf(bench.text, sizeof(bench.text), "%ld", (long)INT32_MIN);
+}
+
+// snprintf() of a bench result line, as bench_fmt_format()
+void bench_snprintf_format()
+{
+	snprintf(bench.text, sizeof(bench.text), "bench,%s,%u,%u,%u,%u,%X\n\r", "fmt_format", 16, 1234, 5678, 91011, 0xBEEF);
+}
+#endif /* BENCH_SNPRINTF */
+
+/* ------------------- COMMAND FUNCTIONS ------------------- */
+
+// switches to a mode with no option picked
+void select_mode(uint8_t mode)
+{
+	kp_mode = mode;
+	kp_select = -1; // default is no selection
+	active_command = NULL;
+	if(mode == DRAW)
+	{
+		reset_shapes(line, square, triangle);
+	}
+}
+
+// picks an option in the current mode and runs its on_enter action
+void select_option(uint8_t option)
+{
+	const command* cmd = find_command(commands, NUM_COMMANDS, kp_mode, option);
+	if(cmd == NULL) // error in option selected, do nothing
+	{
+		return;
+	}
+
+	kp_select = option;
+	active_command = cmd;
+	cmd->on_enter(option);
+}
+
+// returns the table entry of a (mode, option) pair, NULL if there is none
+const command* find_command(const command* table, uint8_t count, uint8_t mode, uint8_t option)
+{
+	for(uint8_t i = 0; i < count; i++)
+	{
+		if(table[i].mode == mode && table[i].option == option)
+		{
+			return &table[i];
+		}
+	}
+	return NULL;
+}
+
+// COLOR mode, sets the stroke color
+void cmd_color(uint8_t option)
+{
+	draw_color = colors[option - 1];
+}
+
+// FILL mode, fills the matrix with a color
+void cmd_fill(uint8_t option)
+{
+	fill_matrix(colors[option - 1]);
+}
+
+// DRAW 1, moves without drawing
+void cmd_cursor(uint8_t option)
+{
+	drawing = 0;
+}
+
+// DRAW 2, draws where the cursor moves
+void cmd_trace(uint8_t option)
+{
+	drawing = 1;
+	symmetry = SYMMETRY_NONE;
+}
+
+// DRAW 3 to 5, moves without drawing until the shape points are clicked
+void cmd_shape(uint8_t option)
+{
+	drawing = 0;
+	button_flag = 0; // only clicks made in the shape count
+}
+
+// DRAW 6, traces mirrored and steps to the next symmetry
+void cmd_symmetry(uint8_t option)
+{
+	drawing = 1;
+	symmetry = (symmetry + 1) % 4; // horizontal -> vertical -> 4-way -> off
+}
+
+// DRAW 7, shows the hi or smiley preset
+void cmd_preset(uint8_t option)
+{
+	if(inputs.xcoord % 2) make_hi(PURPLE);
+	else make_smiley(CYAN);
+}
+
+// DRAW 8, clears the matrix
+void cmd_clear(uint8_t option)
+{
+	fill_matrix(colors[option - 1]);
+}
+
+// SPEED mode, sets the cursor speed scale
+void cmd_speed(uint8_t option)
+{
+	cursor_gain = speed_gains[option - 1]; // larger number = faster speed
+}
+
+// DRAW 3, a click adds a line point
+void tick_line()
+{
+	if(button_flag)
+	{
+		add_pt_to_shape(line, 2);
+		button_flag = 0;
+	}
+}
+
+// DRAW 4, a click adds a square corner
+void tick_square()
+{
+	if(button_flag)
+	{
+		add_pt_to_shape(square, 4);
+		button_flag = 0;
+	}
+}
+
+// DRAW 5, a click adds a triangle vertex
+void tick_triangle()
+{
+	if(button_flag)
+	{
+		add_pt_to_shape(triangle, 3);
+		button_flag = 0;
 	}
 }
 
 /* ------------------- MATRIX FUNCTIONS ------------------- */
 
+// returns 1 if the key at a keypad index is a mode key
+uint8_t keypad_is_mode(uint8_t index)
+{
+	// * = COLOR, 0 = FILL, # = DRAW, 9 = SPEED, the key values are the modes
+	return keypad_vals[index] > 8 || keypad_vals[index] == 0;
+}
+
+// runs a key on its own, a mode key switches the mode and an option key picks its option
+void run_key(uint8_t index)
+{
+	if(keypad_is_mode(index))
+	{
+		select_mode(keypad_vals[index]);
+	}
+	else // keypad press picks an option in the current mode
+	{
+		select_option(keypad_vals[index]);
+	}
+}
+
+// runs the chord of a mode key and an option key, the current mode and option stay
+void run_chord(uint8_t mode_index, uint8_t option_index)
+{
+	uint8_t option = keypad_vals[option_index];
+	const command* chord = find_command(chords, NUM_CHORDS, keypad_vals[mode_index], option);
+	if(chord != NULL) // no chord for this pair, do nothing
+	{
+		chord->on_enter(option);
+	}
+}
+
+// puts the cursor, drawing tool and matrix back to their defaults so a journal starts from a known state
+void reset_session()
+{
+	cursor_pos.x = 0;
+	cursor_pos.y = 0;
+	cursor_x_q8 = 0x80;
+	cursor_y_q8 = 0x80;
+	cursor_gain = CURSOR_GAIN_ONE;
+	prev_pos = cursor_pos;
+	prev_color = BLACK;
+	cursor_lit = 0;
+	draw_color = RED;
+	drawing = 0;
+	symmetry = SYMMETRY_NONE;
+	button_flag = 0;
+	kp_pending = -1;
+	kp_chord_keys = 0;
+	TIM2->CNT = 0;
+	ring_flush(&tick_events);
+	clear_matrix();
+}
+
 // adds the current cursor position to the shape
 void add_pt_to_shape(point* shape, uint8_t size)
 {
@@ -669,10 +1827,30 @@ uint8_t check_color(point pt, color c)
 	return 0;
 }
 
+// sets the pixel and its mirrored copies in the buffer without updating the display
+void set_stroke_pixel(point pt, color c)
+{
+	uint8_t mx = NUM_COLS - 1 - pt.x; // mirrored around the center column
+	uint8_t my = NUM_ROWS - 1 - pt.y; // mirrored around the center row
+
+	set_pixel(pt.x, pt.y, c);
+	if(symmetry == SYMMETRY_HORIZONTAL || symmetry == SYMMETRY_QUAD) set_pixel(mx, pt.y, c);
+	if(symmetry == SYMMETRY_VERTICAL || symmetry == SYMMETRY_QUAD) set_pixel(pt.x, my, c);
+	if(symmetry == SYMMETRY_QUAD) set_pixel(mx, my, c);
+}
+
+// sets the pixel at the input coordinates in the buffer without updating the display
+void set_pixel(uint8_t x, uint8_t y, color c)
+{
+	matrix_buffer[x][y] = c;
+	dirty_rows |= (1 << y);
+}
+
 // removes the pixel at the input coordinates from the buffer then updates the display
 void clear_pixel(uint8_t x, uint8_t y)
 {
 	matrix_buffer[x][y] = BLACK;
+	dirty_rows |= (1 << y);
 	update_display();
 }
 
@@ -680,6 +1858,7 @@ void clear_pixel(uint8_t x, uint8_t y)
 void draw_pixel(uint8_t x, uint8_t y, color c)
 {
 	matrix_buffer[x][y] = c;
+	dirty_rows |= (1 << y);
 	update_display();
 }
 
@@ -697,6 +1876,7 @@ void fill_matrix(color c)
 			matrix_buffer[col][row] = c;
 		}
 	}
+	dirty_rows = 0xFFFF;
 }
 
 // clears the matrix buffer and updates the display
@@ -713,6 +1893,7 @@ void clear_matrix()
 			matrix_buffer[col][row] = BLACK;
 		}
 	}
+	dirty_rows = 0xFFFF;
 
 	// updates the display
 	update_display();
@@ -724,6 +1905,15 @@ void update_display()
 	// variables
 	uint8_t row, col;
 
+	// once TIM3 refreshes the matrix it shows the buffer as it changes
+	if(refresh.owned)
+	{
+		return;
+	}
+
+	PROFILE_BEGIN(PROFILE_UPDATE_DISPLAY);
+	telemetry.refreshes++;
+
 	// initialize matrix control variables
 	set_OE(HIGH); // disable output
 	set_LAT(HIGH); // latch current data
@@ -755,6 +1945,8 @@ void update_display()
 		// set row selection
 		set_matrix_section(row);
 	}
+
+	PROFILE_END(PROFILE_UPDATE_DISPLAY);
 }
 
 
@@ -0,0 +1,664 @@
+/*
+ * doodle_sim.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  simulator of the doodlestick, runs the firmware on the board of port_host.h
+ *  from a script of inputs and writes out what the panel shows
+ *
+ *  	doodle_sim [-s seconds] [-j journal] [-o frame.png] [-e ms] [-x scale] [-t] [-q] [script]
+ *  		-s 	simulated seconds to run, 5 by default, longer if the script is
+ *  		-j 	replays a journal dump (the 'd' output) once the board is up
+ *  		-o 	writes the panel as numbered images, frame_0000.png, ...,
+ *  			PNG or PPM by the extension
+ *  		-e 	ms between images, without it only at the frame lines and at
+ *  			the end
+ *  		-x 	image pixels per LED, 8 by default
+ *  		-t 	draws the panel in the terminal instead of writing images,
+ *  			the serial output is left out
+ *  		-q 	leaves the serial output out, it goes to stdout otherwise
+ *
+ *  	SCRIPT
+ *  		one input per line, at a time in ms since power up, lines starting
+ *  		with # are comments
+ *  			500 key 5 down 		keypad key by its label, 1 to 9, *, 0, #
+ *  			600 key 5 up
+ *  			700 press # 		down, and up again 100 ms later
+ *  			800 button down 	the joystick button, also up and click
+ *  			900 stick 4095 2048 joystick ADC results x y, 2048 is at rest
+ *  			1000 send s\n 		characters to the serial port, \n and \r work
+ *  			1100 replay s.txt 	loads a journal dump and replays it with 'p'
+ *  			1200 frame 			an image of the panel now
+ *  			5000 end 			the run ends here
+ *  		the stick must be at rest for the calibration during the first
+ *  		200 ms, the same as on the board
+ *
+ *  	IMAGES
+ *  		each LED is the color its row had the last time it was lit, scaled
+ *  		by the part of the time since the image before that the output was
+ *  		on, so a dimmed panel comes out dark and a stopped one black
+ *
+ *  	REPORT
+ *  		at the end, on stderr as "name value" lines: the simulated time, the
+ *  		refresh frames and their period, the core cycles the refresh
+ *  		interrupt takes per frame, the busy time, and the register accesses
+ *  		and writes of every peripheral in total and per frame
+ */
+
+#define main doodle_main
+#include "../Core/Src/main.c"
+#undef main
+
+#include <unistd.h>
+
+
+// defines
+#define SIM_MS 			(PORT_HOST_CLK / 1000) 	// cycles per ms
+#define SIM_SECONDS 	5 		// default run
+#define SIM_PRESS_MS 	100 	// a press or a click is held this long
+#define SIM_SCALE 		8 		// image pixels per LED
+#define SIM_RETRY_MS 	1 		// a replay waits this long for the USART to come up
+#define SIM_LINE_LEN 	256
+#define SIM_SECTIONS 	(PORT_HOST_PANEL_H / 2) // sections per refresh frame
+
+// typedefs
+typedef enum SIM_INPUT {
+		SIM_KEY_DOWN, SIM_KEY_UP, SIM_BUTTON_DOWN, SIM_BUTTON_UP, SIM_STICK,
+		SIM_SEND, SIM_REPLAY, SIM_FRAME, SIM_END
+} SIM_INPUT;
+
+typedef struct sim_input
+{
+	uint64_t 	at; 	// wall cycle
+	uint32_t 	order; 	// line order, inputs at the same time keep it
+	uint8_t 	type; 	// SIM_INPUT
+	uint16_t 	x, y; 	// key index, or the stick
+	char* 		text; 	// bytes to send, or the journal file
+	uint16_t 	len;
+} sim_input;
+
+typedef struct simulator
+{
+	sim_input* 	inputs;
+	uint32_t 	count, next;
+	uint64_t 	every; 		// cycles between images, 0 for none
+	uint64_t 	frame_at; 	// next periodic image
+	const char* out; 		// image path, NULL for none
+	uint8_t 	png; 		// 1 for PNG, 0 for PPM
+	uint8_t 	scale;
+	uint8_t 	term; 		// 1 to draw in the terminal
+	uint8_t 	quiet; 		// 1 to drop the serial output
+	uint32_t 	frames; 	// images written
+	uint64_t 	last_wall; 	// wall and lit cycles at the image before
+	uint64_t 	last_lit;
+} simulator;
+
+simulator sim = {0};
+const char* sim_periph_names[PORT_NUM] = {
+		"GPIOA", "GPIOB", "GPIOC", "TIM2", "TIM3", "TIM5", "TIM6", "TIM7", "TIM16",
+		"LPTIM1", "ADC1", "ADC2", "ADC_COMMON", "DMA1", "DMA1_CH1", "DMA1_CH6", "DMA1_CH7",
+		"DMA1_CSELR", "USART2", "RCC", "EXTI", "PWR", "FLASH", "SYSCFG", "NVIC", "SCB", "DWT", "COREDEBUG"
+};
+
+// function declarations
+void sim_add(uint64_t at, uint8_t type, uint16_t x, uint16_t y, const char* text, uint16_t len); // adds an input to the script
+uint8_t sim_load_script(const char* path); // reads a script file, returns 0 if it can't
+int8_t sim_key_index(char label); // returns the keypad index of a key label, -1 if none
+int sim_compare(const void* a, const void* b); // orders the inputs by time, then by line
+void sim_tick(); // applies the inputs that are due, writes the periodic images, sets the next call
+void sim_schedule(); // sets port_host.script_at to the next input or image
+uint8_t sim_apply(sim_input* in); // applies an input, returns 0 if it has to wait
+uint8_t sim_replay(const char* path); // loads a journal dump into the firmware's journal, returns 0 if it can't
+void sim_frame(); // writes the panel as an image or to the terminal
+void sim_color(uint8_t bits, double level, uint8_t* rgb); // converts protocol color bits to 8 bit RGB at a level 0 to 1
+uint8_t sim_write_ppm(const char* path, const uint8_t* rgb, uint16_t w, uint16_t h); // writes a binary PPM
+uint8_t sim_write_png(const char* path, const uint8_t* rgb, uint16_t w, uint16_t h); // writes an uncompressed PNG
+void sim_png_chunk(FILE* f, const char* type, const uint8_t* data, uint32_t len); // writes a PNG chunk with its CRC
+uint32_t sim_crc32(uint32_t crc, const uint8_t* data, uint32_t len); // adds bytes to a PNG CRC
+void sim_put32(uint8_t* p, uint32_t v); // stores a big endian 32 bit value
+void sim_tx(uint8_t byte); // writes a byte the board sent to stdout
+void sim_report(); // prints the report to stderr
+
+
+int main(int argc, char** argv)
+{
+	double seconds = SIM_SECONDS;
+	uint8_t seconds_given = 0;
+	int opt;
+
+	sim.scale = SIM_SCALE;
+	while((opt = getopt(argc, argv, "s:j:o:e:x:tq")) != -1)
+	{
+		switch(opt)
+		{
+		case 's': seconds = atof(optarg); seconds_given = 1; break;
+		case 'j': sim_add(0, SIM_REPLAY, 0, 0, optarg, strlen(optarg)); break;
+		case 'o': sim.out = optarg; break;
+		case 'e': sim.every = (uint64_t)(atof(optarg) * SIM_MS); break;
+		case 'x': sim.scale = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+		case 't': sim.term = 1; sim.quiet = 1; break;
+		case 'q': sim.quiet = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-s seconds] [-j journal] [-o frame.png|frame.ppm] [-e ms] [-x scale] [-t] [-q] [script]\n", argv[0]);
+			return 2;
+		}
+	}
+	if(optind < argc && !sim_load_script(argv[optind]))
+	{
+		return 1;
+	}
+	if(sim.out)
+	{
+		const char* ext = strrchr(sim.out, '.');
+		sim.png = !(ext && !strcmp(ext, ".ppm"));
+	}
+
+	// the script runs past the default length, not past a length that was asked for
+	qsort(sim.inputs, sim.count, sizeof(sim_input), sim_compare);
+	if(!seconds_given && sim.count && sim.inputs[sim.count - 1].at + 1000 * SIM_MS > seconds * PORT_HOST_CLK)
+	{
+		seconds = (double)(sim.inputs[sim.count - 1].at + 1000 * SIM_MS) / PORT_HOST_CLK;
+	}
+
+	port_host_reset(seconds);
+	port_host.tx = sim_tx;
+	port_host.script = sim_tick;
+	sim.frame_at = sim.every;
+	sim_schedule();
+	if(sim.term)
+	{
+		printf("\x1b[2J");
+	}
+
+	if(!setjmp(port_host.done))
+	{
+		doodle_main();
+	}
+
+	sim_frame(); // the panel at the end
+	sim_report();
+	return 0;
+}
+
+// adds an input to the script
+void sim_add(uint64_t at, uint8_t type, uint16_t x, uint16_t y, const char* text, uint16_t len)
+{
+	sim.inputs = realloc(sim.inputs, (sim.count + 1) * sizeof(sim_input));
+	sim_input* in = &sim.inputs[sim.count];
+	in->at = at;
+	in->order = sim.count++;
+	in->type = type;
+	in->x = x;
+	in->y = y;
+	in->text = NULL;
+	in->len = len;
+	if(text)
+	{
+		in->text = malloc(len + 1);
+		memcpy(in->text, text, len);
+		in->text[len] = 0;
+	}
+}
+
+// reads a script file, returns 0 if it can't
+uint8_t sim_load_script(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	char line[SIM_LINE_LEN];
+	uint32_t number = 0;
+
+	if(!f)
+	{
+		fprintf(stderr, "can't open %s\n", path);
+		return 0;
+	}
+
+	while(fgets(line, sizeof(line), f))
+	{
+		double ms;
+		char verb[16] = {0};
+		char arg[SIM_LINE_LEN] = {0};
+		int used = 0;
+		number++;
+
+		line[strcspn(line, "\r\n")] = 0;
+		if(line[strspn(line, " \t")] == '#' || sscanf(line, " %lf %15s %n", &ms, verb, &used) < 2)
+		{
+			continue; // blank or comment
+		}
+		strncpy(arg, line + used, sizeof(arg) - 1);
+		uint64_t at = (uint64_t)(ms * SIM_MS);
+
+		if(!strcmp(verb, "key") || !strcmp(verb, "press"))
+		{
+			char label = 0, dir[8] = {0};
+			sscanf(arg, " %c %7s", &label, dir);
+			int8_t key = sim_key_index(label);
+			if(key < 0)
+			{
+				fprintf(stderr, "%s:%u: no key %c\n", path, number, label);
+				continue;
+			}
+			if(!strcmp(verb, "press") || !strcmp(dir, "down")) sim_add(at, SIM_KEY_DOWN, key, 0, NULL, 0);
+			if(!strcmp(verb, "press")) sim_add(at + SIM_PRESS_MS * SIM_MS, SIM_KEY_UP, key, 0, NULL, 0);
+			else if(!strcmp(dir, "up")) sim_add(at, SIM_KEY_UP, key, 0, NULL, 0);
+		}
+		else if(!strcmp(verb, "button"))
+		{
+			if(strstr(arg, "down") || strstr(arg, "click")) sim_add(at, SIM_BUTTON_DOWN, 0, 0, NULL, 0);
+			if(strstr(arg, "up")) sim_add(at, SIM_BUTTON_UP, 0, 0, NULL, 0);
+			if(strstr(arg, "click")) sim_add(at + SIM_PRESS_MS * SIM_MS, SIM_BUTTON_UP, 0, 0, NULL, 0);
+		}
+		else if(!strcmp(verb, "click"))
+		{
+			sim_add(at, SIM_BUTTON_DOWN, 0, 0, NULL, 0);
+			sim_add(at + SIM_PRESS_MS * SIM_MS, SIM_BUTTON_UP, 0, 0, NULL, 0);
+		}
+		else if(!strcmp(verb, "stick"))
+		{
+			unsigned x = PORT_HOST_ADC_MID, y = PORT_HOST_ADC_MID;
+			sscanf(arg, "%u %u", &x, &y);
+			sim_add(at, SIM_STICK, x, y, NULL, 0);
+		}
+		else if(!strcmp(verb, "send"))
+		{
+			// the rest of the line, with \n and \r turned into the characters
+			char bytes[SIM_LINE_LEN];
+			uint16_t n = 0;
+			for(char* c = arg; *c; c++)
+			{
+				if(c[0] == '\\' && c[1] == 'n') { bytes[n++] = '\n'; c++; }
+				else if(c[0] == '\\' && c[1] == 'r') { bytes[n++] = '\r'; c++; }
+				else bytes[n++] = *c;
+			}
+			sim_add(at, SIM_SEND, 0, 0, bytes, n);
+		}
+		else if(!strcmp(verb, "replay"))
+		{
+			sim_add(at, SIM_REPLAY, 0, 0, arg, strlen(arg));
+		}
+		else if(!strcmp(verb, "frame"))
+		{
+			sim_add(at, SIM_FRAME, 0, 0, NULL, 0);
+		}
+		else if(!strcmp(verb, "end"))
+		{
+			sim_add(at, SIM_END, 0, 0, NULL, 0);
+		}
+		else
+		{
+			fprintf(stderr, "%s:%u: unknown input %s\n", path, number, verb);
+		}
+	}
+
+	fclose(f);
+	return 1;
+}
+
+// returns the keypad index of a key label, -1 if none
+int8_t sim_key_index(char label)
+{
+	for(uint8_t i = 0; i < NUM_KEYS; i++)
+	{
+		if(keypad_chars[i] == label)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+// orders the inputs by time, then by line
+int sim_compare(const void* a, const void* b)
+{
+	const sim_input* x = a;
+	const sim_input* y = b;
+	if(x->at != y->at) return (x->at < y->at) ? -1 : 1;
+	return (x->order < y->order) ? -1 : (x->order > y->order);
+}
+
+// applies the inputs that are due, writes the periodic images, sets the next call
+void sim_tick()
+{
+	while(sim.next < sim.count && sim.inputs[sim.next].at <= port_host.wall)
+	{
+		if(!sim_apply(&sim.inputs[sim.next]))
+		{
+			port_host.script_at = port_host.wall + SIM_RETRY_MS * SIM_MS;
+			return;
+		}
+		sim.next++;
+	}
+
+	if(sim.every && sim.frame_at <= port_host.wall)
+	{
+		sim_frame();
+		sim.frame_at += sim.every;
+	}
+	sim_schedule();
+}
+
+// sets port_host.script_at to the next input or image
+void sim_schedule()
+{
+	uint64_t at = PORT_HOST_NEVER;
+	if(sim.next < sim.count) at = sim.inputs[sim.next].at;
+	if(sim.every && sim.frame_at < at) at = sim.frame_at;
+	port_host.script_at = at;
+}
+
+// applies an input, returns 0 if it has to wait
+uint8_t sim_apply(sim_input* in)
+{
+	switch(in->type)
+	{
+	case SIM_KEY_DOWN:
+		port_host_set_keys(port_host.keys | (1 << in->x));
+		break;
+	case SIM_KEY_UP:
+		port_host_set_keys(port_host.keys & ~(1 << in->x));
+		break;
+	case SIM_BUTTON_DOWN:
+		port_host_set_button(1);
+		break;
+	case SIM_BUTTON_UP:
+		port_host_set_button(0);
+		break;
+	case SIM_STICK:
+		port_host_set_joystick(in->x, in->y);
+		break;
+	case SIM_SEND:
+		port_host_send((const uint8_t*)in->text, in->len);
+		break;
+	case SIM_REPLAY:
+		// the 'p' has to find the USART running
+		if(!(port_host.usart2.CR1 & USART_CR1_UE))
+		{
+			return 0;
+		}
+		if(sim_replay(in->text))
+		{
+			port_host_send((const uint8_t*)"p", 1);
+		}
+		break;
+	case SIM_FRAME:
+		sim_frame();
+		break;
+	case SIM_END:
+		port_host.end_at = port_host.wall;
+		break;
+	}
+	return 1;
+}
+
+// loads a journal dump into the firmware's journal, returns 0 if it can't
+uint8_t sim_replay(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	char line[SIM_LINE_LEN];
+	uint16_t count = 0;
+
+	if(!f)
+	{
+		fprintf(stderr, "can't open %s\n", path);
+		return 0;
+	}
+
+	// "journal N" then "time type value" lines, anything else is skipped
+	while(fgets(line, sizeof(line), f) && count < JOURNAL_SIZE)
+	{
+		unsigned long time;
+		unsigned type, value;
+		if(sscanf(line, "%lu %u %u", &time, &type, &value) == 3)
+		{
+			journal.entries[count].time = time;
+			journal.entries[count].type = type;
+			journal.entries[count].value = value;
+			count++;
+		}
+	}
+	fclose(f);
+
+	journal.count = count;
+	journal.overflow = 0;
+	return 1;
+}
+
+// writes the panel as an image or to the terminal
+void sim_frame()
+{
+	// the part of the time since the last image that the output was on
+	uint64_t span = port_host.wall - sim.last_wall;
+	double level = span ? (double)(port_host.panel.lit_cycles - sim.last_lit) / span : 0;
+	if(level > 1) level = 1;
+	sim.last_wall = port_host.wall;
+	sim.last_lit = port_host.panel.lit_cycles;
+
+	if(sim.term)
+	{
+		printf("\x1b[H");
+		for(uint8_t y = 0; y < PORT_HOST_PANEL_H; y++)
+		{
+			for(uint8_t x = 0; x < PORT_HOST_PANEL_W; x++)
+			{
+				printf("\x1b[4%um  ", level > 0 ? port_host.panel.shown[y][x] : 0);
+			}
+			printf("\x1b[0m\n");
+		}
+		printf("%.3f s\n", (double)port_host.wall / PORT_HOST_CLK);
+		fflush(stdout);
+		sim.frames++;
+		return;
+	}
+	if(!sim.out)
+	{
+		return;
+	}
+
+	uint16_t w = PORT_HOST_PANEL_W * sim.scale;
+	uint16_t h = PORT_HOST_PANEL_H * sim.scale;
+	uint8_t* rgb = malloc((size_t)w * h * 3);
+	for(uint16_t py = 0; py < h; py++)
+	{
+		for(uint16_t px = 0; px < w; px++)
+		{
+			sim_color(port_host.panel.shown[py / sim.scale][px / sim.scale], level, &rgb[((size_t)py * w + px) * 3]);
+		}
+	}
+
+	// frame.png becomes frame_0000.png, frame_0001.png, ...
+	char path[SIM_LINE_LEN];
+	const char* ext = strrchr(sim.out, '.');
+	int stem = ext ? (int)(ext - sim.out) : (int)strlen(sim.out);
+	snprintf(path, sizeof(path), "%.*s_%04u%s", stem, sim.out, sim.frames, ext ? ext : ".png");
+
+	uint8_t ok = sim.png ? sim_write_png(path, rgb, w, h) : sim_write_ppm(path, rgb, w, h);
+	if(!ok)
+	{
+		fprintf(stderr, "can't write %s\n", path);
+	}
+	free(rgb);
+	sim.frames++;
+}
+
+// converts protocol color bits to 8 bit RGB at a level 0 to 1
+void sim_color(uint8_t bits, double level, uint8_t* rgb)
+{
+	for(uint8_t c = 0; c < 3; c++)
+	{
+		rgb[c] = (bits & (1 << c)) ? (uint8_t)(255 * level + 0.5) : 0;
+	}
+}
+
+// writes a binary PPM
+uint8_t sim_write_ppm(const char* path, const uint8_t* rgb, uint16_t w, uint16_t h)
+{
+	FILE* f = fopen(path, "wb");
+	if(!f)
+	{
+		return 0;
+	}
+	fprintf(f, "P6\n%u %u\n255\n", w, h);
+	fwrite(rgb, 3, (size_t)w * h, f);
+	fclose(f);
+	return 1;
+}
+
+// writes an uncompressed PNG
+uint8_t sim_write_png(const char* path, const uint8_t* rgb, uint16_t w, uint16_t h)
+{
+	FILE* f = fopen(path, "wb");
+	if(!f)
+	{
+		return 0;
+	}
+
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	fwrite(signature, 1, sizeof(signature), f);
+
+	uint8_t ihdr[13] = {0};
+	sim_put32(&ihdr[0], w);
+	sim_put32(&ihdr[4], h);
+	ihdr[8] = 8; 	// bits per channel
+	ihdr[9] = 2; 	// RGB
+	sim_png_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+
+	// every row starts with filter 0, then zlib with stored deflate blocks, no compression needed
+	uint32_t row = 1 + (uint32_t)w * 3;
+	uint32_t raw_len = row * h;
+	uint32_t blocks = (raw_len + 0xFFFE) / 0xFFFF;
+	uint8_t* raw = malloc(raw_len);
+	uint8_t* z = malloc(2 + raw_len + 5 * blocks + 4);
+	uint32_t n = 0;
+
+	for(uint16_t y = 0; y < h; y++)
+	{
+		raw[y * row] = 0;
+		memcpy(&raw[y * row + 1], &rgb[(size_t)y * w * 3], (size_t)w * 3);
+	}
+
+	z[n++] = 0x78;
+	z[n++] = 0x01;
+	for(uint32_t at = 0; at < raw_len; at += 0xFFFF)
+	{
+		uint16_t len = (raw_len - at > 0xFFFF) ? 0xFFFF : raw_len - at;
+		z[n++] = (at + len == raw_len); // BFINAL on the last, BTYPE 00 stored
+		z[n++] = len & 0xFF;
+		z[n++] = len >> 8;
+		z[n++] = ~len & 0xFF;
+		z[n++] = (~len >> 8) & 0xFF;
+		memcpy(&z[n], &raw[at], len);
+		n += len;
+	}
+
+	uint32_t a = 1, b = 0; // Adler-32 of the raw rows
+	for(uint32_t i = 0; i < raw_len; i++)
+	{
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	sim_put32(&z[n], (b << 16) | a);
+	n += 4;
+
+	sim_png_chunk(f, "IDAT", z, n);
+	sim_png_chunk(f, "IEND", NULL, 0);
+	free(raw);
+	free(z);
+	fclose(f);
+	return 1;
+}
+
+// writes a PNG chunk with its CRC
+void sim_png_chunk(FILE* f, const char* type, const uint8_t* data, uint32_t len)
+{
+	uint8_t word[4];
+	sim_put32(word, len);
+	fwrite(word, 1, 4, f);
+	fwrite(type, 1, 4, f);
+	if(len)
+	{
+		fwrite(data, 1, len, f);
+	}
+	uint32_t crc = sim_crc32(0xFFFFFFFF, (const uint8_t*)type, 4);
+	crc = sim_crc32(crc, data, len) ^ 0xFFFFFFFF;
+	sim_put32(word, crc);
+	fwrite(word, 1, 4, f);
+}
+
+// adds bytes to a PNG CRC
+uint32_t sim_crc32(uint32_t crc, const uint8_t* data, uint32_t len)
+{
+	for(uint32_t i = 0; i < len; i++)
+	{
+		crc ^= data[i];
+		for(uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+	return crc;
+}
+
+// stores a big endian 32 bit value
+void sim_put32(uint8_t* p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+// writes a byte the board sent to stdout
+void sim_tx(uint8_t byte)
+{
+	if(!sim.quiet)
+	{
+		putchar(byte);
+	}
+}
+
+// prints the report to stderr
+void sim_report()
+{
+	double seconds = (double)port_host.wall / PORT_HOST_CLK;
+	double frames = (double)port_host.panel.sections / SIM_SECTIONS;
+	uint64_t refresh_cycles = 0;
+
+	for(uint8_t i = 0; i < PORT_HOST_IRQS; i++)
+	{
+		if(port_host_irqs[i].irq == TIM3_IRQn)
+		{
+			refresh_cycles = port_host_irqs[i].cycles;
+		}
+	}
+
+	fflush(stdout);
+	fprintf(stderr, "simulated_s %.3f\n", seconds);
+	fprintf(stderr, "frames %.0f\n", frames);
+	fprintf(stderr, "frame_ms %.3f\n", frames ? 1000 * seconds / frames : 0);
+	fprintf(stderr, "refresh_cycles_per_frame %.0f\n", frames ? refresh_cycles / frames : 0);
+	fprintf(stderr, "busy_percent %.2f\n", 100.0 * (port_host.wall - port_host.sleep_cycles) / port_host.wall);
+	fprintf(stderr, "stop_s %.3f\n", (double)port_host.stop_cycles / PORT_HOST_CLK);
+	fprintf(stderr, "lit_percent %.2f\n", 100.0 * port_host.panel.lit_cycles / port_host.wall);
+	fprintf(stderr, "serial_tx_bytes %u\n", port_host.tx_bytes);
+	fprintf(stderr, "serial_rx_lost %u\n", port_host.rx_lost);
+	fprintf(stderr, "images %u\n", sim.frames);
+	fprintf(stderr, "# interrupt calls cycles_per_call\n");
+	for(uint8_t i = 0; i < PORT_HOST_IRQS; i++)
+	{
+		if(port_host_irqs[i].count)
+		{
+			fprintf(stderr, "irq_%s %u %.0f\n", port_host_irqs[i].name, port_host_irqs[i].count,
+					(double)port_host_irqs[i].cycles / port_host_irqs[i].count);
+		}
+	}
+	fprintf(stderr, "# peripheral accesses writes writes_per_frame\n");
+	for(uint8_t id = 0; id < PORT_NUM; id++)
+	{
+		if(port_host.accesses[id])
+		{
+			fprintf(stderr, "reg_%s %u %u %.1f\n", sim_periph_names[id], port_host.accesses[id],
+					port_host.writes[id], frames ? port_host.writes[id] / frames : 0);
+		}
+	}
+}
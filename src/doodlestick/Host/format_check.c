@@ -0,0 +1,180 @@
+/*
+ * format_check.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  checks the Core/Inc/format.h conversions against the C library's snprintf()
+ *
+ *  	format_check [values]
+ *  		formats values numbers (200000 by default, after the edge values)
+ *  		with every conversion, flag and width fmt_format() takes and with
+ *  		the same format in snprintf(), and also cut off to a buffer size
+ *  		that changes with the value
+ *  		prints the first mismatches and a "checked N mismatches M" line,
+ *  		exits with 1 if any
+ *
+ *  	CUT OFF TEXT
+ *  		the texts must match, fmt_format() returns what it wrote where
+ *  		snprintf() returns what it would have written, so the return value
+ *  		is checked against the length of the text instead
+ *
+ *  	NOT CHECKED
+ *  		fmt_fixed() has no snprintf() counterpart without floats, and the
+ *  		cycles are measured on the board with 'b' (BENCH_SNPRINTF in bench.h)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Core/Inc/format.h"
+
+
+// defines
+#define CHECK_VALUES 	200000 	// values after the edge values
+#define CHECK_SHOWN 	10 		// mismatches printed
+#define CHECK_LEN 		64
+
+// every conversion with a flag and a width, one value each
+const char* const check_formats[] = {
+		"%d", "%u", "%x", "%X", "%c", "%s", "%%",
+		"%12d", "%-12d|", "%012d", "%1d",
+		"%10u", "%-10u|", "%010u",
+		"%8x", "%08X", "%-8X|",
+		"%3c", "%-3c|", "%8s", "%-8s|",
+		"<%d,%u>"
+};
+#define CHECK_NUM_FORMATS (sizeof(check_formats) / sizeof(check_formats[0]))
+
+// values where the digits, the sign or the width change
+const uint32_t check_edges[] = {
+		0, 1, 9, 10, 15, 16, 99, 100, 255, 256, 65535, 65536,
+		999999999, 1000000000, 0x7FFFFFFF, 0x80000000, 0x80000001,
+		0xFFFFFFFE, 0xFFFFFFFF
+};
+#define CHECK_NUM_EDGES (sizeof(check_edges) / sizeof(check_edges[0]))
+
+const char* const check_strings[] = { "", "a", "mode", "fmt_format" };
+
+uint32_t checked = 0;
+uint32_t mismatches = 0;
+
+// function declarations
+void check_value(uint32_t value); // formats one value with every format both ways
+void check_one(const char* format, uint32_t value, uint16_t size); // formats one value both ways into size bytes and compares
+void check_bases(); // checks that fmt_uint() writes nothing for a base outside 2 to 16
+void check_fail(const char* format, uint32_t value, uint16_t size, const char* fmt, const char* lib); // counts a mismatch and prints the first ones
+
+
+int main(int argc, char** argv)
+{
+	uint32_t values = (argc > 1) ? strtoul(argv[1], NULL, 0) : CHECK_VALUES;
+	uint32_t x = 0x12345678;
+
+	for(uint8_t i = 0; i < CHECK_NUM_EDGES; i++)
+	{
+		check_value(check_edges[i]);
+		check_value(0u - check_edges[i]);
+	}
+
+	// xorshift, spread over every digit count by a random shift
+	for(uint32_t i = 0; i < values; i++)
+	{
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		check_value(x >> (x % 32));
+	}
+
+	check_bases();
+
+	printf("checked %u mismatches %u\n", checked, mismatches);
+	return mismatches ? 1 : 0;
+}
+
+// formats one value with every format both ways
+void check_value(uint32_t value)
+{
+	for(uint8_t i = 0; i < CHECK_NUM_FORMATS; i++)
+	{
+		check_one(check_formats[i], value, CHECK_LEN);
+		check_one(check_formats[i], value, value % 16); // cut off, 0 included
+	}
+}
+
+// formats one value both ways into size bytes and compares
+void check_one(const char* format, uint32_t value, uint16_t size)
+{
+	char fmt[CHECK_LEN];
+	char lib[CHECK_LEN];
+	uint16_t n;
+
+	// the canary shows a write past size
+	memset(fmt, '#', sizeof(fmt));
+	memset(lib, '#', sizeof(lib));
+
+	if(strchr(format, 's'))
+	{
+		const char* s = check_strings[value % 4];
+		n = fmt_format(fmt, size, format, s);
+		snprintf(lib, size, format, s);
+	}
+	else if(strchr(format, 'c'))
+	{
+		int c = ' ' + value % 95; // printable
+		n = fmt_format(fmt, size, format, c);
+		snprintf(lib, size, format, c);
+	}
+	else if(strchr(format, '<'))
+	{
+		n = fmt_format(fmt, size, format, (int32_t)value, value);
+		snprintf(lib, size, format, (int32_t)value, value);
+	}
+	else if(strchr(format, 'd'))
+	{
+		n = fmt_format(fmt, size, format, (int32_t)value);
+		snprintf(lib, size, format, (int32_t)value);
+	}
+	else
+	{
+		n = fmt_format(fmt, size, format, value);
+		snprintf(lib, size, format, value);
+	}
+
+	checked++;
+	if(memcmp(fmt, lib, sizeof(fmt)) || (size && n != strlen(fmt)))
+	{
+		check_fail(format, value, size, fmt, lib);
+	}
+}
+
+// checks that fmt_uint() writes nothing for a base outside 2 to 16
+void check_bases()
+{
+	uint8_t bases[] = { 0, 1, 17, 255 };
+	char out[CHECK_LEN];
+
+	for(uint8_t i = 0; i < sizeof(bases); i++)
+	{
+		memset(out, '#', sizeof(out));
+		uint16_t n = fmt_uint(out, sizeof(out), 12345, bases[i], 0, ' ');
+		checked++;
+		if(n != 0 || out[0] != '\0' || out[1] != '#')
+		{
+			mismatches++;
+			printf("fmt_uint base %u wrote \"%.8s\"\n", bases[i], out);
+		}
+	}
+}
+
+// counts a mismatch and prints the first ones
+void check_fail(const char* format, uint32_t value, uint16_t size, const char* fmt, const char* lib)
+{
+	if(mismatches++ >= CHECK_SHOWN)
+	{
+		return;
+	}
+	printf("\"%s\" 0x%08X size %u: fmt \"%.*s\" snprintf \"%.*s\"\n", format, value, size,
+			(int)strnlen(fmt, size), fmt, (int)strnlen(lib, size), lib);
+}
@@ -0,0 +1,212 @@
+/*
+ * ring_check.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  stress test of the Core/Inc/event_ring.h ring between two threads
+ *
+ *  	ring_check [events]
+ *  		a producer thread posts events numbered 0 to events - 1
+ *  		(2000000 by default) into a RING_CHECK_LEN ring while a consumer
+ *  		thread takes them, the same as an interrupt and the main loop
+ *  		prints the first errors and a "checked N taken T dropped D errors E"
+ *  		line, exits with 1 if any
+ *
+ *  	WHAT IS CHECKED
+ *  		the events come out in the order they went in, each one once and
+ *  		with the type and value it was posted with
+ *  		every number missing from what the consumer took is one the
+ *  		producer saw ring_post() refuse, and the ring's dropped count is
+ *  		the number of refusals, so nothing is lost without being counted
+ *  		the ring is small, the producer waits a random few spins between
+ *  		posts like interrupts coming in, and the consumer pauses now and
+ *  		then, so the ring runs full and empty many times
+ *  		a side that finds the ring full or empty yields, so on a single
+ *  		core the other thread gets to run before the time slice ends
+ *
+ *  	BARRIERS
+ *  		the ring is built with port.h for PORT_HOST, the same as the
+ *  		simulator, so EVENT_RING_BARRIER() is the host's full fence
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "port.h"
+#include "event_ring.h"
+
+
+// defines
+#define CHECK_EVENTS 	2000000 // events posted
+#define CHECK_SHOWN 	10 		// errors printed
+#define RING_CHECK_LEN 	8 		// small, so it fills up
+#define CHECK_PAUSE 	1000 	// the consumer pauses every this many events taken
+#define CHECK_PAUSE_SPIN 2000 	// for this many spins
+#define CHECK_POST_SPIN 64 		// the producer waits up to this many spins between posts
+
+event ring_storage[RING_CHECK_LEN];
+event_ring ring;
+
+uint32_t events = CHECK_EVENTS;
+uint8_t* refused; 				// 1 for every event ring_post() refused
+uint32_t refusals = 0;
+volatile uint8_t posting_done = 0;
+
+uint32_t checked = 0;
+uint32_t taken = 0;
+uint32_t errors = 0;
+
+// function declarations
+void* check_producer(void* arg); // posts every event, marks the ones the full ring refused
+void* check_consumer(void* arg); // takes events until the producer is done and the ring is empty
+void check_event(const event* ev, uint32_t* next); // checks one taken event against the one expected next
+void check_fail(const char* what, uint32_t expected, uint32_t got); // counts an error and prints the first ones
+
+
+int main(int argc, char** argv)
+{
+	pthread_t producer, consumer;
+
+	events = (argc > 1) ? strtoul(argv[1], NULL, 0) : CHECK_EVENTS;
+	refused = calloc(events, 1);
+	if(!refused)
+	{
+		printf("no memory for %u events\n", events);
+		return 1;
+	}
+
+	ring_init(&ring, ring_storage, RING_CHECK_LEN);
+
+	pthread_create(&consumer, NULL, check_consumer, NULL);
+	pthread_create(&producer, NULL, check_producer, NULL);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+
+	// every refusal counted by the ring, and nothing more
+	checked++;
+	if(ring.dropped != (uint16_t)refusals)
+	{
+		check_fail("dropped count", (uint16_t)refusals, ring.dropped);
+	}
+
+	// every event either taken or refused
+	checked++;
+	if(taken + refusals != events)
+	{
+		check_fail("taken + refused", events, taken + refusals);
+	}
+
+	printf("checked %u taken %u dropped %u errors %u\n", checked, taken, refusals, errors);
+	free(refused);
+	return errors ? 1 : 0;
+}
+
+// posts every event, marks the ones the full ring refused
+void* check_producer(void* arg)
+{
+	uint32_t x = 0x12345678;
+
+	for(uint32_t i = 0; i < events; i++)
+	{
+		// xorshift, the time to the next interrupt
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		for(volatile uint32_t spin = 0; spin < x % CHECK_POST_SPIN; spin++);
+
+		if(!ring_post(&ring, EVENT_RX, (uint16_t)(i * 7), i))
+		{
+			refused[i] = 1;
+			refusals++;
+			sched_yield(); // full, let the consumer in
+		}
+	}
+
+	__sync_synchronize(); // the marks are written before the consumer sees the end
+	posting_done = 1;
+	return NULL;
+}
+
+// takes events until the producer is done and the ring is empty
+void* check_consumer(void* arg)
+{
+	uint32_t next = 0; // number of the event expected next
+	event ev;
+
+	while(1)
+	{
+		uint8_t done = posting_done;
+
+		if(ring_get(&ring, &ev))
+		{
+			check_event(&ev, &next);
+
+			// let the producer fill the ring
+			if(++taken % CHECK_PAUSE == 0)
+			{
+				for(volatile uint32_t spin = 0; spin < CHECK_PAUSE_SPIN; spin++);
+			}
+		}
+		else if(done)
+		{
+			break; // empty after the last post
+		}
+		else
+		{
+			sched_yield(); // empty, let the producer in
+		}
+	}
+
+	__sync_synchronize();
+
+	// the events after the last one taken can only have been refused
+	for(; next < events; next++)
+	{
+		checked++;
+		if(!refused[next])
+		{
+			check_fail("lost event", next, 0);
+		}
+	}
+	return NULL;
+}
+
+// checks one taken event against the one expected next
+void check_event(const event* ev, uint32_t* next)
+{
+	checked++;
+	if(ev->time < *next || ev->time >= events)
+	{
+		check_fail(ev->time < *next ? "out of order or twice" : "never posted", *next, ev->time);
+		return;
+	}
+	if(ev->type != EVENT_RX || ev->value != (uint16_t)(ev->time * 7))
+	{
+		check_fail("type or value", (uint16_t)(ev->time * 7), ev->value);
+	}
+
+	// the gap before it is events the full ring refused, the producer marked
+	// them before posting this one
+	__sync_synchronize();
+	for(; *next < ev->time; (*next)++)
+	{
+		if(!refused[*next])
+		{
+			check_fail("lost event", *next, ev->time);
+		}
+	}
+	*next = ev->time + 1;
+}
+
+// counts an error and prints the first ones
+void check_fail(const char* what, uint32_t expected, uint32_t got)
+{
+	if(errors++ >= CHECK_SHOWN)
+	{
+		return;
+	}
+	printf("%s: expected %u got %u\n", what, expected, got);
+}
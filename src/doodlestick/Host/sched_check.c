@@ -0,0 +1,402 @@
+/*
+ * sched_check.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  unit test of the Core/Inc/scheduler.h scheduler on the TIM5 of the
+ *  simulated board in Core/Inc/port_host.h
+ *
+ *  	sched_check
+ *  		runs every check below and prints the failed ones and a
+ *  		"checked N failures F" line, exits with 1 if any
+ *
+ *  	WHAT IS CHECKED
+ *  		priority 		of the runnable tasks the first in the table runs,
+ *  						and every pass starts over from the top
+ *  		grid 			a late periodic task stays on its period grid, a
+ *  						miss of whole periods counts late / period_us
+ *  						overruns, also across the 32 bit wrap of TIM5
+ *  		re-check 		work that comes after the first check but before
+ *  						the interrupts are masked keeps the core out of WFI
+ *  		wake up 		with SysTick off, a TIM2 interrupt that posts work
+ *  						while the core checks with interrupts masked still
+ *  						wakes the WFI right away
+ *  		accounting 		with TIM5 started just before its wrap, the idle
+ *  						time and the task run times add up to the time that
+ *  						went by, and every grid slot was run or overrun
+ *
+ *  	TIME
+ *  		the tasks spin on TIM5 for their run time, the board's time only
+ *  		moves with register accesses and WFI
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "port.h"
+#include "scheduler.h"
+
+
+// defines
+#define CHECK_SECONDS 	60 		// simulated time before the board gives up
+#define CHECK_PERIOD_US 1000 	// period of the periodic task
+#define CHECK_RUN_US 	100 	// run time of the periodic task
+#define CHECK_LONG_US 	2500 	// run time of every CHECK_LONG_EVERY event, misses whole periods
+#define CHECK_LONG_EVERY 4
+#define CHECK_TIM2_US 	3000 	// TIM2 update period, each one posts an event
+#define CHECK_WAKE_US 	20 		// most time from the TIM2 update to the event task
+#define CHECK_WRAP_US 	10000 	// TIM5 starts this long before its wrap
+#define CHECK_RUN_FOR_US 60000 	// length of the accounting run
+#define CHECK_LOG_LEN 	8
+
+// the tasks runs are logged by a letter
+char run_log[CHECK_LOG_LEN + 1];
+uint8_t run_logged = 0;
+
+// work flags of the event tasks
+volatile uint8_t high_work = 0, mid_work = 0, low_work = 0;
+volatile uint8_t event_work = 0;
+volatile uint32_t event_posted_at = 0; 	// TIM5 count of the last TIM2 update
+uint32_t events_run = 0;
+uint32_t worst_wake_us = 0;
+uint8_t recheck_armed = 0; 				// the next has_work() call posts the work it says isn't there
+
+uint32_t checked = 0;
+uint32_t failures = 0;
+
+// function declarations
+void check(uint8_t ok, const char* what, uint32_t expected, uint32_t got); // counts a check, prints it if it failed
+void check_priority(); // runs three event tasks that are all runnable
+void check_grid(); // moves a periodic task on by hand across late starts, missed periods and the TIM5 wrap
+void check_recheck(); // makes work appear between the two checks of sched_run_once()
+void check_wake(); // sleeps with SysTick off until the TIM2 interrupt posts work
+void check_accounting(); // runs a periodic and an event task across the wrap of TIM5
+void timer_init(uint32_t cnt); // starts TIM5 at 1us from cnt, and TIM2 updating every CHECK_TIM2_US
+void spin_us(uint32_t us); // waits on TIM5 for us
+void log_run(char c); // adds a task run to the log
+void high_run(); // logs 'h', posts work for mid if asked to
+void mid_run(); // logs 'm'
+void low_run(); // logs 'l'
+uint8_t high_has_work(); // returns 1 if high_work is set
+uint8_t mid_has_work(); // returns 1 if mid_work is set
+uint8_t low_has_work(); // returns 1 if low_work is set, posts it on the first call while armed
+void periodic_run(); // takes CHECK_RUN_US
+void event_run(); // takes the TIM2 event, every CHECK_LONG_EVERY one for CHECK_LONG_US
+uint8_t event_has_work(); // returns 1 if TIM2 posted an event
+void TIM2_IRQHandler(void); // posts an event
+
+
+int main(int argc, char** argv)
+{
+	port_host_reset(CHECK_SECONDS);
+	if(setjmp(port_host.done))
+	{
+		printf("the simulated board ran out of time after %u s\n", CHECK_SECONDS);
+		return 1;
+	}
+
+	HAL_Init(); // SysTick, the 1 ms wake up
+	timer_init(0);
+
+	check_priority();
+	check_grid();
+	check_recheck();
+	check_wake();
+	check_accounting();
+
+	printf("checked %u failures %u\n", checked, failures);
+	return failures ? 1 : 0;
+}
+
+// counts a check, prints it if it failed
+void check(uint8_t ok, const char* what, uint32_t expected, uint32_t got)
+{
+	checked++;
+	if(!ok)
+	{
+		failures++;
+		printf("%s: expected %u got %u\n", what, expected, got);
+	}
+}
+
+// runs three event tasks that are all runnable
+void check_priority()
+{
+	task tasks[] = {
+		// name 	run 		has_work 		period_us
+		{ "high", 	high_run, 	high_has_work, 	0 },
+		{ "mid", 	mid_run, 	mid_has_work, 	0 },
+		{ "low", 	low_run, 	low_has_work, 	0 }
+	};
+	scheduler s;
+	sched_init(&s, tasks, 3);
+
+	// all three waiting, they run in table order
+	run_logged = 0;
+	low_work = mid_work = high_work = 1;
+	for(uint8_t i = 0; i < 3; i++) sched_run_once(&s);
+	check(run_logged == 3 && run_log[0] == 'h' && run_log[1] == 'm' && run_log[2] == 'l',
+			"priority order hml, letters in order", 3, run_logged);
+
+	// high posts work for mid while low waits, the next pass starts over from the top
+	run_logged = 0;
+	low_work = 1;
+	high_work = 2;
+	for(uint8_t i = 0; i < 3; i++) sched_run_once(&s);
+	check(run_logged == 3 && run_log[0] == 'h' && run_log[1] == 'm' && run_log[2] == 'l',
+			"priority starts over from the top, runs", 3, run_logged);
+
+	check(tasks[0].runs == 2 && tasks[1].runs == 2 && tasks[2].runs == 2, "priority runs of each task", 2, tasks[2].runs);
+	check(s.sleeps == 0, "priority sleeps while work was waiting", 0, s.sleeps);
+}
+
+// moves a periodic task on by hand across late starts, missed periods and the TIM5 wrap
+void check_grid()
+{
+	task t = { "periodic", periodic_run, NULL, CHECK_PERIOD_US };
+	scheduler s;
+	sched_init(&s, &t, 1);
+
+	// the times are given to sched_run(), only the run time comes from TIM5
+	t.next = 0xFFFFF000;
+
+	sched_run(&t, 0xFFFFF000 + 200); // late, but within the period
+	check(t.next == 0xFFFFF000 + CHECK_PERIOD_US, "grid next after a late start", 0xFFFFF000 + CHECK_PERIOD_US, t.next);
+	check(t.overruns == 0, "grid overruns after a late start", 0, t.overruns);
+	check(t.late_us == 200, "grid late_us", 200, t.late_us);
+
+	// 3.3 periods late, across the wrap of the 32 bit count
+	uint32_t due = t.next;
+	uint32_t now = due + 3 * CHECK_PERIOD_US + 300;
+	sched_run(&t, now);
+	check(t.overruns == (now - due) / CHECK_PERIOD_US, "grid overruns are late / period_us", 3, t.overruns);
+	check(t.next == due + 4 * CHECK_PERIOD_US, "grid next after missed periods", due + 4 * CHECK_PERIOD_US, t.next);
+	check((uint32_t)(t.next - 0xFFFFF000) % CHECK_PERIOD_US == 0, "grid next on the grid after the wrap", 0, (t.next - 0xFFFFF000) % CHECK_PERIOD_US);
+	check(!sched_due(&t, now), "grid not due again right after a run", 0, sched_due(&t, now));
+	check(sched_due(&t, t.next), "grid due at next", 1, sched_due(&t, t.next));
+
+	// started exactly on time, no lateness added
+	due = t.next;
+	sched_run(&t, due);
+	check(t.next == due + CHECK_PERIOD_US && t.overruns == 3, "grid on time start", due + CHECK_PERIOD_US, t.next);
+	check(t.runs == 3, "grid runs", 3, t.runs);
+}
+
+// makes work appear between the two checks of sched_run_once()
+void check_recheck()
+{
+	task tasks[] = {
+		// name 	run 		has_work 		period_us
+		{ "low", 	low_run, 	low_has_work, 	0 }
+	};
+	scheduler s;
+	sched_init(&s, tasks, 1);
+	uint32_t board_sleeps = port_host.sleeps;
+
+	// the first check sees nothing, an interrupt posts the work before the masked check
+	low_work = 0;
+	recheck_armed = 1;
+	run_logged = 0;
+	sched_run_once(&s);
+	check(s.sleeps == 0 && port_host.sleeps == board_sleeps, "re-check kept the core out of WFI, sleeps", 0, s.sleeps);
+	check(run_logged == 0, "re-check runs nothing in the idle pass", 0, run_logged);
+
+	sched_run_once(&s);
+	check(run_logged == 1 && run_log[0] == 'l', "re-check work runs on the next pass", 1, run_logged);
+
+	// with nothing coming the core does sleep
+	sched_run_once(&s);
+	check(s.sleeps == 1 && port_host.sleeps == board_sleeps + 1, "re-check sleeps without work", 1, s.sleeps);
+}
+
+// sleeps with SysTick off until the TIM2 interrupt posts work
+void check_wake()
+{
+	task tasks[] = {
+		// name 	run 		has_work 		period_us
+		{ "event", 	event_run, 	event_has_work, 0 }
+	};
+	scheduler s;
+
+	HAL_SuspendTick();
+	sched_init(&s, tasks, 1);
+	events_run = 0;
+	worst_wake_us = 0;
+	event_work = 0;
+
+	// only TIM2 wakes the core, so each event waits in WFI
+	while(events_run < CHECK_LONG_EVERY - 1)
+	{
+		sched_run_once(&s);
+	}
+	check(s.sleeps >= events_run, "wake up sleeps between the events", events_run, s.sleeps);
+	check(worst_wake_us <= CHECK_WAKE_US, "wake up us from the TIM2 update to the task", CHECK_WAKE_US, worst_wake_us);
+	HAL_ResumeTick();
+}
+
+// runs a periodic and an event task across the wrap of TIM5
+void check_accounting()
+{
+	task tasks[] = {
+		// name 		run 			has_work 		period_us
+		{ "event", 		event_run, 		event_has_work, 0 },
+		{ "periodic", 	periodic_run, 	NULL, 			CHECK_PERIOD_US }
+	};
+	scheduler s;
+
+	timer_init(0xFFFFFFFF - CHECK_WRAP_US);
+	sched_init(&s, tasks, 2);
+	uint32_t start = s.since;
+	uint32_t first = tasks[1].next;
+	uint32_t passes = 0;
+	events_run = 0;
+	event_work = 0;
+
+	while(SCHED_NOW() - start < CHECK_RUN_FOR_US)
+	{
+		sched_run_once(&s);
+		passes++;
+
+		// never more than a period ahead, always on the grid
+		task* p = &tasks[1];
+		if((uint32_t)(p->next - first) % CHECK_PERIOD_US != 0 || (int32_t)(p->next - SCHED_NOW()) > CHECK_PERIOD_US)
+		{
+			check(0, "accounting periodic task left the grid at", first, p->next);
+			break;
+		}
+	}
+	uint32_t elapsed = SCHED_NOW() - start;
+	uint32_t busy = tasks[0].busy_us + tasks[1].busy_us;
+
+	check(SCHED_NOW() < start, "accounting TIM5 wrapped during the run", start, SCHED_NOW());
+	check(s.idle_us < elapsed, "accounting idle is less than the time", elapsed, s.idle_us);
+	check(s.idle_total_us == s.idle_us, "accounting idle_total_us", s.idle_us, s.idle_total_us);
+
+	// only the time between two passes isn't counted, less than 1 us each
+	check(s.idle_us + busy <= elapsed && elapsed - (s.idle_us + busy) <= passes,
+			"accounting idle + busy adds up to the time, us", elapsed, s.idle_us + busy);
+
+	// every slot on the grid was run once or counted as missed
+	check(tasks[1].runs + tasks[1].overruns == (uint32_t)(tasks[1].next - first) / CHECK_PERIOD_US,
+			"accounting periodic runs + overruns", (tasks[1].next - first) / CHECK_PERIOD_US, tasks[1].runs + tasks[1].overruns);
+	check(tasks[1].overruns > 0, "accounting the long events made overruns", 1, tasks[1].overruns);
+	check(tasks[1].late_us >= CHECK_LONG_US - CHECK_PERIOD_US, "accounting late_us after a long event", CHECK_LONG_US, tasks[1].late_us);
+	check(tasks[0].runs == events_run && events_run >= CHECK_RUN_FOR_US / CHECK_TIM2_US - 1, "accounting event runs", CHECK_RUN_FOR_US / CHECK_TIM2_US, events_run);
+}
+
+// starts TIM5 at 1us from cnt, and TIM2 updating every CHECK_TIM2_US
+void timer_init(uint32_t cnt)
+{
+	TIM5->PSC = PORT_HOST_CLK / 1000000 - 1;
+	TIM5->ARR = 0xFFFFFFFF;
+	TIM5->CNT = cnt;
+	TIM5->CR1 |= TIM_CR1_CEN;
+
+	TIM2->CR1 &= ~TIM_CR1_CEN;
+	TIM2->PSC = PORT_HOST_CLK / 1000000 - 1;
+	TIM2->ARR = CHECK_TIM2_US - 1;
+	TIM2->CNT = 0;
+	TIM2->SR = 0;
+	TIM2->DIER |= TIM_DIER_UIE;
+	TIM2->CR1 |= TIM_CR1_CEN;
+	NVIC->ISER[0] = (1 << (TIM2_IRQn & 0x1F));
+}
+
+// waits on TIM5 for us
+void spin_us(uint32_t us)
+{
+	uint32_t start = TIM5->CNT;
+	while(TIM5->CNT - start < us);
+}
+
+// adds a task run to the log
+void log_run(char c)
+{
+	if(run_logged < CHECK_LOG_LEN)
+	{
+		run_log[run_logged++] = c;
+	}
+}
+
+// logs 'h', posts work for mid if asked to
+void high_run()
+{
+	log_run('h');
+	if(high_work == 2)
+	{
+		mid_work = 1;
+	}
+	high_work = 0;
+}
+
+// logs 'm'
+void mid_run()
+{
+	log_run('m');
+	mid_work = 0;
+}
+
+// logs 'l'
+void low_run()
+{
+	log_run('l');
+	low_work = 0;
+}
+
+// returns 1 if high_work is set
+uint8_t high_has_work()
+{
+	return high_work != 0;
+}
+
+// returns 1 if mid_work is set
+uint8_t mid_has_work()
+{
+	return mid_work;
+}
+
+// returns 1 if low_work is set, posts it on the first call while armed
+uint8_t low_has_work()
+{
+	if(recheck_armed)
+	{
+		recheck_armed = 0;
+		low_work = 1; // an interrupt right after this check
+		return 0;
+	}
+	return low_work;
+}
+
+// takes CHECK_RUN_US
+void periodic_run()
+{
+	spin_us(CHECK_RUN_US);
+}
+
+// takes the TIM2 event, every CHECK_LONG_EVERY one for CHECK_LONG_US
+void event_run()
+{
+	uint32_t wake = TIM5->CNT - event_posted_at;
+	if(wake > worst_wake_us) worst_wake_us = wake;
+
+	event_work = 0;
+	if(++events_run % CHECK_LONG_EVERY == 0)
+	{
+		spin_us(CHECK_LONG_US);
+	}
+}
+
+// returns 1 if TIM2 posted an event
+uint8_t event_has_work()
+{
+	return event_work;
+}
+
+// posts an event
+void TIM2_IRQHandler(void)
+{
+	TIM2->SR = (uint32_t)~TIM_SR_UIF;
+	event_posted_at = TIM5->CNT;
+	event_work = 1;
+}
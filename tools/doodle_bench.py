@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Serial link throughput and latency for doodlestick.
+
+    doodle_bench.py PORT [--baud N] [--count N]
+    doodle_bench.py PORT --loopback [--count N]
+
+With the board (or doodle_pty.py) on PORT this switches both ends to --baud
+if given, then times --count round trips (default 100) of each command:
+a one pixel set for latency, and full frame uploads and reads for throughput.
+--loopback expects every byte echoed back (a TX-RX jumper, or
+doodle_pty.py --loopback) and times single byte echoes and 4 KB blocks.
+"""
+
+import os
+import statistics
+import sys
+import time
+
+import doodleproto as dp
+
+
+def report(name, times, payload_bytes):
+    ms = sorted(t * 1000 for t in times)
+    total = sum(times)
+    print("%-8s median %7.2f ms  p95 %7.2f ms  %7.1f /s  %8.1f KB/s payload" % (
+        name, statistics.median(ms), ms[int(len(ms) * 0.95) - 1], len(times) / total,
+        payload_bytes * len(times) / total / 1024))
+
+
+def timed(count, fn):
+    times = []
+    for _ in range(count):
+        start = time.perf_counter()
+        fn()
+        times.append(time.perf_counter() - start)
+    return times
+
+
+def bench_protocol(fd, count, baud):
+    link = dp.Link(fd, timeout=2.0)
+    if baud:
+        link.set_baud(baud)
+    print("baud %s, %d round trips each" % (baud or "unchanged", count))
+    frame = dp.pack_frame([[(x + y) & 7 for x in range(dp.WIDTH)] for y in range(dp.HEIGHT)])
+    report("pixel", timed(count, lambda: link.command(dp.SET_PIXEL, [1, 1, 2])), 3)
+    report("upload", timed(count, lambda: link.command(dp.UPLOAD_FRAME, frame)), dp.FRAME_BYTES)
+    report("read", timed(count, lambda: link.command(dp.READ_FRAME)), dp.FRAME_BYTES)
+
+
+def echo(fd, data):
+    os.write(fd, data)
+    got = 0
+    while got < len(data):
+        chunk = os.read(fd, 4096)
+        if not chunk:
+            raise TimeoutError("echo stopped after %d of %d bytes" % (got, len(data)))
+        got += len(chunk)
+
+
+def bench_loopback(fd, count):
+    block = bytes(range(256)) * 16
+    print("loopback, %d echoes each" % count)
+    report("1 byte", timed(count, lambda: echo(fd, b"x")), 1)
+    report("4 KB", timed(max(count // 10, 1), lambda: echo(fd, block)), len(block))
+
+
+def main(argv):
+    if len(argv) < 2:
+        raise SystemExit(__doc__)
+    count = int(argv[argv.index("--count") + 1]) if "--count" in argv else 100
+    baud = int(argv[argv.index("--baud") + 1]) if "--baud" in argv else 0
+    fd = dp.open_port(argv[1])
+    if "--loopback" in argv:
+        bench_loopback(fd, count)
+    else:
+        bench_protocol(fd, count, baud)
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Stand-in for the board on a pseudo terminal, for testing doodleproto.py without hardware.
+
+    doodle_pty.py [--drop N] [--baud N] [--loopback]
+
+Prints the pty path to use as PORT, then answers protocol frames against an
+in-memory 32x16 canvas the same way proto_run() in main.c does. Plain
+characters are echoed back as text, like the board's serial commands.
+--drop N ignores every Nth frame to exercise the host retry path.
+'m' starts the canvas mirror and 'M' stops it, like on the board; while it
+runs a cursor traces around the canvas. 't' and 'T' start and stop telemetry
+records once a second, with counters that grow at rates like the board's.
+Everything sent back is paced to the simulated baud (115200 until --baud or a
+PROTO_SET_BAUD command changes it), 10 bits per byte, so the timings seen by
+doodle_bench.py follow the link. --loopback echoes every byte instead, like a
+TX-RX jumper on the board's port.
+"""
+
+import os
+import pty
+import select
+import sys
+import time
+import tty
+
+import doodleproto as dp
+
+COLOR, FILL, DRAW, SPEED = 0xA, 0x0, 0xB, 0x9
+
+
+class Board:
+    def __init__(self):
+        self.pixels = [[0] * dp.WIDTH for _ in range(dp.HEIGHT)]
+        self.mode, self.option = DRAW, 2
+        self.mirror = False
+        self.baud = 115200
+        self.new_baud = 0
+        self.last = None
+        self.seq = 0
+        self.cursor = 0
+        self.telemetry = None
+
+    def trace(self):
+        """Moves a cursor one pixel along a spiral-ish path, drawing as it goes."""
+        self.cursor += 1
+        x = self.cursor % dp.WIDTH
+        y = (self.cursor // dp.WIDTH * 3 + x // 8) % dp.HEIGHT
+        self.pixels[y][x] = 1 + self.cursor // 97 % 7
+
+    def mirror_delta(self):
+        """Returns the next mirror frame, the same format as mirror_build(), or None if nothing changed."""
+        keyframe = self.last is None
+        if keyframe:
+            self.last = [[0] * dp.WIDTH for _ in range(dp.HEIGHT)]
+        rows, body = 0, bytearray()
+        for y in range(dp.HEIGHT):
+            if self.pixels[y] != self.last[y]:
+                body += dp.mirror_encode_row(self.pixels[y], self.last[y])
+                self.last[y] = list(self.pixels[y])
+                rows |= 1 << y
+        if not rows and not keyframe:
+            return None
+        t = int(time.monotonic() * 1e6) & 0xFFFFFFFF
+        head = bytes([dp.MIRROR, self.seq, dp.MIRROR_KEYFRAME if keyframe else 0])
+        self.seq = (self.seq + 1) & 0xFF
+        return dp.encode_frame(head + t.to_bytes(4, "little") + rows.to_bytes(2, "little") + body)
+
+    def telemetry_record(self):
+        """Returns the next telemetry frame, the totals run at fixed made-up rates."""
+        t = self.telemetry
+        now = time.monotonic()
+        elapsed = now - t["start"]
+        t["seq"] = (t["seq"] + 1) & 0xFF
+        t["time_us"] = int(now * 1e6)
+        t["mode"], t["option"] = self.mode, self.option
+        for key, hz in (("loops", 2400), ("refreshes", 120), ("adc_samples", 1000),
+                        ("isr_tim2", 50), ("isr_tim7", 1000), ("isr_tim16", 0), ("isr_tim3", 960),
+                        ("idle_us", 880000)):
+            t[key] = int(elapsed * hz)
+        return dp.telemetry_encode(t)
+
+    def run(self, cmd, args):
+        """Returns (status, reply data), the same checks as proto_run()."""
+        w, h = dp.WIDTH, dp.HEIGHT
+        if cmd == dp.SET_PIXEL:
+            if len(args) != 3:
+                return 1, b""
+            x, y, c = args
+            if x >= w or y >= h or c > 7:
+                return 2, b""
+            self.pixels[y][x] = c
+        elif cmd == dp.SET_RECT:
+            if len(args) != 5:
+                return 1, b""
+            x0, y0, x1, y1, c = args
+            if max(x0, x1) >= w or max(y0, y1) >= h or c > 7:
+                return 2, b""
+            for y in range(min(y0, y1), max(y0, y1) + 1):
+                for x in range(min(x0, x1), max(x0, x1) + 1):
+                    self.pixels[y][x] = c
+        elif cmd == dp.UPLOAD_FRAME:
+            if len(args) != dp.FRAME_BYTES:
+                return 1, b""
+            self.pixels = dp.unpack_frame(args)
+        elif cmd == dp.READ_FRAME:
+            if len(args) != 0:
+                return 1, b""
+            return 0, dp.pack_frame(self.pixels)
+        elif cmd == dp.SET_MODE:
+            if len(args) != 2:
+                return 1, b""
+            if args[0] not in (COLOR, FILL, DRAW, SPEED) or args[1] > 8:
+                return 2, b""
+            self.mode, self.option = args[0], args[1] or -1
+        elif cmd == dp.SET_BAUD:
+            if len(args) != 4:
+                return 1, b""
+            baud = int.from_bytes(args, "little")
+            if baud < 1200 or baud > 2000000:
+                return 2, b""
+            self.new_baud = baud
+        else:
+            return 3, b""
+        return 0, b""
+
+
+def loopback(master, baud):
+    """Echoes every byte back after the time it takes on the wire."""
+    while True:
+        data = os.read(master, 4096)
+        time.sleep(len(data) * 10 / baud)
+        os.write(master, data)
+
+
+def main(argv):
+    drop = int(argv[argv.index("--drop") + 1]) if "--drop" in argv else 0
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    print(os.ttyname(slave), flush=True)
+
+    board = Board()
+    if "--baud" in argv:
+        board.baud = int(argv[argv.index("--baud") + 1])
+    if "--loopback" in argv:
+        loopback(master, board.baud)
+    rx = bytearray()
+    in_frame = False
+    frames = 0
+    busy_until = 0.0
+    while True:
+        # while mirroring, send a delta whenever the simulated link is idle
+        if board.mirror and time.monotonic() >= busy_until:
+            board.trace()
+            frame = board.mirror_delta()
+            if frame:
+                os.write(master, frame)
+                busy_until = time.monotonic() + len(frame) * 10 / board.baud
+        # one telemetry record a second
+        if board.telemetry and time.monotonic() >= board.telemetry["next"]:
+            board.telemetry["next"] += 1.0
+            os.write(master, board.telemetry_record())
+        ready, _, _ = select.select([master], [], [], 0.001 if board.mirror or board.telemetry else None)
+        data = os.read(master, 4096) if ready else b""
+        for byte in data:
+            if byte == 0:
+                if in_frame and rx:
+                    in_frame = False
+                    payload = dp.decode_frame(bytes(rx))
+                    rx_frame, rx = rx + b"\x00\x00", bytearray()
+                    if payload is None:
+                        print("bad frame", file=sys.stderr)
+                        continue
+                    frames += 1
+                    if drop and frames % drop == 0:
+                        print("dropped frame %d" % frames, file=sys.stderr)
+                        continue
+                    status, reply = board.run(payload[0], payload[2:])
+                    body = bytes([payload[0] | dp.REPLY, payload[1], status]) + reply
+                    frame = dp.encode_frame(body)
+                    # the command took this long to arrive and the reply takes this long to leave
+                    time.sleep((len(rx_frame) + len(frame)) * 10 / board.baud)
+                    os.write(master, frame)
+                    if board.new_baud:
+                        board.baud, board.new_baud = board.new_baud, 0
+                else:
+                    in_frame, rx = True, bytearray()
+            elif in_frame:
+                rx.append(byte)
+            elif byte == ord("m"):
+                board.mirror, board.last = True, None
+            elif byte == ord("M"):
+                board.mirror = False
+            elif byte == ord("t"):
+                board.telemetry = dict.fromkeys(["seq", "key_events", "button_events", "tx_dropped", "stop_ms"]
+                                                + ["dropped_" + n for n in dp.DROPPED_NAMES]
+                                                + ["isr_" + n for n in dp.ISR_NAMES], 0)
+                board.telemetry["start"] = board.telemetry["next"] = time.monotonic()
+            elif byte == ord("T"):
+                board.telemetry = None
+            else:
+                os.write(master, ("got %r\n\r" % chr(byte)).encode())
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Decoder for the doodlestick telemetry records (Core/Inc/telemetry.h).
+
+    doodle_telemetry.py PORT [--out FILE.csv] [--record FILE]
+    doodle_telemetry.py --play FILE [--out FILE.csv]
+
+Sends 't' to start the records and writes one CSV row per record after the
+first. The board only sends free running totals, so every rate here is the
+difference of two records over the difference of their TIM5 times, and a lost
+record makes one row cover two periods instead of losing counts. Event and
+drop counts are per row, the drop columns stay totals so a single drop is
+easy to spot. busy_percent is the time the core was awake and not asleep in
+the scheduler, TIM5 stops in Stop 2 so stop_ms is the time on top of time_s.
+--record keeps the raw stream for --play. Ctrl-C sends 'T'.
+"""
+
+import csv
+import os
+import sys
+
+import doodleproto as dp
+
+COLUMNS = (["time_s", "seq", "lost", "mode", "option", "loops_per_s", "refresh_hz", "adc_hz",
+            "key_events", "button_events"]
+           + ["dropped_" + name for name in dp.DROPPED_NAMES] + ["tx_dropped"]
+           + ["isr_%s_hz" % name for name in dp.ISR_NAMES] + ["busy_percent", "stop_ms"])
+
+
+def delta(new, old, bits=32):
+    return (new - old) & ((1 << bits) - 1)
+
+
+class Decoder:
+    def __init__(self, out):
+        self.writer = csv.writer(out)
+        self.writer.writerow(COLUMNS)
+        self.out = out
+        self.rx = bytearray()
+        self.last = None
+        self.elapsed_us = 0
+        self.rows = 0
+
+    def feed(self, data):
+        self.rx += data
+        while b"\x00" in self.rx:
+            chunk, _, rest = self.rx.partition(b"\x00")
+            self.rx = bytearray(rest)
+            payload = dp.decode_frame(bytes(chunk)) if chunk else None
+            if payload is not None and payload[0] == dp.TELEMETRY:
+                self.record(dp.telemetry_decode(payload))
+
+    def record(self, rec):
+        last, self.last = self.last, rec
+        if last is None:
+            return
+        us = delta(rec["time_us"], last["time_us"])
+        if us == 0:
+            return
+        self.elapsed_us += us
+
+        def rate(key):
+            return "%.1f" % (delta(rec[key], last[key]) * 1e6 / us)
+
+        row = ["%.3f" % (self.elapsed_us / 1e6), rec["seq"], delta(rec["seq"], last["seq"], 8) - 1,
+               rec["mode"], rec["option"], rate("loops"), rate("refreshes"), rate("adc_samples"),
+               delta(rec["key_events"], last["key_events"], 16),
+               delta(rec["button_events"], last["button_events"], 16)]
+        row += [rec["dropped_" + name] for name in dp.DROPPED_NAMES] + [rec["tx_dropped"]]
+        row += [rate("isr_" + name) for name in dp.ISR_NAMES]
+        row += ["%.1f" % (100 - delta(rec["idle_us"], last["idle_us"]) * 100 / us),
+                delta(rec["stop_ms"], last["stop_ms"])]
+        self.writer.writerow(row)
+        self.out.flush()
+        self.rows += 1
+
+
+def main(argv):
+    out = open(argv[argv.index("--out") + 1], "w", newline="") if "--out" in argv else sys.stdout
+    decoder = Decoder(out)
+    if "--play" in argv:
+        decoder.feed(open(argv[argv.index("--play") + 1], "rb").read())
+        print("%d rows" % decoder.rows, file=sys.stderr)
+        return
+    if len(argv) < 2 or argv[1].startswith("--"):
+        raise SystemExit(__doc__)
+    record = open(argv[argv.index("--record") + 1], "wb") if "--record" in argv else None
+    fd = dp.open_port(argv[1])
+    os.write(fd, b"t")
+    try:
+        while True:
+            data = os.read(fd, 4096)
+            if record:
+                record.write(data)
+            decoder.feed(data)
+    except KeyboardInterrupt:
+        os.write(fd, b"T")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
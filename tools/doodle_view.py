@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Viewer for the doodlestick canvas mirror (Core/Inc/frame_mirror.h).
+
+    doodle_view.py PORT [--record FILE] [--quiet]
+    doodle_view.py --play FILE [--quiet]
+
+Sends 'm' to start the stream, rebuilds every frame from the run length
+deltas, draws the canvas in the terminal and prints the frames per second and
+the bytes per frame on the wire (delimiters included) once a second. --record
+keeps the raw stream so a session can be played back later with --play.
+Ctrl-C sends 'M' to stop the stream.
+"""
+
+import os
+import sys
+import time
+
+import doodleproto as dp
+
+# ANSI background colors for the 3 color bits, bit 0 red, bit 1 green, bit 2 blue
+ANSI = [40, 41, 42, 43, 44, 45, 46, 47]
+
+
+def draw(pixels, status):
+    lines = ["\x1b[H"]
+    for row in pixels:
+        lines.append("".join("\x1b[%dm  " % ANSI[p] for p in row) + "\x1b[0m\n")
+    lines.append(status + "\x1b[K\n")
+    sys.stdout.write("".join(lines))
+    sys.stdout.flush()
+
+
+class Viewer:
+    def __init__(self, quiet):
+        self.quiet = quiet
+        self.pixels = [[0] * dp.WIDTH for _ in range(dp.HEIGHT)]
+        self.rx = bytearray()
+        self.frames = self.bytes = self.lost = 0
+        self.total_frames = self.total_bytes = 0
+        self.seq = None
+        self.window = time.monotonic()
+        self.status = "waiting for frames"
+        if not quiet:
+            sys.stdout.write("\x1b[2J")
+
+    def feed(self, data, now):
+        self.rx += data
+        while b"\x00" in self.rx:
+            chunk, _, rest = self.rx.partition(b"\x00")
+            self.rx = bytearray(rest)
+            payload = dp.decode_frame(bytes(chunk)) if chunk else None
+            if payload is None or payload[0] != dp.MIRROR:
+                continue
+            seq, _ = dp.mirror_apply(payload, self.pixels)
+            if self.seq is not None and seq != (self.seq + 1) & 0xFF:
+                self.lost += (seq - self.seq - 1) & 0xFF
+            self.seq = seq
+            self.frames += 1
+            self.bytes += len(chunk) + 2  # both delimiters
+            self.total_frames += 1
+            self.total_bytes += len(chunk) + 2
+            if not self.quiet:
+                draw(self.pixels, self.status)
+        if now - self.window >= 1.0:
+            elapsed = now - self.window
+            self.status = "%.1f fps  %.1f bytes/frame  %d lost" % (
+                self.frames / elapsed, self.bytes / self.frames if self.frames else 0, self.lost)
+            if self.quiet:
+                print(self.status, flush=True)
+            else:
+                draw(self.pixels, self.status)
+            self.window, self.frames, self.bytes = now, 0, 0
+
+
+def main(argv):
+    quiet = "--quiet" in argv
+    if "--play" in argv:
+        viewer = Viewer(quiet)
+        data = open(argv[argv.index("--play") + 1], "rb").read()
+        viewer.feed(data, time.monotonic())
+        print("%d frames  %.1f bytes/frame  %d lost" % (viewer.total_frames,
+              viewer.total_bytes / max(viewer.total_frames, 1), viewer.lost))
+        return
+    if len(argv) < 2 or argv[1].startswith("--"):
+        raise SystemExit(__doc__)
+    record = open(argv[argv.index("--record") + 1], "wb") if "--record" in argv else None
+    fd = dp.open_port(argv[1])
+    viewer = Viewer(quiet)
+    os.write(fd, b"m")
+    try:
+        while True:
+            data = os.read(fd, 4096)
+            if record:
+                record.write(data)
+            viewer.feed(data, time.monotonic())
+    except KeyboardInterrupt:
+        os.write(fd, b"M")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,304 @@
+#!/usr/bin/env python3
+"""Host side of the doodlestick binary canvas protocol (Core/Inc/frame_protocol.h).
+
+Frames are 0x00, COBS(cmd, seq, args, crc16 hi, crc16 lo), 0x00 with
+CRC-16/CCITT-FALSE. Plain text printed by the board shares the line and is
+skipped. Only the standard library is used; the port is opened raw with termios.
+
+    doodleproto.py PORT pixel X Y COLOR
+    doodleproto.py PORT rect X0 Y0 X1 Y1 COLOR
+    doodleproto.py PORT upload FILE      (16 lines of 32 color digits 0-7)
+    doodleproto.py PORT read [FILE]      (same text format)
+    doodleproto.py PORT mode MODE [OPTION]
+    doodleproto.py PORT baud BAUD         (the board and this port switch after the reply)
+
+PORT is the board's serial device, or the path printed by doodle_pty.py.
+Colors are bit 0 red, bit 1 green, bit 2 blue. Modes are the keypad values
+10 (COLOR, *), 0 (FILL), 11 (DRAW, #) and 9 (SPEED).
+"""
+
+import os
+import sys
+import termios
+import time
+
+WIDTH = 32
+HEIGHT = 16
+FRAME_BYTES = WIDTH * HEIGHT // 2
+
+SET_PIXEL = 0x01
+SET_RECT = 0x02
+UPLOAD_FRAME = 0x03
+READ_FRAME = 0x04
+SET_MODE = 0x05
+SET_BAUD = 0x06
+MIRROR = 0x40           # unsolicited canvas delta (frame_mirror.h)
+MIRROR_KEYFRAME = 0x01
+TELEMETRY = 0x41        # unsolicited counters record (telemetry.h)
+REPLY = 0x80
+
+STATUS = {0: "ok", 1: "bad length", 2: "bad argument", 3: "unknown command"}
+
+# TELEMETRY_ISR order, one 4 byte count each after the drop counts
+ISR_NAMES = ["tim2", "tim7", "keypad_row", "exti4", "tim16", "usart2", "dma_rx", "dma_tx", "tim3", "lptim1"]
+DROPPED_NAMES = ["tick", "keypad", "button", "serial"]
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, the same as proto_crc()."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    """Start delimiter and COBS blocks, the same as proto_encode() without the end delimiter."""
+    out = bytearray([0, 0])
+    code_at, code = 1, 1
+    for i, byte in enumerate(data):
+        if byte == 0:
+            out[code_at] = code
+            code_at, code = len(out), 1
+            out.append(0)
+        else:
+            out.append(byte)
+            code += 1
+            if code == 0xFF and i + 1 < len(data):  # full block, no 0x00 after it
+                out[code_at] = code
+                code_at, code = len(out), 1
+                out.append(0)
+    out[code_at] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_frame(payload):
+    """Adds the crc and returns the frame with both delimiters."""
+    crc = crc16(payload)
+    return cobs_encode(bytes(payload) + bytes([crc >> 8, crc & 0xFF])) + b"\x00"
+
+
+def decode_frame(chunk):
+    """Returns the payload without the crc, or None if the chunk is not a good frame."""
+    try:
+        payload = cobs_decode(chunk)
+    except ValueError:
+        return None
+    if len(payload) < 4 or crc16(payload) != 0:
+        return None
+    return payload[:-2]
+
+
+def pack_frame(pixels):
+    """pixels[y][x] color bits -> FRAME_BYTES, two pixels per byte, left one low."""
+    out = bytearray(FRAME_BYTES)
+    for y in range(HEIGHT):
+        for x in range(WIDTH):
+            i = y * WIDTH + x
+            out[i >> 1] |= (pixels[y][x] & 7) << ((i & 1) * 4)
+    return bytes(out)
+
+
+def unpack_frame(data):
+    return [[(data[(y * WIDTH + x) >> 1] >> (((y * WIDTH + x) & 1) * 4)) & 7
+             for x in range(WIDTH)] for y in range(HEIGHT)]
+
+
+def mirror_encode_row(row, last):
+    """Run length encoded XOR of a row with the last one sent, the same as mirror_encode_row()."""
+    out, x = bytearray(), 0
+    while x < WIDTH:
+        value, run = (row[x] ^ last[x]) & 7, 1
+        while x + run < WIDTH and (row[x + run] ^ last[x + run]) & 7 == value:
+            run += 1
+        out.append(((run - 1) << 3) | value)
+        x += run
+    return bytes(out)
+
+
+def mirror_apply(payload, pixels):
+    """Applies a PROTO_MIRROR payload (crc removed) to pixels[y][x], returns (seq, time_us)."""
+    seq, flags = payload[1], payload[2]
+    time_us = int.from_bytes(payload[3:7], "little")
+    rows = int.from_bytes(payload[7:9], "little")
+    if flags & MIRROR_KEYFRAME:
+        for row in pixels:
+            row[:] = [0] * WIDTH
+    i = 9
+    for y in range(HEIGHT):
+        if rows & (1 << y):
+            x = 0
+            while x < WIDTH:
+                run, value = (payload[i] >> 3) + 1, payload[i] & 7
+                i += 1
+                for _ in range(run):
+                    pixels[y][x] ^= value
+                    x += 1
+    return seq, time_us
+
+
+def telemetry_decode(payload):
+    """Returns the fields of a PROTO_TELEMETRY payload (crc removed) as a dict, the layout of telemetry_build()."""
+    def u(at, n):
+        return int.from_bytes(payload[at:at + n], "little")
+    rec = {
+        "seq": payload[1],
+        "mode": payload[2],
+        "option": payload[3] - 256 if payload[3] > 127 else payload[3],
+        "time_us": u(4, 4),
+        "loops": u(8, 4),
+        "refreshes": u(12, 4),
+        "adc_samples": u(16, 4),
+        "key_events": u(20, 2),
+        "button_events": u(22, 2),
+        "tx_dropped": u(32, 2),
+    }
+    for i, name in enumerate(DROPPED_NAMES):
+        rec["dropped_" + name] = u(24 + 2 * i, 2)
+    for i, name in enumerate(ISR_NAMES):
+        rec["isr_" + name] = u(34 + 4 * i, 4)
+    end = 34 + 4 * len(ISR_NAMES)
+    rec["idle_us"] = u(end, 4)
+    rec["stop_ms"] = u(end + 4, 4)
+    return rec
+
+
+def telemetry_encode(rec):
+    """The other way, for doodle_pty.py."""
+    def p(value, n):
+        return (value & ((1 << (8 * n)) - 1)).to_bytes(n, "little")
+    out = bytes([TELEMETRY, rec["seq"], rec["mode"], rec["option"] & 0xFF])
+    out += p(rec["time_us"], 4) + p(rec["loops"], 4) + p(rec["refreshes"], 4) + p(rec["adc_samples"], 4)
+    out += p(rec["key_events"], 2) + p(rec["button_events"], 2)
+    out += b"".join(p(rec["dropped_" + name], 2) for name in DROPPED_NAMES) + p(rec["tx_dropped"], 2)
+    out += b"".join(p(rec["isr_" + name], 4) for name in ISR_NAMES)
+    out += p(rec["idle_us"], 4) + p(rec["stop_ms"], 4)
+    return encode_frame(out)
+
+
+def read_text_frame(path):
+    rows = [line.strip() for line in open(path) if line.strip()]
+    if len(rows) != HEIGHT or any(len(r) != WIDTH for r in rows):
+        raise SystemExit("%s: need %d lines of %d digits" % (path, HEIGHT, WIDTH))
+    return [[int(c) for c in row] for row in rows]
+
+
+def format_text_frame(pixels):
+    return "\n".join("".join(str(p) for p in row) for row in pixels) + "\n"
+
+
+def set_port_baud(fd, baud):
+    attrs = termios.tcgetattr(fd)
+    speed = getattr(termios, "B%d" % baud, None)
+    if speed is None:
+        raise SystemExit("this host has no %d baud" % baud)
+    attrs[4] = attrs[5] = speed
+    termios.tcsetattr(fd, termios.TCSADRAIN, attrs)
+
+
+def open_port(path, baud=115200):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = 0                                    # iflag
+    attrs[1] = 0                                    # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    attrs[3] = 0                                    # lflag, raw
+    speed = getattr(termios, "B%d" % baud, termios.B115200)
+    attrs[4] = attrs[5] = speed
+    attrs[6][termios.VMIN] = 0
+    attrs[6][termios.VTIME] = 1                     # reads return after 0.1 s
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+class Link:
+    """Sends commands and waits for the matching reply, resending on a timeout."""
+
+    def __init__(self, fd, timeout=1.0, retries=3):
+        self.fd = fd
+        self.timeout = timeout
+        self.retries = retries
+        self.seq = 0
+        self.rx = bytearray()
+        self.text = bytearray()
+
+    def command(self, cmd, args=b""):
+        self.seq = (self.seq + 1) & 0xFF
+        frame = encode_frame(bytes([cmd, self.seq]) + bytes(args))
+        for _ in range(self.retries):
+            os.write(self.fd, frame)
+            reply = self.wait_reply(cmd, self.seq)
+            if reply is not None:
+                status = reply[0]
+                if status != 0:
+                    raise RuntimeError("command 0x%02x: %s" % (cmd, STATUS.get(status, status)))
+                return reply[1:]
+        raise TimeoutError("no reply to command 0x%02x" % cmd)
+
+    def set_baud(self, baud):
+        """Asks the board to switch, then switches this end once the reply is in."""
+        self.command(SET_BAUD, baud.to_bytes(4, "little"))
+        set_port_baud(self.fd, baud)
+        time.sleep(0.01)  # the board flushes before it switches
+
+    def wait_reply(self, cmd, seq):
+        end = time.monotonic() + self.timeout
+        while time.monotonic() < end:
+            data = os.read(self.fd, 1024)
+            self.rx += data
+            while b"\x00" in self.rx:
+                chunk, _, rest = self.rx.partition(b"\x00")
+                self.rx = bytearray(rest)
+                payload = decode_frame(bytes(chunk)) if chunk else None
+                if payload is None:
+                    self.text += chunk  # board prints, not a frame
+                elif payload[0] == cmd | REPLY and payload[1] == seq:
+                    return payload[2:]
+        return None
+
+
+def main(argv):
+    if len(argv) < 3:
+        raise SystemExit(__doc__)
+    link = Link(open_port(argv[1]))
+    what, args = argv[2], [int(a) for a in argv[3:] if a.lstrip("-").isdigit()]
+    start = time.monotonic()
+    if what == "pixel":
+        link.command(SET_PIXEL, args[:3])
+    elif what == "rect":
+        link.command(SET_RECT, args[:5])
+    elif what == "upload":
+        link.command(UPLOAD_FRAME, pack_frame(read_text_frame(argv[3])))
+    elif what == "read":
+        text = format_text_frame(unpack_frame(link.command(READ_FRAME)))
+        if len(argv) > 3:
+            open(argv[3], "w").write(text)
+        else:
+            sys.stdout.write(text)
+    elif what == "mode":
+        link.command(SET_MODE, (args + [0])[:2])
+    elif what == "baud":
+        link.set_baud(args[0])
+    else:
+        raise SystemExit(__doc__)
+    print("%s ok in %.1f ms" % (what, (time.monotonic() - start) * 1000), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main(sys.argv)